@@ -2,15 +2,68 @@
 #define ADAN_IO_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+int64_t adn_string_length(const char* s);
+
+void* adn_array_create(void);
+
+int64_t adn_array_length(void* array);
+
+void adn_array_push_string(void* array, const char* value);
+
+char* adn_array_get_string(void* array, int64_t index);
+
+void adn_release(void* value);
+
+void* adn_native_create(int64_t size, void (*destroy)(void*));
+
+char* adn_string_copy_bytes(const char* bytes, int64_t length);
 
 void adn_print(const char* message);
 
 void adn_flush(void);
 
+// Size of the stdout buffer in bytes; 0 writes every line straight away.
+void adn_set_output_buffer(int64_t size);
+
 void adn_write_file(const char* path, const char* content);
 
 char* adn_read_file(const char* path);
 
+// Maps the file read-only and returns it as a NUL-terminated string; release it with
+// adn_unmap_file. Falls back to reading the whole file where mmap is unavailable.
+char* adn_map_file(const char* path);
+
+void adn_unmap_file(const char* view);
+
+// Streaming line reader. adn_lines_next advances to the next line and returns 0 at the
+// end of the file; adn_lines_line returns a copy of the current line.
+void* adn_lines_open(const char* path);
+
+int64_t adn_lines_next(void* reader);
+
+char* adn_lines_line(void* reader);
+
+void adn_lines_close(void* reader);
+
+// Buffered file handles. `mode` is "w" (truncate) or "a" (append), plus "s" to fsync
+// whenever buffered data is written out.
+void* adn_file_open(const char* path, const char* mode);
+
+void adn_file_write(void* file, const char* content);
+
+void adn_file_flush(void* file);
+
+void adn_file_close(void* file);
+
+// Reads or writes a batch of files at once, through io_uring where the kernel allows it
+// and a thread pool otherwise. read_many returns the contents in input order, with ""
+// for files that could not be read; write_many returns how many files were written.
+void* adn_read_many(void* paths);
+
+int64_t adn_write_many(void* paths, void* contents);
+
 char* adn_input(const char* prompt);
 
 void adn_error(const char* fmt, ...);
@@ -6,6 +6,174 @@
 
 #include "io.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// adn_print writes into a buffer owned by the runtime instead of going through stdio per
+// line. The buffer is flushed when a line does not fit, at exit and by io.flush(); the
+// overflowing line goes out in the same writev as the buffered bytes. When stdout is a
+// terminal every line is written straight away so interactive output is not held back.
+#define ADN_OUTPUT_DEFAULT_SIZE (64 * 1024)
+
+typedef struct
+{
+	char* data;
+	size_t length;
+	size_t capacity;
+	int fd;
+#ifdef _WIN32
+	FILE* stream;
+#endif
+	int line_buffered;
+	int initialized;
+} AdnOutput;
+
+#ifdef _WIN32
+static AdnOutput adn_stdout_buffer = {NULL, 0, ADN_OUTPUT_DEFAULT_SIZE, 1, NULL, 0, 0};
+#else
+static AdnOutput adn_stdout_buffer = {NULL, 0, ADN_OUTPUT_DEFAULT_SIZE, STDOUT_FILENO, 0, 0};
+#endif
+
+typedef struct
+{
+	const char* data;
+	size_t length;
+} AdnOutputPiece;
+
+// Writes every piece out; returns -1 if the descriptor refused part of them.
+static int adn_output_write(AdnOutput* out, const AdnOutputPiece* pieces, size_t count)
+{
+#ifdef _WIN32
+	FILE* stream = out->stream ? out->stream : stdout;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (fwrite(pieces[i].data, 1, pieces[i].length, stream) != pieces[i].length)
+		{
+			return -1;
+		}
+	}
+	return fflush(stream) == 0 ? 0 : -1;
+#else
+	struct iovec vectors[4];
+	size_t vector_count = 0;
+	for (size_t i = 0; i < count && vector_count < 4; i++)
+	{
+		if (pieces[i].length > 0)
+		{
+			vectors[vector_count].iov_base = (void*)pieces[i].data;
+			vectors[vector_count].iov_len = pieces[i].length;
+			vector_count++;
+		}
+	}
+	struct iovec* cursor = vectors;
+	while (vector_count > 0)
+	{
+		ssize_t written = writev(out->fd, cursor, (int)vector_count);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
+		}
+		size_t remaining = (size_t)written;
+		while (vector_count > 0 && remaining >= cursor->iov_len)
+		{
+			remaining -= cursor->iov_len;
+			cursor++;
+			vector_count--;
+		}
+		if (vector_count > 0)
+		{
+			cursor->iov_base = (char*)cursor->iov_base + remaining;
+			cursor->iov_len -= remaining;
+		}
+	}
+	return 0;
+#endif
+}
+
+static int adn_output_drain(AdnOutput* out)
+{
+	if (out->length == 0)
+	{
+		return 0;
+	}
+	AdnOutputPiece piece = {out->data, out->length};
+	out->length = 0;
+	return adn_output_write(out, &piece, 1);
+}
+
+// Buffers `text` followed by `suffix`, or writes both out together with whatever is
+// pending when they do not fit.
+static int adn_output_put(AdnOutput* out, const char* text, size_t length, const char* suffix,
+                          size_t suffix_length)
+{
+	if (!out->line_buffered && !out->data && out->capacity > 0)
+	{
+		out->data = malloc(out->capacity);
+		if (!out->data)
+		{
+			out->capacity = 0;
+		}
+	}
+	if (!out->line_buffered && out->data &&
+	    out->length + length + suffix_length <= out->capacity)
+	{
+		memcpy(out->data + out->length, text, length);
+		memcpy(out->data + out->length + length, suffix, suffix_length);
+		out->length += length + suffix_length;
+		return 0;
+	}
+	AdnOutputPiece pieces[3] = {
+	    {out->data, out->length}, {text, length}, {suffix, suffix_length}};
+	out->length = 0;
+	return adn_output_write(out, pieces, 3);
+}
+
+static void adn_output_flush(void)
+{
+	adn_output_drain(&adn_stdout_buffer);
+}
+
+static void adn_output_init(void)
+{
+	if (adn_stdout_buffer.initialized)
+	{
+		return;
+	}
+	adn_stdout_buffer.initialized = 1;
+#ifdef _WIN32
+	adn_stdout_buffer.line_buffered = 1;
+#else
+	adn_stdout_buffer.line_buffered = isatty(STDOUT_FILENO);
+#endif
+	// Anything stdio already holds for stdout has to go out before our own bytes.
+	fflush(stdout);
+	atexit(adn_output_flush);
+}
+
+static void adn_output_line(const char* text, size_t length)
+{
+	adn_output_init();
+	adn_output_put(&adn_stdout_buffer, text, length, "\n", 1);
+}
+
+void adn_set_output_buffer(int64_t size)
+{
+	adn_output_init();
+	adn_output_flush();
+	free(adn_stdout_buffer.data);
+	adn_stdout_buffer.data = NULL;
+	adn_stdout_buffer.capacity = size > 0 ? (size_t)size : 0;
+}
+
 static const char* unwrap_string_literal(const char* text, size_t* out_len)
 {
 	if (!text)
@@ -17,7 +185,7 @@ static const char* unwrap_string_literal(const char* text, size_t* out_len)
 		return NULL;
 	}
 
-	size_t len = strlen(text);
+	size_t len = (size_t)adn_string_length(text);
 	const char* start = text;
 	if (len >= 2 && ((text[0] == '"' && text[len - 1] == '"') ||
 	                 (text[0] == '\'' && text[len - 1] == '\'') ||
@@ -38,16 +206,17 @@ void adn_print(const char* message)
 {
 	if (!message)
 	{
-		putchar('\n');
+		adn_output_line("", 0);
 		return;
 	}
 	size_t print_len = 0;
 	const char* start = unwrap_string_literal(message, &print_len);
-	printf("%.*s\n", (int)print_len, start);
+	adn_output_line(start, print_len);
 }
 
 void adn_flush(void)
 {
+	adn_output_flush();
 	fflush(stdout);
 	fflush(stderr);
 }
@@ -149,8 +318,1013 @@ char* adn_read_file(const char* path)
 	return buffer;
 }
 
+// Copies the path argument into a NUL-terminated buffer the caller frees.
+static char* adn_io_path(const char* path)
+{
+	size_t path_len = 0;
+	const char* raw_path = unwrap_string_literal(path, &path_len);
+	if (!raw_path || path_len == 0)
+	{
+		return NULL;
+	}
+	char* normalized_path = malloc(path_len + 1);
+	if (!normalized_path)
+	{
+		return NULL;
+	}
+	memcpy(normalized_path, raw_path, path_len);
+	normalized_path[path_len] = '\0';
+	return normalized_path;
+}
+
+#ifndef _WIN32
+// Live io.map views, so adn_unmap_file can find the size of the mapping it is given.
+typedef struct AdnMapping
+{
+	char* data;
+	size_t size;
+	struct AdnMapping* next;
+} AdnMapping;
+
+static AdnMapping* adn_mappings = NULL;
+#endif
+
+char* adn_map_file(const char* path)
+{
+#ifdef _WIN32
+	return adn_read_file(path);
+#else
+	char* normalized_path = adn_io_path(path);
+	if (!normalized_path)
+	{
+		return NULL;
+	}
+	int fd = open(normalized_path, O_RDONLY | O_CLOEXEC);
+	free(normalized_path);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return NULL;
+	}
+	if (info.st_size == 0)
+	{
+		close(fd);
+		return "";
+	}
+
+	// Reserve one byte more than the file, rounded up to whole pages, and map the file
+	// over the front of it. The bytes past the end of the file read as zero, so the view
+	// is NUL-terminated even when the file fills its last page exactly.
+	size_t file_size = (size_t)info.st_size;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size = (file_size + 1 + page - 1) / page * page;
+	char* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		close(fd);
+		return NULL;
+	}
+	char* data = mmap(base, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+	close(fd);
+	AdnMapping* mapping = data == MAP_FAILED ? NULL : malloc(sizeof(AdnMapping));
+	if (!mapping)
+	{
+		munmap(base, size);
+		return NULL;
+	}
+	madvise(data, file_size, MADV_SEQUENTIAL);
+	mapping->data = data;
+	mapping->size = size;
+	mapping->next = adn_mappings;
+	adn_mappings = mapping;
+	return data;
+#endif
+}
+
+void adn_unmap_file(const char* view)
+{
+#ifdef _WIN32
+	free((char*)view);
+#else
+	for (AdnMapping** link = &adn_mappings; *link; link = &(*link)->next)
+	{
+		AdnMapping* mapping = *link;
+		if (mapping->data == view)
+		{
+			munmap(mapping->data, mapping->size);
+			*link = mapping->next;
+			free(mapping);
+			return;
+		}
+	}
+#endif
+}
+
+// io.lines reads the file in chunks into one buffer and splits lines in place: the
+// newline is overwritten with a NUL, and io.line copies the current line into a string of
+// its own. The buffer only grows when a single line does not fit. Readers are runtime
+// values; io.close_lines frees the file and buffer early and leaves the reader exhausted.
+#define ADN_LINES_CHUNK_SIZE (64 * 1024)
+
+typedef struct
+{
+	FILE* file;
+	char* data;
+	size_t start;
+	size_t length;
+	size_t capacity;
+	char* line;
+	size_t line_length;
+	int eof;
+	int closed;
+} AdnLineReader;
+
+static void adn_lines_shut(AdnLineReader* reader)
+{
+	if (reader->closed)
+	{
+		return;
+	}
+	if (reader->file)
+	{
+		fclose(reader->file);
+		reader->file = NULL;
+	}
+	free(reader->data);
+	reader->data = NULL;
+	reader->line = "";
+	reader->line_length = 0;
+	reader->eof = 1;
+	reader->closed = 1;
+}
+
+static void adn_lines_destroy(void* handle)
+{
+	adn_lines_shut(handle);
+}
+
+void* adn_lines_open(const char* path)
+{
+	char* normalized_path = adn_io_path(path);
+	if (!normalized_path)
+	{
+		return NULL;
+	}
+	FILE* file = fopen(normalized_path, "rb");
+	free(normalized_path);
+	if (!file)
+	{
+		return NULL;
+	}
+	char* data = malloc(ADN_LINES_CHUNK_SIZE + 1);
+	AdnLineReader* reader =
+	    data ? adn_native_create((int64_t)sizeof(AdnLineReader), adn_lines_destroy) : NULL;
+	if (!reader)
+	{
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+	setvbuf(file, NULL, _IONBF, 0);
+	reader->file = file;
+	reader->data = data;
+	reader->capacity = ADN_LINES_CHUNK_SIZE;
+	reader->line = "";
+	return reader;
+}
+
+// Moves the unread bytes to the front of the buffer and reads more after them.
+static int adn_lines_fill(AdnLineReader* reader)
+{
+	if (reader->eof)
+	{
+		return 0;
+	}
+	if (reader->start > 0)
+	{
+		memmove(reader->data, reader->data + reader->start, reader->length - reader->start);
+		reader->length -= reader->start;
+		reader->start = 0;
+	}
+	if (reader->length == reader->capacity)
+	{
+		char* data = realloc(reader->data, reader->capacity * 2 + 1);
+		if (!data)
+		{
+			return 0;
+		}
+		reader->data = data;
+		reader->capacity *= 2;
+	}
+	size_t read = fread(reader->data + reader->length, 1, reader->capacity - reader->length,
+	                    reader->file);
+	reader->length += read;
+	if (read == 0)
+	{
+		reader->eof = 1;
+		fclose(reader->file);
+		reader->file = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+int64_t adn_lines_next(void* handle)
+{
+	AdnLineReader* reader = handle;
+	if (!reader || reader->closed)
+	{
+		return 0;
+	}
+	size_t scanned = reader->start;
+	for (;;)
+	{
+		char* newline =
+		    memchr(reader->data + scanned, '\n', reader->length - scanned);
+		if (newline)
+		{
+			char* line = reader->data + reader->start;
+			char* end = newline;
+			*newline = '\0';
+			if (end > line && end[-1] == '\r')
+			{
+				*--end = '\0';
+			}
+			reader->start = (size_t)(newline - reader->data) + 1;
+			reader->line = line;
+			reader->line_length = (size_t)(end - line);
+			return 1;
+		}
+		size_t pending = reader->length - reader->start;
+		if (!adn_lines_fill(reader))
+		{
+			break;
+		}
+		scanned = pending;
+	}
+	if (reader->start == reader->length)
+	{
+		reader->line = "";
+		reader->line_length = 0;
+		return 0;
+	}
+	// The last line has no newline; the spare byte after the buffer terminates it.
+	reader->data[reader->length] = '\0';
+	reader->line = reader->data + reader->start;
+	reader->line_length = reader->length - reader->start;
+	reader->start = reader->length;
+	return 1;
+}
+
+char* adn_lines_line(void* handle)
+{
+	AdnLineReader* reader = handle;
+	return adn_string_copy_bytes(reader ? reader->line : "",
+	                             reader ? (int64_t)reader->line_length : 0);
+}
+
+void adn_lines_close(void* handle)
+{
+	AdnLineReader* reader = handle;
+	if (reader)
+	{
+		adn_lines_shut(reader);
+	}
+}
+
+// io.open handles. Writes go through the same buffering as stdout, so appending many small
+// records costs one write syscall per buffer instead of an open/write/close per record.
+// A handle is a runtime value: io.close flushes and closes the file but leaves the handle
+// marked closed, so later calls fail cleanly, and the memory goes with the last reference.
+// Handles still open at exit, or dropped without io.close, are flushed and closed then.
+typedef struct AdnFile
+{
+	AdnOutput output;
+	int sync;
+	int closed;
+	char* path;
+	struct AdnFile* next;
+} AdnFile;
+
+static AdnFile* adn_open_files = NULL;
+
+static void adn_file_fail(AdnFile* file, const char* action)
+{
+	fprintf(stderr, "Failed to %s '%s': %s (Error)\n", action, file->path, strerror(errno));
+	exit(1);
+}
+
+static void adn_file_drain(AdnFile* file)
+{
+	if (adn_output_drain(&file->output) != 0)
+	{
+		adn_file_fail(file, "write to");
+	}
+#ifndef _WIN32
+	if (file->sync && fsync(file->output.fd) != 0)
+	{
+		adn_file_fail(file, "sync");
+	}
+#endif
+}
+
+// Flushes and closes the file and drops it from the open list; the handle stays valid.
+static void adn_file_shut(AdnFile* file)
+{
+	if (file->closed)
+	{
+		return;
+	}
+	adn_file_drain(file);
+	for (AdnFile** link = &adn_open_files; *link; link = &(*link)->next)
+	{
+		if (*link == file)
+		{
+			*link = file->next;
+			break;
+		}
+	}
+#ifdef _WIN32
+	fclose(file->output.stream);
+#else
+	close(file->output.fd);
+#endif
+	free(file->output.data);
+	file->output.data = NULL;
+	file->closed = 1;
+}
+
+static void adn_file_destroy(void* handle)
+{
+	AdnFile* file = handle;
+	adn_file_shut(file);
+	free(file->path);
+}
+
+static void adn_file_close_all(void)
+{
+	while (adn_open_files)
+	{
+		adn_file_shut(adn_open_files);
+	}
+}
+
+static AdnFile* adn_file_check(void* handle, const char* action)
+{
+	AdnFile* file = handle;
+	if (!file || file->closed)
+	{
+		fprintf(stderr, "%s() on a closed file handle. (Error)\n", action);
+		exit(1);
+	}
+	return file;
+}
+
+// `mode` is "w" to truncate or "a" to append (O_APPEND); "ws" and "as" also sync the file
+// to disk whenever the buffer is written out and on close. Any other mode is an error, so
+// a mistaken "r" cannot truncate the file.
+void* adn_file_open(const char* path, const char* mode)
+{
+	size_t mode_len = 0;
+	const char* raw_mode = unwrap_string_literal(mode, &mode_len);
+	if (!raw_mode || mode_len < 1 || mode_len > 2 || (raw_mode[0] != 'w' && raw_mode[0] != 'a') ||
+	    (mode_len == 2 && raw_mode[1] != 's'))
+	{
+		fprintf(stderr, "open() mode must be w, a, ws or as, not \"%.*s\". (Error)\n",
+		    (int)mode_len, raw_mode ? raw_mode : "");
+		exit(1);
+	}
+	int append = raw_mode[0] == 'a';
+	int sync = mode_len == 2;
+	char* normalized_path = adn_io_path(path);
+	if (!normalized_path)
+	{
+		fprintf(stderr, "open() requires a valid path. (Error)\n");
+		exit(1);
+	}
+
+	AdnFile* file = adn_native_create((int64_t)sizeof(AdnFile), adn_file_destroy);
+	if (!file)
+	{
+		fprintf(stderr, "Failed to allocate memory for file handle. (Error)\n");
+		exit(1);
+	}
+	file->path = normalized_path;
+	file->sync = sync;
+	file->output.capacity = ADN_OUTPUT_DEFAULT_SIZE;
+	file->output.initialized = 1;
+#ifdef _WIN32
+	file->output.stream = fopen(normalized_path, append ? "ab" : "wb");
+	if (!file->output.stream)
+#else
+	int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+	file->output.fd = open(normalized_path, flags, 0666);
+	if (file->output.fd < 0)
+#endif
+	{
+		adn_file_fail(file, "open");
+	}
+
+	static int close_registered = 0;
+	if (!close_registered)
+	{
+		close_registered = 1;
+		atexit(adn_file_close_all);
+	}
+	file->next = adn_open_files;
+	adn_open_files = file;
+	return file;
+}
+
+void adn_file_write(void* handle, const char* content)
+{
+	AdnFile* file = adn_file_check(handle, "write");
+	size_t content_len = 0;
+	const char* raw_content = unwrap_string_literal(content, &content_len);
+	if (!raw_content || content_len == 0)
+	{
+		return;
+	}
+	if (adn_output_put(&file->output, raw_content, content_len, "", 0) != 0)
+	{
+		adn_file_fail(file, "write to");
+	}
+	if (file->sync && file->output.length == 0)
+	{
+		adn_file_drain(file);
+	}
+}
+
+void adn_file_flush(void* handle)
+{
+	adn_file_drain(adn_file_check(handle, "flush"));
+}
+
+void adn_file_close(void* handle)
+{
+	adn_file_shut(adn_file_check(handle, "close"));
+}
+
+// io.read_many / io.write_many run a whole batch of files at once and return the results
+// in input order. On Linux the opens, reads and writes are queued on an io_uring so their
+// latency overlaps; where io_uring is unavailable (old kernel, seccomp) the batch is
+// split across a small pool of threads doing blocking I/O instead.
+typedef enum
+{
+	ADN_BATCH_OPEN,
+	ADN_BATCH_TRANSFER,
+	ADN_BATCH_DONE
+} AdnBatchState;
+
+typedef struct
+{
+	char* path;
+	char* data;
+	size_t length;
+	size_t done;
+	int fd;
+	int writing;
+	int failed;
+	AdnBatchState state;
+} AdnBatchOp;
+
+#define ADN_BATCH_MAX_THREADS 16
+
+// Accounts for one read or write result; a short transfer leaves the op in TRANSFER.
+static void adn_batch_transferred(AdnBatchOp* op, int64_t result)
+{
+	if (result < 0)
+	{
+		if (result != -EINTR && result != -EAGAIN)
+		{
+			op->failed = 1;
+			op->state = ADN_BATCH_DONE;
+		}
+		return;
+	}
+	op->done += (size_t)result;
+	if (op->done >= op->length || (result == 0 && !op->writing))
+	{
+		// A file that shrank since it was sized just ends early.
+		op->length = op->done;
+		op->state = ADN_BATCH_DONE;
+	}
+}
+
+#ifdef _WIN32
+static void adn_batch_run_blocking(AdnBatchOp* op)
+{
+	FILE* file = fopen(op->path, op->writing ? "wb" : "rb");
+	long size = 0;
+	if (!file || (!op->writing && (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+	                               fseek(file, 0, SEEK_SET) != 0 ||
+	                               (op->data = malloc((size_t)size + 1)) == NULL)))
+	{
+		op->failed = 1;
+		op->state = ADN_BATCH_DONE;
+		if (file)
+		{
+			fclose(file);
+		}
+		return;
+	}
+	if (!op->writing)
+	{
+		op->length = (size_t)size;
+	}
+	op->state = ADN_BATCH_TRANSFER;
+	while (op->state == ADN_BATCH_TRANSFER)
+	{
+		size_t chunk = op->length - op->done;
+		size_t moved = op->writing ? fwrite(op->data + op->done, 1, chunk, file)
+		                           : fread(op->data + op->done, 1, chunk, file);
+		adn_batch_transferred(op, moved == 0 && op->writing ? -EIO : (int64_t)moved);
+	}
+	if (fclose(file) != 0 && op->writing)
+	{
+		op->failed = 1;
+	}
+}
+#else
+static int adn_batch_open_flags(const AdnBatchOp* op)
+{
+	int flags = op->writing ? O_WRONLY | O_CREAT | O_TRUNC : O_RDONLY;
+#ifdef O_CLOEXEC
+	flags |= O_CLOEXEC;
+#endif
+	return flags;
+}
+
+// Called once the descriptor is open: sizes the read buffer from fstat.
+static void adn_batch_opened(AdnBatchOp* op, int fd)
+{
+	op->fd = fd;
+	if (fd < 0)
+	{
+		op->failed = 1;
+		op->state = ADN_BATCH_DONE;
+		return;
+	}
+	if (!op->writing)
+	{
+		struct stat info;
+		if (fstat(fd, &info) != 0 || (op->data = malloc((size_t)info.st_size + 1)) == NULL)
+		{
+			op->failed = 1;
+			op->state = ADN_BATCH_DONE;
+			return;
+		}
+		op->length = (size_t)info.st_size;
+	}
+	op->state = op->length > 0 ? ADN_BATCH_TRANSFER : ADN_BATCH_DONE;
+}
+
+static void adn_batch_transfer_blocking(AdnBatchOp* op)
+{
+	while (op->state == ADN_BATCH_TRANSFER)
+	{
+		ssize_t result = op->writing
+		                     ? write(op->fd, op->data + op->done, op->length - op->done)
+		                     : read(op->fd, op->data + op->done, op->length - op->done);
+		adn_batch_transferred(op, result < 0 ? -errno : (int64_t)result);
+	}
+}
+
+static void adn_batch_run_blocking(AdnBatchOp* op)
+{
+	adn_batch_opened(op, open(op->path, adn_batch_open_flags(op), 0666));
+	adn_batch_transfer_blocking(op);
+}
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define ADN_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef ADN_HAVE_IO_URING
+#define ADN_URING_ENTRIES 128
+
+typedef struct
+{
+	int fd;
+	unsigned entries;
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void* sq_ring;
+	size_t sq_ring_size;
+	void* cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+} AdnRing;
+
+static void adn_ring_close(AdnRing* ring)
+{
+	if (ring->sqes)
+	{
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+	{
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	}
+	if (ring->sq_ring)
+	{
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	}
+	close(ring->fd);
+}
+
+static int adn_ring_open(AdnRing* ring, unsigned entries)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+	{
+		return -1;
+	}
+	ring->entries = params.sq_entries;
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring->cq_ring_size > ring->sq_ring_size)
+		{
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+	                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+	{
+		ring->sq_ring = NULL;
+		adn_ring_close(ring);
+		return -1;
+	}
+	ring->cq_ring = ring->sq_ring;
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+		                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+		{
+			ring->cq_ring = NULL;
+			adn_ring_close(ring);
+			return -1;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                  ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		ring->sqes = NULL;
+		adn_ring_close(ring);
+		return -1;
+	}
+	char* sq = ring->sq_ring;
+	char* cq = ring->cq_ring;
+	ring->sq_head = (unsigned*)(void*)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned*)(void*)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned*)(void*)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned*)(void*)(sq + params.sq_off.array);
+	ring->cq_head = (unsigned*)(void*)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned*)(void*)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned*)(void*)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(void*)(cq + params.cq_off.cqes);
+	return 0;
+}
+
+// Queues the next step of `op`; user_data carries its index for the completion.
+static void adn_ring_queue(AdnRing* ring, AdnBatchOp* op, size_t index)
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned slot = tail & *ring->sq_mask;
+	struct io_uring_sqe* sqe = &ring->sqes[slot];
+	memset(sqe, 0, sizeof(*sqe));
+	if (op->state == ADN_BATCH_OPEN)
+	{
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uint64_t)(uintptr_t)op->path;
+		sqe->open_flags = (uint32_t)adn_batch_open_flags(op);
+		sqe->len = 0666;
+	}
+	else
+	{
+		sqe->opcode = op->writing ? IORING_OP_WRITE : IORING_OP_READ;
+		sqe->fd = op->fd;
+		sqe->addr = (uint64_t)(uintptr_t)(op->data + op->done);
+		sqe->len = (uint32_t)(op->length - op->done > 0x40000000u ? 0x40000000u
+		                                                          : op->length - op->done);
+		sqe->off = op->done;
+	}
+	sqe->user_data = index;
+	ring->sq_array[slot] = slot;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// Returns -1 when the ring fails or the kernel lacks an opcode, so the caller can finish the
+// batch on the thread pool. Before returning it waits for every request the kernel already
+// took, so no read or write is still using an op's buffer or descriptor afterwards.
+static int adn_batch_run_ring(AdnBatchOp* ops, size_t count)
+{
+	AdnRing ring;
+	if (adn_ring_open(&ring, count < ADN_URING_ENTRIES ? (unsigned)count : ADN_URING_ENTRIES) !=
+	    0)
+	{
+		return -1;
+	}
+	size_t* pending = malloc(count * sizeof(size_t));
+	if (!pending)
+	{
+		adn_ring_close(&ring);
+		return -1;
+	}
+	size_t pending_count = 0;
+	for (size_t i = count; i > 0; i--)
+	{
+		pending[pending_count++] = i - 1;
+	}
+	// in_flight counts queued ops whose completion has not been reaped, which keeps the
+	// completion ring (twice the submission ring) from overflowing. Once status is -1 nothing
+	// new is queued and the loop only drains what the kernel has already consumed.
+	unsigned in_flight = 0;
+	int status = 0;
+	while ((status == 0 && pending_count > 0) || in_flight > 0)
+	{
+		while (status == 0 && pending_count > 0 && in_flight < ring.entries)
+		{
+			size_t index = pending[--pending_count];
+			adn_ring_queue(&ring, &ops[index], index);
+			in_flight++;
+		}
+		unsigned unsubmitted = *ring.sq_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+		if (status != 0 && in_flight == unsubmitted)
+		{
+			// The rest never reached the kernel; their ops are left for the fallback.
+			break;
+		}
+		long entered = syscall(__NR_io_uring_enter, ring.fd, status == 0 ? unsubmitted : 0, 1,
+		                       IORING_ENTER_GETEVENTS, NULL, 0);
+		if (entered < 0 && errno != EINTR)
+		{
+			if (status != 0)
+			{
+				fprintf(stderr, "Lost track of queued file I/O: %s (Error)\n", strerror(errno));
+				exit(1);
+			}
+			status = -1;
+			continue;
+		}
+		unsigned head = *ring.cq_head;
+		unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+			AdnBatchOp* op = &ops[cqe->user_data];
+			in_flight--;
+			if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP)
+			{
+				// Kernels before 5.6 have no IORING_OP_OPENAT, READ or WRITE. The op keeps
+				// its state and the whole remainder moves to the thread pool.
+				status = -1;
+				continue;
+			}
+			if (op->state == ADN_BATCH_OPEN)
+			{
+				adn_batch_opened(op, cqe->res);
+			}
+			else
+			{
+				adn_batch_transferred(op, cqe->res);
+			}
+			if (op->state != ADN_BATCH_DONE)
+			{
+				pending[pending_count++] = (size_t)cqe->user_data;
+			}
+		}
+		__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+	}
+	free(pending);
+	adn_ring_close(&ring);
+	return status;
+}
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+
+typedef struct
+{
+	AdnBatchOp* ops;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+} AdnBatchPool;
+
+static void* adn_batch_worker(void* arg)
+{
+	AdnBatchPool* pool = arg;
+	for (;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		size_t index = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if (index >= pool->count)
+		{
+			return NULL;
+		}
+		if (pool->ops[index].state != ADN_BATCH_DONE)
+		{
+			adn_batch_run_blocking(&pool->ops[index]);
+		}
+	}
+}
+#endif
+
+static void adn_batch_run(AdnBatchOp* ops, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+#ifdef ADN_HAVE_IO_URING
+	if (adn_batch_run_ring(ops, count) == 0)
+	{
+		return;
+	}
+	// Ops the ring already finished stay done; the rest restart on the thread pool. The ring
+	// has drained its in-flight requests, so their descriptors and buffers are free to reset.
+	for (size_t i = 0; i < count; i++)
+	{
+		if (ops[i].state == ADN_BATCH_TRANSFER)
+		{
+			close(ops[i].fd);
+			ops[i].fd = -1;
+			if (!ops[i].writing)
+			{
+				free(ops[i].data);
+				ops[i].data = NULL;
+				ops[i].length = 0;
+			}
+			ops[i].done = 0;
+			ops[i].state = ADN_BATCH_OPEN;
+		}
+	}
+#endif
+#ifdef _WIN32
+	for (size_t i = 0; i < count; i++)
+	{
+		adn_batch_run_blocking(&ops[i]);
+	}
+#else
+	AdnBatchPool pool = {ops, count, 0, PTHREAD_MUTEX_INITIALIZER};
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t thread_count = cpus > 0 ? (size_t)cpus * 2 : 4;
+	thread_count = thread_count > ADN_BATCH_MAX_THREADS ? ADN_BATCH_MAX_THREADS : thread_count;
+	thread_count = thread_count > count ? count : thread_count;
+	pthread_t threads[ADN_BATCH_MAX_THREADS];
+	size_t started = 0;
+	while (started < thread_count &&
+	       pthread_create(&threads[started], NULL, adn_batch_worker, &pool) == 0)
+	{
+		started++;
+	}
+	// Whatever the threads do not pick up, this thread does itself.
+	adn_batch_worker(&pool);
+	for (size_t i = 0; i < started; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+#endif
+}
+
+// Fills in the ops from the path array; contents is NULL for reads.
+static AdnBatchOp* adn_batch_prepare(void* paths, void* contents, size_t* count_out)
+{
+	int64_t count = paths ? adn_array_length(paths) : 0;
+	*count_out = 0;
+	if (count <= 0)
+	{
+		return NULL;
+	}
+	AdnBatchOp* ops = calloc((size_t)count, sizeof(AdnBatchOp));
+	if (!ops)
+	{
+		return NULL;
+	}
+	int64_t content_count = contents ? adn_array_length(contents) : 0;
+	for (int64_t i = 0; i < count; i++)
+	{
+		AdnBatchOp* op = &ops[i];
+		char* path = adn_array_get_string(paths, i);
+		op->path = adn_io_path(path);
+		adn_release(path);
+		op->fd = -1;
+		op->writing = contents != NULL;
+		if (!op->path || (op->writing && i >= content_count))
+		{
+			op->failed = 1;
+			op->state = ADN_BATCH_DONE;
+			continue;
+		}
+		if (op->writing)
+		{
+			char* content = adn_array_get_string(contents, i);
+			size_t content_len = 0;
+			const char* raw_content = unwrap_string_literal(content, &content_len);
+			op->data = malloc(content_len + 1);
+			if (op->data)
+			{
+				memcpy(op->data, raw_content ? raw_content : "", content_len);
+			}
+			op->length = content_len;
+			adn_release(content);
+			if (!op->data)
+			{
+				op->failed = 1;
+				op->state = ADN_BATCH_DONE;
+			}
+		}
+	}
+	*count_out = (size_t)count;
+	return ops;
+}
+
+static void adn_batch_finish(AdnBatchOp* op)
+{
+#ifndef _WIN32
+	if (op->fd >= 0)
+	{
+		close(op->fd);
+	}
+#endif
+	free(op->path);
+	free(op->data);
+}
+
+void* adn_read_many(void* paths)
+{
+	size_t count = 0;
+	AdnBatchOp* ops = adn_batch_prepare(paths, NULL, &count);
+	adn_batch_run(ops, count);
+	void* result = adn_array_create();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!ops[i].failed && ops[i].data)
+		{
+			ops[i].data[ops[i].length] = '\0';
+		}
+		adn_array_push_string(result, ops[i].failed || !ops[i].data ? "" : ops[i].data);
+		adn_batch_finish(&ops[i]);
+	}
+	free(ops);
+	return result;
+}
+
+int64_t adn_write_many(void* paths, void* contents)
+{
+	if (!contents)
+	{
+		return 0;
+	}
+	size_t count = 0;
+	AdnBatchOp* ops = adn_batch_prepare(paths, contents, &count);
+	adn_batch_run(ops, count);
+	int64_t written = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		written += ops[i].failed ? 0 : 1;
+		adn_batch_finish(&ops[i]);
+	}
+	free(ops);
+	return written;
+}
+
 char* adn_input(const char* prompt)
 {
+	adn_output_flush();
 	if (prompt && prompt[0] != '\0')
 	{
 		size_t print_len = 0;
@@ -211,6 +1385,7 @@ char* adn_input(const char* prompt)
 
 void adn_error(const char* fmt, ...)
 {
+	adn_output_flush();
 	va_list ap;
 	va_start(ap, fmt);
 	vfprintf(stderr, fmt, ap);
@@ -0,0 +1,1848 @@
+#include "json.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ADN_JSON_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Parsing runs in two passes, after simdjson. The first classifies the text 64 bytes
+// at a time into bitmasks and records the offset of every structural character, every
+// opening quote and the first byte of every other scalar. The second walks that index
+// and builds the json_value tree, so it never scans whitespace or string contents
+// byte by byte to find the next token.
+#define ADN_JSON_BLOCK_SIZE 64
+#define ADN_JSON_MAX_DEPTH 1024
+
+// Kind codes; the *_kind constants in libs/json/value.adn mirror them.
+typedef enum
+{
+	ADN_JSON_KIND_NULL,
+	ADN_JSON_KIND_BOOL,
+	ADN_JSON_KIND_NUMBER,
+	ADN_JSON_KIND_STRING,
+	ADN_JSON_KIND_ARRAY,
+	ADN_JSON_KIND_OBJECT,
+	ADN_JSON_KIND_COUNT
+} AdnJsonKind;
+
+static const char* const adn_json_kind_names[ADN_JSON_KIND_COUNT] = {
+    "null", "bool", "number", "string", "array", "object",
+};
+
+typedef struct
+{
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t op;
+	uint64_t whitespace;
+} AdnJsonBlock;
+
+typedef struct
+{
+	char* data;
+	size_t length;
+	size_t capacity;
+} AdnJsonScratch;
+
+// A json_value is a runtime native value holding one AdnJsonNode: the kind, a child count
+// and a payload, 16 bytes in all. Arrays and objects own exactly-sized child tables.
+// Objects with more than ADN_JSON_INDEX_THRESHOLD members keep an open-addressing index
+// of member positions right after their members, so key lookups do not scan.
+#define ADN_JSON_INDEX_THRESHOLD 8
+
+typedef struct AdnJsonNode AdnJsonNode;
+
+typedef struct
+{
+	char* key;
+	uint64_t hash;
+	AdnJsonNode* value;
+} AdnJsonMember;
+
+struct AdnJsonNode
+{
+	uint32_t kind;
+	uint32_t count;
+	union
+	{
+		double number;
+		int64_t truth;
+		char* string;
+		AdnJsonNode** items;
+		AdnJsonMember* members;
+	} as;
+};
+
+_Static_assert(sizeof(AdnJsonNode) == 16, "AdnJsonNode should stay 16 bytes");
+
+typedef struct
+{
+	const char* text;
+	size_t length;
+	uint32_t* positions;
+	size_t count;
+	size_t next;
+	int depth;
+	// Without `build` the parser only validates and allocates no runtime values.
+	int build;
+	AdnJsonScratch scratch;
+	// Children of the open containers, innermost last. A container takes its entries
+	// off the top when it closes, so each node gets an exactly-sized table.
+	AdnJsonNode** items;
+	size_t item_count;
+	size_t item_capacity;
+	AdnJsonMember* members;
+	size_t member_count;
+	size_t member_capacity;
+} AdnJsonParser;
+
+static int adn_json_trailing_zeros(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+#ifdef ADN_JSON_SSE2
+static uint64_t adn_json_mask_equal(__m128i chunk, char value)
+{
+	return (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(value)));
+}
+
+static void adn_json_classify(const unsigned char* bytes, AdnJsonBlock* block)
+{
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < ADN_JSON_BLOCK_SIZE / 16; i++)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(const void*)(bytes + i * 16));
+		// Setting bit 5 folds '[' onto '{' and ']' onto '}'.
+		__m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		int shift = i * 16;
+		block->quote |= adn_json_mask_equal(chunk, '"') << shift;
+		block->backslash |= adn_json_mask_equal(chunk, '\\') << shift;
+		block->op |= (adn_json_mask_equal(folded, '{') | adn_json_mask_equal(folded, '}') |
+		              adn_json_mask_equal(chunk, ':') | adn_json_mask_equal(chunk, ','))
+		             << shift;
+		block->whitespace |= (adn_json_mask_equal(chunk, ' ') | adn_json_mask_equal(chunk, '\t') |
+		                      adn_json_mask_equal(chunk, '\n') | adn_json_mask_equal(chunk, '\r'))
+		                     << shift;
+	}
+}
+#else
+static void adn_json_classify(const unsigned char* bytes, AdnJsonBlock* block)
+{
+	memset(block, 0, sizeof(*block));
+	for (int i = 0; i < ADN_JSON_BLOCK_SIZE; i++)
+	{
+		uint64_t bit = 1ULL << i;
+		switch (bytes[i])
+		{
+			case '"':
+				block->quote |= bit;
+				break;
+			case '\\':
+				block->backslash |= bit;
+				break;
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ':':
+			case ',':
+				block->op |= bit;
+				break;
+			case ' ':
+			case '\t':
+			case '\n':
+			case '\r':
+				block->whitespace |= bit;
+				break;
+			default:
+				break;
+		}
+	}
+}
+#endif
+
+// Bit i of the result is the parity of bits 0..i of `mask`.
+static uint64_t adn_json_prefix_xor(uint64_t mask)
+{
+	mask ^= mask << 1;
+	mask ^= mask << 2;
+	mask ^= mask << 4;
+	mask ^= mask << 8;
+	mask ^= mask << 16;
+	mask ^= mask << 32;
+	return mask;
+}
+
+// The characters escaped by a backslash: those after an odd-length run of backslashes.
+// `carry` is set when the previous block ended on such a run.
+static uint64_t adn_json_escaped(uint64_t backslash, uint64_t* carry)
+{
+	const uint64_t even_bits = 0x5555555555555555ULL;
+	backslash &= ~*carry;
+	uint64_t follows_escape = backslash << 1 | *carry;
+	uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+	uint64_t even_runs = odd_starts + backslash;
+	*carry = even_runs < odd_starts ? 1 : 0;
+	uint64_t invert = even_runs << 1;
+	return (even_bits ^ invert) & follows_escape;
+}
+
+static int adn_json_index(AdnJsonParser* parser)
+{
+	const unsigned char* text = (const unsigned char*)parser->text;
+	size_t length = parser->length;
+	uint64_t escape_carry = 0;
+	uint64_t in_string_carry = 0;
+	uint64_t scalar_carry = 0;
+
+	if (length >= UINT32_MAX)
+	{
+		return -1;
+	}
+	parser->positions = (uint32_t*)malloc((length + 1) * sizeof(uint32_t));
+	if (!parser->positions)
+	{
+		return -1;
+	}
+
+	for (size_t offset = 0; offset < length; offset += ADN_JSON_BLOCK_SIZE)
+	{
+		unsigned char padded[ADN_JSON_BLOCK_SIZE];
+		const unsigned char* bytes = text + offset;
+		AdnJsonBlock block;
+		if (length - offset < ADN_JSON_BLOCK_SIZE)
+		{
+			memset(padded, ' ', sizeof(padded));
+			memcpy(padded, bytes, length - offset);
+			bytes = padded;
+		}
+		adn_json_classify(bytes, &block);
+
+		uint64_t quote = block.quote & ~adn_json_escaped(block.backslash, &escape_carry);
+		// Set from each opening quote up to, not including, its closing quote.
+		uint64_t in_string = adn_json_prefix_xor(quote) ^ in_string_carry;
+		in_string_carry = (uint64_t)0 - (in_string >> 63);
+		uint64_t scalar = ~(block.op | block.whitespace | block.quote | in_string);
+		uint64_t scalar_start = scalar & ~(scalar << 1 | scalar_carry);
+		scalar_carry = scalar >> 63;
+
+		uint64_t structural = (block.op & ~in_string) | (quote & in_string) | scalar_start;
+		while (structural)
+		{
+			parser->positions[parser->count++] =
+			    (uint32_t)(offset + (size_t)adn_json_trailing_zeros(structural));
+			structural &= structural - 1;
+		}
+	}
+
+	// A string still open at the end of the text is unterminated.
+	return in_string_carry ? -1 : 0;
+}
+
+static int adn_json_is_delimiter(char c)
+{
+	return c == '\0' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' ||
+	       c == ':' || c == '[' || c == ']' || c == '{' || c == '}' || c == '"';
+}
+
+static int adn_json_next_token(AdnJsonParser* parser, size_t* out_offset)
+{
+	if (parser->next >= parser->count)
+	{
+		return 0;
+	}
+	*out_offset = parser->positions[parser->next++];
+	return 1;
+}
+
+static int adn_json_peek_char(const AdnJsonParser* parser)
+{
+	return parser->next < parser->count ? parser->text[parser->positions[parser->next]] : -1;
+}
+
+static int adn_json_scratch_reserve(AdnJsonScratch* scratch, size_t needed)
+{
+	if (scratch->capacity >= needed)
+	{
+		return 0;
+	}
+	size_t next_capacity = scratch->capacity ? scratch->capacity : 64;
+	while (next_capacity < needed)
+	{
+		next_capacity *= 2;
+	}
+	char* resized = (char*)realloc(scratch->data, next_capacity);
+	if (!resized)
+	{
+		return -1;
+	}
+	scratch->data = resized;
+	scratch->capacity = next_capacity;
+	return 0;
+}
+
+static int adn_json_hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static int adn_json_read_hex4(const char* text, uint32_t* out)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		int digit = adn_json_hex_value(text[i]);
+		if (digit < 0)
+		{
+			return -1;
+		}
+		value = value << 4 | (uint32_t)digit;
+	}
+	*out = value;
+	return 0;
+}
+
+static size_t adn_json_encode_utf8(uint32_t codepoint, char* out)
+{
+	if (codepoint < 0x80)
+	{
+		out[0] = (char)codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800)
+	{
+		out[0] = (char)(0xC0 | (codepoint >> 6));
+		out[1] = (char)(0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	if (codepoint < 0x10000)
+	{
+		out[0] = (char)(0xE0 | (codepoint >> 12));
+		out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (codepoint & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (codepoint >> 18));
+	out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (codepoint & 0x3F));
+	return 4;
+}
+
+// Decodes the string body starting at `cursor`, just past its opening quote, into
+// `scratch`. The closing quote must come before `end`.
+static int adn_json_decode_string(AdnJsonScratch* scratch, const char* cursor, const char* end)
+{
+	size_t used = 0;
+
+	for (;;)
+	{
+		const char* quote = (const char*)memchr(cursor, '"', (size_t)(end - cursor));
+		if (!quote)
+		{
+			return -1;
+		}
+		const char* backslash = (const char*)memchr(cursor, '\\', (size_t)(quote - cursor));
+		const char* stop = backslash ? backslash : quote;
+		size_t run = (size_t)(stop - cursor);
+		// An escape expands to at most four bytes, which is no more than it occupies.
+		if (adn_json_scratch_reserve(scratch, used + run + 5) != 0)
+		{
+			return -1;
+		}
+		memcpy(scratch->data + used, cursor, run);
+		used += run;
+		if (!backslash)
+		{
+			scratch->data[used] = '\0';
+			scratch->length = used;
+			return 0;
+		}
+
+		cursor = backslash + 1;
+		switch (*cursor)
+		{
+			case '"':
+			case '\\':
+			case '/':
+				scratch->data[used++] = *cursor;
+				break;
+			case 'b':
+				scratch->data[used++] = '\b';
+				break;
+			case 'f':
+				scratch->data[used++] = '\f';
+				break;
+			case 'n':
+				scratch->data[used++] = '\n';
+				break;
+			case 'r':
+				scratch->data[used++] = '\r';
+				break;
+			case 't':
+				scratch->data[used++] = '\t';
+				break;
+			case 'u':
+			{
+				uint32_t codepoint;
+				uint32_t low;
+				if (end - cursor < 5 || adn_json_read_hex4(cursor + 1, &codepoint) != 0)
+				{
+					return -1;
+				}
+				cursor += 4;
+				// Strings are length-tracked, so U+0000 is kept. A surrogate that is not
+				// half of a pair has no UTF-8 form and becomes U+FFFD.
+				if (codepoint >= 0xD800 && codepoint <= 0xDBFF && end - cursor >= 7 &&
+				    cursor[1] == '\\' && cursor[2] == 'u' &&
+				    adn_json_read_hex4(cursor + 3, &low) == 0 && low >= 0xDC00 && low <= 0xDFFF)
+				{
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					cursor += 6;
+				}
+				else if (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+				{
+					codepoint = 0xFFFD;
+				}
+				used += adn_json_encode_utf8(codepoint, scratch->data + used);
+				break;
+			}
+			default:
+				return -1;
+		}
+		cursor++;
+	}
+}
+
+// Accepts the same number syntax as parse_number in parse.adn: RFC 8259 numbers, so no
+// leading zeros and at least one digit on each side of the decimal point.
+static int adn_json_scan_number(const char* text, size_t offset, size_t* out_end, int* out_simple)
+{
+	size_t current = offset;
+	size_t digits_start;
+	int simple = 1;
+
+	if (text[current] == '-')
+	{
+		current++;
+	}
+	if (text[current] == '0')
+	{
+		current++;
+	}
+	else if (text[current] >= '1' && text[current] <= '9')
+	{
+		while (text[current] >= '0' && text[current] <= '9')
+		{
+			current++;
+		}
+	}
+	else
+	{
+		return -1;
+	}
+	if (text[current] == '.')
+	{
+		simple = 0;
+		current++;
+		digits_start = current;
+		while (text[current] >= '0' && text[current] <= '9')
+		{
+			current++;
+		}
+		if (current == digits_start)
+		{
+			return -1;
+		}
+	}
+	if (text[current] == 'e' || text[current] == 'E')
+	{
+		simple = 0;
+		current++;
+		if (text[current] == '+' || text[current] == '-')
+		{
+			current++;
+		}
+		digits_start = current;
+		while (text[current] >= '0' && text[current] <= '9')
+		{
+			current++;
+		}
+		if (current == digits_start)
+		{
+			return -1;
+		}
+	}
+	*out_end = current;
+	*out_simple = simple;
+	return 0;
+}
+
+static double adn_json_number_value(const char* text, size_t offset, size_t end, int simple)
+{
+	const char* digits = text + offset;
+	int negative = *digits == '-';
+	size_t count = end - offset - (size_t)negative;
+
+	// Up to 15 digits fit a double exactly, so the integer needs no rounding.
+	if (simple && count <= 15)
+	{
+		uint64_t value = 0;
+		for (size_t i = (size_t)negative; i < end - offset; i++)
+		{
+			value = value * 10 + (uint64_t)(digits[i] - '0');
+		}
+		return negative ? -(double)value : (double)value;
+	}
+	return strtod(digits, NULL);
+}
+
+static int adn_json_parse_string(AdnJsonParser* parser, size_t offset)
+{
+	return adn_json_decode_string(&parser->scratch, parser->text + offset + 1,
+	                              parser->text + parser->length);
+}
+
+static uint64_t adn_json_hash_bytes(const char* bytes, size_t length)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+static void adn_json_node_destroy(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	switch (node->kind)
+	{
+		case ADN_JSON_KIND_STRING:
+			adn_release(node->as.string);
+			break;
+		case ADN_JSON_KIND_ARRAY:
+			for (uint32_t i = 0; i < node->count; i++)
+			{
+				adn_release(node->as.items[i]);
+			}
+			free(node->as.items);
+			break;
+		case ADN_JSON_KIND_OBJECT:
+			for (uint32_t i = 0; i < node->count; i++)
+			{
+				adn_release(node->as.members[i].key);
+				adn_release(node->as.members[i].value);
+			}
+			free(node->as.members);
+			break;
+		default:
+			break;
+	}
+}
+
+static AdnJsonNode* adn_json_node_create(AdnJsonKind kind)
+{
+	AdnJsonNode* node =
+	    (AdnJsonNode*)adn_native_create((int64_t)sizeof(AdnJsonNode), adn_json_node_destroy);
+	if (node)
+	{
+		node->kind = (uint32_t)kind;
+	}
+	return node;
+}
+
+static size_t adn_json_index_capacity(size_t count)
+{
+	if (count <= ADN_JSON_INDEX_THRESHOLD)
+	{
+		return 0;
+	}
+	size_t capacity = 16;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+// The index slots behind an object's members hold member positions + 1, 0 when empty.
+static uint32_t* adn_json_object_index(const AdnJsonNode* node)
+{
+	return (uint32_t*)(void*)(node->as.members + node->count);
+}
+
+// Keys can hold U+0000, so they compare by their runtime length instead of strcmp.
+static int adn_json_same_key(const char* key, const char* other)
+{
+	size_t length = (size_t)adn_string_length(key);
+	return length == (size_t)adn_string_length(other) && memcmp(key, other, length) == 0;
+}
+
+// Position of the first member named `key`, or -1.
+static int64_t adn_json_object_find(const AdnJsonNode* node, const char* key, uint64_t hash)
+{
+	size_t capacity = adn_json_index_capacity(node->count);
+	if (capacity == 0)
+	{
+		for (uint32_t i = 0; i < node->count; i++)
+		{
+			const AdnJsonMember* member = &node->as.members[i];
+			if (member->hash == hash && adn_json_same_key(member->key, key))
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	const uint32_t* index = adn_json_object_index(node);
+	for (size_t slot = (size_t)hash & (capacity - 1);; slot = (slot + 1) & (capacity - 1))
+	{
+		if (index[slot] == 0)
+		{
+			return -1;
+		}
+		const AdnJsonMember* member = &node->as.members[index[slot] - 1];
+		if (member->hash == hash && adn_json_same_key(member->key, key))
+		{
+			return index[slot] - 1;
+		}
+	}
+}
+
+// Takes over the references held by `items`.
+static AdnJsonNode* adn_json_array_create(AdnJsonNode** items, size_t count)
+{
+	AdnJsonNode* node = adn_json_node_create(ADN_JSON_KIND_ARRAY);
+	AdnJsonNode** table = count ? (AdnJsonNode**)malloc(count * sizeof(AdnJsonNode*)) : NULL;
+	if (!node || (count && !table))
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			adn_release(items[i]);
+		}
+		free(table);
+		adn_release(node);
+		return NULL;
+	}
+	if (count)
+	{
+		memcpy(table, items, count * sizeof(AdnJsonNode*));
+	}
+	node->as.items = table;
+	node->count = (uint32_t)count;
+	return node;
+}
+
+// Takes over the references held by `members`. With repeated keys, lookups find the
+// first member of that name, as a scan in member order would.
+static AdnJsonNode* adn_json_object_create(AdnJsonMember* members, size_t count)
+{
+	AdnJsonNode* node = adn_json_node_create(ADN_JSON_KIND_OBJECT);
+	size_t capacity = adn_json_index_capacity(count);
+	size_t size = count * sizeof(AdnJsonMember) + capacity * sizeof(uint32_t);
+	AdnJsonMember* table = size ? (AdnJsonMember*)calloc(1, size) : NULL;
+	if (!node || (size && !table))
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			adn_release(members[i].key);
+			adn_release(members[i].value);
+		}
+		free(table);
+		adn_release(node);
+		return NULL;
+	}
+	if (count)
+	{
+		memcpy(table, members, count * sizeof(AdnJsonMember));
+	}
+	node->as.members = table;
+	node->count = (uint32_t)count;
+
+	uint32_t* index = adn_json_object_index(node);
+	for (size_t i = 0; i < count && capacity; i++)
+	{
+		size_t slot = (size_t)table[i].hash & (capacity - 1);
+		while (index[slot] != 0 && (table[index[slot] - 1].hash != table[i].hash ||
+		                            !adn_json_same_key(table[index[slot] - 1].key, table[i].key)))
+		{
+			slot = (slot + 1) & (capacity - 1);
+		}
+		if (index[slot] == 0)
+		{
+			index[slot] = (uint32_t)(i + 1);
+		}
+	}
+	return node;
+}
+
+static int adn_json_push_item(AdnJsonParser* parser, AdnJsonNode* item)
+{
+	if (parser->item_count == parser->item_capacity)
+	{
+		size_t capacity = parser->item_capacity ? parser->item_capacity * 2 : 64;
+		AdnJsonNode** items =
+		    (AdnJsonNode**)realloc(parser->items, capacity * sizeof(AdnJsonNode*));
+		if (!items)
+		{
+			adn_release(item);
+			return -1;
+		}
+		parser->items = items;
+		parser->item_capacity = capacity;
+	}
+	parser->items[parser->item_count++] = item;
+	return 0;
+}
+
+static int adn_json_push_member(AdnJsonParser* parser, char* key, uint64_t hash,
+	                            AdnJsonNode* value)
+{
+	if (parser->member_count == parser->member_capacity)
+	{
+		size_t capacity = parser->member_capacity ? parser->member_capacity * 2 : 64;
+		AdnJsonMember* members =
+		    (AdnJsonMember*)realloc(parser->members, capacity * sizeof(AdnJsonMember));
+		if (!members)
+		{
+			adn_release(key);
+			adn_release(value);
+			return -1;
+		}
+		parser->members = members;
+		parser->member_capacity = capacity;
+	}
+	parser->members[parser->member_count++] = (AdnJsonMember){key, hash, value};
+	return 0;
+}
+
+// Drops the entries a failed container left on the stacks.
+static void adn_json_unwind(AdnJsonParser* parser, size_t items, size_t members)
+{
+	while (parser->item_count > items)
+	{
+		adn_release(parser->items[--parser->item_count]);
+	}
+	while (parser->member_count > members)
+	{
+		parser->member_count--;
+		adn_release(parser->members[parser->member_count].key);
+		adn_release(parser->members[parser->member_count].value);
+	}
+}
+
+static int adn_json_parse_value(AdnJsonParser* parser, AdnJsonNode** out);
+
+static int adn_json_parse_array(AdnJsonParser* parser, AdnJsonNode** out)
+{
+	size_t base = parser->item_count;
+	size_t offset;
+
+	if (adn_json_peek_char(parser) == ']')
+	{
+		parser->next++;
+	}
+	else
+	{
+		for (;;)
+		{
+			AdnJsonNode* item = NULL;
+			if (adn_json_parse_value(parser, &item) != 0 ||
+			    (parser->build && adn_json_push_item(parser, item) != 0) ||
+			    !adn_json_next_token(parser, &offset) ||
+			    (parser->text[offset] != ',' && parser->text[offset] != ']'))
+			{
+				adn_json_unwind(parser, base, parser->member_count);
+				return -1;
+			}
+			if (parser->text[offset] == ']')
+			{
+				break;
+			}
+		}
+	}
+
+	if (parser->build)
+	{
+		*out = adn_json_array_create(parser->items + base, parser->item_count - base);
+		parser->item_count = base;
+		return *out ? 0 : -1;
+	}
+	return 0;
+}
+
+static int adn_json_parse_object(AdnJsonParser* parser, AdnJsonNode** out)
+{
+	size_t base = parser->member_count;
+	size_t offset;
+
+	if (adn_json_peek_char(parser) == '}')
+	{
+		parser->next++;
+	}
+	else
+	{
+		int closed = 0;
+		for (;;)
+		{
+			AdnJsonNode* child = NULL;
+			char* key = NULL;
+			uint64_t hash = 0;
+			if (!adn_json_next_token(parser, &offset) || parser->text[offset] != '"' ||
+			    adn_json_parse_string(parser, offset) != 0)
+			{
+				break;
+			}
+			if (parser->build)
+			{
+				key = adn_string_copy_bytes(parser->scratch.data,
+				                            (int64_t)parser->scratch.length);
+				hash = adn_json_hash_bytes(parser->scratch.data, parser->scratch.length);
+			}
+			if (!adn_json_next_token(parser, &offset) || parser->text[offset] != ':' ||
+			    adn_json_parse_value(parser, &child) != 0)
+			{
+				adn_release(key);
+				break;
+			}
+			if (parser->build && adn_json_push_member(parser, key, hash, child) != 0)
+			{
+				break;
+			}
+			if (!adn_json_next_token(parser, &offset) ||
+			    (parser->text[offset] != ',' && parser->text[offset] != '}'))
+			{
+				break;
+			}
+			if (parser->text[offset] == '}')
+			{
+				closed = 1;
+				break;
+			}
+		}
+		if (!closed)
+		{
+			adn_json_unwind(parser, parser->item_count, base);
+			return -1;
+		}
+	}
+
+	if (parser->build)
+	{
+		*out = adn_json_object_create(parser->members + base, parser->member_count - base);
+		parser->member_count = base;
+		return *out ? 0 : -1;
+	}
+	return 0;
+}
+
+static int adn_json_parse_literal(AdnJsonParser* parser, size_t offset, const char* word,
+	                              size_t length)
+{
+	if (parser->length - offset < length || memcmp(parser->text + offset, word, length) != 0 ||
+	    !adn_json_is_delimiter(parser->text[offset + length]))
+	{
+		return -1;
+	}
+	return 0;
+}
+
+static int adn_json_parse_value(AdnJsonParser* parser, AdnJsonNode** out)
+{
+	size_t offset;
+	int result = 0;
+
+	if (!adn_json_next_token(parser, &offset))
+	{
+		return -1;
+	}
+
+	switch (parser->text[offset])
+	{
+		case '{':
+		case '[':
+			if (++parser->depth > ADN_JSON_MAX_DEPTH)
+			{
+				return -1;
+			}
+			result = parser->text[offset] == '{' ? adn_json_parse_object(parser, out)
+			                                     : adn_json_parse_array(parser, out);
+			parser->depth--;
+			return result;
+		case '"':
+			if (adn_json_parse_string(parser, offset) != 0)
+			{
+				return -1;
+			}
+			if (parser->build)
+			{
+				*out = adn_json_node_create(ADN_JSON_KIND_STRING);
+				if (!*out)
+				{
+					return -1;
+				}
+				(*out)->as.string = adn_string_copy_bytes(parser->scratch.data,
+				                                          (int64_t)parser->scratch.length);
+			}
+			return 0;
+		case 't':
+		case 'f':
+		{
+			int truth = parser->text[offset] == 't';
+			if (adn_json_parse_literal(parser, offset, truth ? "true" : "false",
+			                           truth ? 4 : 5) != 0)
+			{
+				return -1;
+			}
+			if (parser->build)
+			{
+				*out = adn_json_node_create(ADN_JSON_KIND_BOOL);
+				if (!*out)
+				{
+					return -1;
+				}
+				(*out)->as.truth = truth;
+			}
+			return 0;
+		}
+		case 'n':
+			if (adn_json_parse_literal(parser, offset, "null", 4) != 0)
+			{
+				return -1;
+			}
+			if (parser->build)
+			{
+				*out = adn_json_node_create(ADN_JSON_KIND_NULL);
+				return *out ? 0 : -1;
+			}
+			return 0;
+		default:
+		{
+			size_t end;
+			int simple;
+			if (adn_json_scan_number(parser->text, offset, &end, &simple) != 0 ||
+			    !adn_json_is_delimiter(parser->text[end]))
+			{
+				return -1;
+			}
+			if (parser->build)
+			{
+				*out = adn_json_node_create(ADN_JSON_KIND_NUMBER);
+				if (!*out)
+				{
+					return -1;
+				}
+				(*out)->as.number = adn_json_number_value(parser->text, offset, end, simple);
+			}
+			return 0;
+		}
+	}
+}
+
+static void adn_json_parser_init(AdnJsonParser* parser, const char* text, int build)
+{
+	memset(parser, 0, sizeof(*parser));
+	parser->text = text ? text : "";
+	parser->length = strlen(parser->text);
+	parser->build = build;
+}
+
+static void adn_json_parser_free(AdnJsonParser* parser)
+{
+	free(parser->positions);
+	free(parser->scratch.data);
+	free(parser->items);
+	free(parser->members);
+}
+
+static int adn_json_run(AdnJsonParser* parser, AdnJsonNode** out)
+{
+	if (adn_json_index(parser) != 0 || adn_json_parse_value(parser, out) != 0)
+	{
+		return -1;
+	}
+	// Anything after the root value other than whitespace was indexed as a token.
+	if (parser->next != parser->count)
+	{
+		adn_release(*out);
+		*out = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+void* adn_json_parse(const char* text)
+{
+	AdnJsonParser parser;
+	AdnJsonNode* root = NULL;
+
+	adn_json_parser_init(&parser, text, 1);
+	if (adn_json_run(&parser, &root) != 0)
+	{
+		root = adn_json_node_create(ADN_JSON_KIND_NULL);
+	}
+	adn_json_parser_free(&parser);
+	return root;
+}
+
+int64_t adn_json_valid(const char* text)
+{
+	AdnJsonParser parser;
+	AdnJsonNode* root = NULL;
+	int ok;
+
+	adn_json_parser_init(&parser, text, 0);
+	ok = adn_json_run(&parser, &root) == 0;
+	adn_json_parser_free(&parser);
+	return ok ? 1 : 0;
+}
+
+void* adn_json_new_null(void)
+{
+	return adn_json_node_create(ADN_JSON_KIND_NULL);
+}
+
+void* adn_json_new_bool(int64_t value)
+{
+	AdnJsonNode* node = adn_json_node_create(ADN_JSON_KIND_BOOL);
+	if (node)
+	{
+		node->as.truth = value != 0;
+	}
+	return node;
+}
+
+void* adn_json_new_number(double value)
+{
+	AdnJsonNode* node = adn_json_node_create(ADN_JSON_KIND_NUMBER);
+	if (node)
+	{
+		node->as.number = value;
+	}
+	return node;
+}
+
+void* adn_json_new_string(const char* value)
+{
+	AdnJsonNode* node = adn_json_node_create(ADN_JSON_KIND_STRING);
+	if (node)
+	{
+		node->as.string = adn_string_copy_bytes(value, adn_string_length(value));
+	}
+	return node;
+}
+
+void* adn_json_new_array(void* values)
+{
+	int64_t count = values ? adn_array_length(values) : 0;
+	AdnJsonNode** items = count > 0 ? (AdnJsonNode**)malloc((size_t)count * sizeof(AdnJsonNode*))
+	                                : NULL;
+	if (count > 0 && !items)
+	{
+		return NULL;
+	}
+	for (int64_t i = 0; i < count; i++)
+	{
+		items[i] = (AdnJsonNode*)adn_array_get_ptr(values, i);
+	}
+	AdnJsonNode* node = adn_json_array_create(items, (size_t)(count > 0 ? count : 0));
+	free(items);
+	return node;
+}
+
+void* adn_json_new_object(void* keys, void* values)
+{
+	int64_t count = keys ? adn_array_length(keys) : 0;
+	int64_t value_count = values ? adn_array_length(values) : 0;
+	if (value_count < count)
+	{
+		count = value_count;
+	}
+	AdnJsonMember* members =
+	    count > 0 ? (AdnJsonMember*)malloc((size_t)count * sizeof(AdnJsonMember)) : NULL;
+	if (count > 0 && !members)
+	{
+		return NULL;
+	}
+	for (int64_t i = 0; i < count; i++)
+	{
+		char* key = adn_array_get_string(keys, i);
+		members[i] = (AdnJsonMember){key, adn_json_hash_bytes(key, (size_t)adn_string_length(key)),
+		                             (AdnJsonNode*)adn_array_get_ptr(values, i)};
+	}
+	AdnJsonNode* node = adn_json_object_create(members, (size_t)(count > 0 ? count : 0));
+	free(members);
+	return node;
+}
+
+int64_t adn_json_kind(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	return node ? node->kind : ADN_JSON_KIND_NULL;
+}
+
+char* adn_json_type_name(void* value)
+{
+	return (char*)adn_json_kind_names[adn_json_kind(value)];
+}
+
+char* adn_json_as_string(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || node->kind != ADN_JSON_KIND_STRING)
+	{
+		return adn_string_copy_bytes(NULL, 0);
+	}
+	return (char*)adn_retain(node->as.string);
+}
+
+double adn_json_as_number(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	return node && node->kind == ADN_JSON_KIND_NUMBER ? node->as.number : 0.0;
+}
+
+int64_t adn_json_as_bool(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	return node && node->kind == ADN_JSON_KIND_BOOL ? node->as.truth : 0;
+}
+
+int64_t adn_json_length(void* value)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || (node->kind != ADN_JSON_KIND_ARRAY && node->kind != ADN_JSON_KIND_OBJECT))
+	{
+		return 0;
+	}
+	return node->count;
+}
+
+// Lookups that miss return a fresh null value, so callers always get a json_value.
+void* adn_json_at(void* value, int64_t index)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || node->kind != ADN_JSON_KIND_ARRAY || index < 0 || index >= node->count)
+	{
+		return adn_json_new_null();
+	}
+	return adn_retain(node->as.items[index]);
+}
+
+char* adn_json_key_at(void* value, int64_t index)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || node->kind != ADN_JSON_KIND_OBJECT || index < 0 || index >= node->count)
+	{
+		return adn_string_copy_bytes(NULL, 0);
+	}
+	return (char*)adn_retain(node->as.members[index].key);
+}
+
+void* adn_json_value_at(void* value, int64_t index)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || node->kind != ADN_JSON_KIND_OBJECT || index < 0 || index >= node->count)
+	{
+		return adn_json_new_null();
+	}
+	return adn_retain(node->as.members[index].value);
+}
+
+static int64_t adn_json_member(void* value, const char* key)
+{
+	AdnJsonNode* node = (AdnJsonNode*)value;
+	if (!node || node->kind != ADN_JSON_KIND_OBJECT || !key)
+	{
+		return -1;
+	}
+	return adn_json_object_find(node, key,
+	                            adn_json_hash_bytes(key, (size_t)adn_string_length(key)));
+}
+
+void* adn_json_get(void* value, const char* key)
+{
+	int64_t position = adn_json_member(value, key);
+	if (position < 0)
+	{
+		return adn_json_new_null();
+	}
+	return adn_retain(((AdnJsonNode*)value)->as.members[position].value);
+}
+
+int64_t adn_json_has(void* value, const char* key)
+{
+	return adn_json_member(value, key) >= 0 ? 1 : 0;
+}
+
+// json.reader: a pull tokenizer over a file or over chunks fed by the caller. Input goes
+// through one buffer that only grows when a single token, or with next_record a single
+// top-level value, does not fit, so memory stays constant however long the input is.
+#define ADN_JSON_READER_CHUNK_SIZE (64 * 1024)
+
+// Event codes; libs/json/stream.adn mirrors them as constants.
+typedef enum
+{
+	ADN_JSON_EVENT_MORE = -2,
+	ADN_JSON_EVENT_ERROR = -1,
+	ADN_JSON_EVENT_END = 0,
+	ADN_JSON_EVENT_START_OBJECT = 1,
+	ADN_JSON_EVENT_END_OBJECT = 2,
+	ADN_JSON_EVENT_START_ARRAY = 3,
+	ADN_JSON_EVENT_END_ARRAY = 4,
+	ADN_JSON_EVENT_KEY = 5,
+	ADN_JSON_EVENT_STRING = 6,
+	ADN_JSON_EVENT_NUMBER = 7,
+	ADN_JSON_EVENT_BOOL = 8,
+	ADN_JSON_EVENT_NULL = 9
+} AdnJsonEvent;
+
+typedef enum
+{
+	ADN_JSON_EXPECT_VALUE,
+	ADN_JSON_EXPECT_FIRST_VALUE,
+	ADN_JSON_EXPECT_KEY,
+	ADN_JSON_EXPECT_FIRST_KEY,
+	ADN_JSON_EXPECT_COLON,
+	ADN_JSON_EXPECT_NEXT
+} AdnJsonExpect;
+
+// Readers are runtime values: close_reader releases the file and buffers early and leaves
+// the reader closed, so later calls see an error event, and the rest goes with the last
+// reference.
+typedef struct
+{
+	FILE* file;
+	// No more input will arrive: the file hit EOF or the caller called finish.
+	int finished;
+	int failed;
+	int closed;
+	char* data;
+	size_t start;
+	size_t length;
+	size_t capacity;
+	// Event state: the open containers and what may come next.
+	char stack[ADN_JSON_MAX_DEPTH];
+	int depth;
+	AdnJsonExpect expect;
+	AdnJsonScratch text;
+	double number;
+	int truth;
+	// Record state: where the pending top-level value starts and how far it was scanned.
+	int in_record;
+	size_t record_start;
+	size_t record_scan;
+	int record_depth;
+	int record_string;
+	int record_escape;
+	AdnJsonNode* record;
+} AdnJsonReader;
+
+static int adn_json_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Closes the file and frees the buffers; the reader itself stays valid.
+static void adn_json_reader_shut(AdnJsonReader* reader)
+{
+	if (reader->closed)
+	{
+		return;
+	}
+	if (reader->file)
+	{
+		fclose(reader->file);
+		reader->file = NULL;
+	}
+	adn_release(reader->record);
+	reader->record = NULL;
+	free(reader->text.data);
+	reader->text.data = NULL;
+	reader->text.length = 0;
+	reader->text.capacity = 0;
+	free(reader->data);
+	reader->data = NULL;
+	reader->start = 0;
+	reader->length = 0;
+	reader->finished = 1;
+	reader->closed = 1;
+}
+
+static void adn_json_reader_destroy(void* handle)
+{
+	adn_json_reader_shut((AdnJsonReader*)handle);
+}
+
+static AdnJsonReader* adn_json_reader_alloc(FILE* file)
+{
+	char* data = (char*)malloc(ADN_JSON_READER_CHUNK_SIZE + 1);
+	AdnJsonReader* reader = data ? (AdnJsonReader*)adn_native_create(
+	                                   (int64_t)sizeof(AdnJsonReader), adn_json_reader_destroy)
+	                             : NULL;
+	if (!reader)
+	{
+		free(data);
+		return NULL;
+	}
+	reader->file = file;
+	reader->data = data;
+	reader->capacity = ADN_JSON_READER_CHUNK_SIZE;
+	reader->expect = ADN_JSON_EXPECT_VALUE;
+	return reader;
+}
+
+// Moves the bytes still needed to the front of the buffer and makes room for `needed`
+// more after them.
+static int adn_json_reader_compact(AdnJsonReader* reader, size_t needed)
+{
+	size_t keep = reader->in_record && reader->record_start < reader->start
+	                  ? reader->record_start
+	                  : reader->start;
+	if (keep > 0)
+	{
+		memmove(reader->data, reader->data + keep, reader->length - keep);
+		reader->length -= keep;
+		reader->start -= keep;
+		if (reader->in_record)
+		{
+			reader->record_start -= keep;
+			reader->record_scan -= keep;
+		}
+	}
+	if (reader->capacity - reader->length < needed)
+	{
+		size_t capacity = reader->capacity;
+		while (capacity - reader->length < needed)
+		{
+			capacity *= 2;
+		}
+		char* data = (char*)realloc(reader->data, capacity + 1);
+		if (!data)
+		{
+			return -1;
+		}
+		reader->data = data;
+		reader->capacity = capacity;
+	}
+	return 0;
+}
+
+// Reads more of the file into the buffer. Returns 1 when bytes were added.
+static int adn_json_reader_fill(AdnJsonReader* reader)
+{
+	if (!reader->file || reader->finished)
+	{
+		return 0;
+	}
+	// Keep at least half the buffer free for each read so a token that outgrows it doubles
+	// the buffer instead of being refilled a few bytes at a time.
+	if (adn_json_reader_compact(reader, reader->capacity / 2) != 0)
+	{
+		reader->failed = 1;
+		reader->finished = 1;
+		return 0;
+	}
+	size_t read = fread(reader->data + reader->length, 1, reader->capacity - reader->length,
+	                    reader->file);
+	reader->length += read;
+	if (read == 0)
+	{
+		reader->finished = 1;
+		fclose(reader->file);
+		reader->file = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+static int adn_json_reader_fail(AdnJsonReader* reader)
+{
+	reader->failed = 1;
+	return ADN_JSON_EVENT_ERROR;
+}
+
+// What the input ran out in the middle of a token: wait for more or give up.
+static int adn_json_reader_starved(AdnJsonReader* reader)
+{
+	return reader->finished ? adn_json_reader_fail(reader) : ADN_JSON_EVENT_MORE;
+}
+
+static void adn_json_reader_after_value(AdnJsonReader* reader)
+{
+	reader->expect = reader->depth > 0 ? ADN_JSON_EXPECT_NEXT : ADN_JSON_EXPECT_VALUE;
+}
+
+static int adn_json_reader_open_container(AdnJsonReader* reader, char open)
+{
+	if (reader->depth >= ADN_JSON_MAX_DEPTH)
+	{
+		return adn_json_reader_fail(reader);
+	}
+	reader->stack[reader->depth++] = open;
+	reader->start++;
+	if (open == '{')
+	{
+		reader->expect = ADN_JSON_EXPECT_FIRST_KEY;
+		return ADN_JSON_EVENT_START_OBJECT;
+	}
+	reader->expect = ADN_JSON_EXPECT_FIRST_VALUE;
+	return ADN_JSON_EVENT_START_ARRAY;
+}
+
+static int adn_json_reader_close_container(AdnJsonReader* reader, char close)
+{
+	char open = close == '}' ? '{' : '[';
+	if (reader->depth == 0 || reader->stack[reader->depth - 1] != open)
+	{
+		return adn_json_reader_fail(reader);
+	}
+	reader->depth--;
+	reader->start++;
+	adn_json_reader_after_value(reader);
+	return close == '}' ? ADN_JSON_EVENT_END_OBJECT : ADN_JSON_EVENT_END_ARRAY;
+}
+
+// Decodes the string at the read position into `text`. Returns 1, 0 when the closing
+// quote has not arrived yet, or -1 when the string is malformed.
+static int adn_json_reader_string(AdnJsonReader* reader)
+{
+	const char* data = reader->data;
+	size_t scan = reader->start + 1;
+	for (;;)
+	{
+		const char* quote = (const char*)memchr(data + scan, '"', reader->length - scan);
+		if (!quote)
+		{
+			return 0;
+		}
+		size_t at = (size_t)(quote - data);
+		size_t backslash = at;
+		while (backslash - 1 > reader->start && data[backslash - 1] == '\\')
+		{
+			backslash--;
+		}
+		scan = at + 1;
+		if ((at - backslash) % 2 == 0)
+		{
+			break;
+		}
+	}
+	if (adn_json_decode_string(&reader->text, data + reader->start + 1, data + scan) != 0)
+	{
+		return -1;
+	}
+	reader->start = scan;
+	return 1;
+}
+
+static int adn_json_reader_scalar(AdnJsonReader* reader)
+{
+	size_t end = reader->start;
+	while (end < reader->length && !adn_json_is_delimiter(reader->data[end]))
+	{
+		end++;
+	}
+	if (end == reader->length && !reader->finished)
+	{
+		return ADN_JSON_EVENT_MORE;
+	}
+
+	size_t size = end - reader->start;
+	if (adn_json_scratch_reserve(&reader->text, size + 1) != 0)
+	{
+		return adn_json_reader_fail(reader);
+	}
+	memcpy(reader->text.data, reader->data + reader->start, size);
+	reader->text.data[size] = '\0';
+	reader->text.length = size;
+
+	int event;
+	if (strcmp(reader->text.data, "true") == 0 || strcmp(reader->text.data, "false") == 0)
+	{
+		reader->truth = reader->text.data[0] == 't';
+		event = ADN_JSON_EVENT_BOOL;
+	}
+	else if (strcmp(reader->text.data, "null") == 0)
+	{
+		event = ADN_JSON_EVENT_NULL;
+	}
+	else
+	{
+		size_t number_end;
+		int simple;
+		if (adn_json_scan_number(reader->text.data, 0, &number_end, &simple) != 0 ||
+		    number_end != size)
+		{
+			return adn_json_reader_fail(reader);
+		}
+		reader->number = adn_json_number_value(reader->text.data, 0, size, simple);
+		event = ADN_JSON_EVENT_NUMBER;
+	}
+	reader->start = end;
+	adn_json_reader_after_value(reader);
+	return event;
+}
+
+static int adn_json_reader_event(AdnJsonReader* reader)
+{
+	if (reader->failed)
+	{
+		return ADN_JSON_EVENT_ERROR;
+	}
+	for (;;)
+	{
+		while (reader->start < reader->length && adn_json_is_space(reader->data[reader->start]))
+		{
+			reader->start++;
+		}
+		if (reader->start == reader->length)
+		{
+			if (adn_json_reader_fill(reader))
+			{
+				continue;
+			}
+			if (!reader->finished)
+			{
+				return ADN_JSON_EVENT_MORE;
+			}
+			return reader->depth == 0 && reader->expect == ADN_JSON_EXPECT_VALUE
+			           ? ADN_JSON_EVENT_END
+			           : adn_json_reader_fail(reader);
+		}
+
+		char c = reader->data[reader->start];
+		int found;
+		switch (reader->expect)
+		{
+			case ADN_JSON_EXPECT_COLON:
+				if (c != ':')
+				{
+					return adn_json_reader_fail(reader);
+				}
+				reader->start++;
+				reader->expect = ADN_JSON_EXPECT_VALUE;
+				continue;
+			case ADN_JSON_EXPECT_NEXT:
+				if (c == ',')
+				{
+					reader->start++;
+					reader->expect = reader->stack[reader->depth - 1] == '{'
+					                     ? ADN_JSON_EXPECT_KEY
+					                     : ADN_JSON_EXPECT_VALUE;
+					continue;
+				}
+				if (c == '}' || c == ']')
+				{
+					return adn_json_reader_close_container(reader, c);
+				}
+				return adn_json_reader_fail(reader);
+			case ADN_JSON_EXPECT_FIRST_KEY:
+			case ADN_JSON_EXPECT_KEY:
+				if (c == '}' && reader->expect == ADN_JSON_EXPECT_FIRST_KEY)
+				{
+					return adn_json_reader_close_container(reader, c);
+				}
+				if (c != '"')
+				{
+					return adn_json_reader_fail(reader);
+				}
+				found = adn_json_reader_string(reader);
+				break;
+			case ADN_JSON_EXPECT_FIRST_VALUE:
+			case ADN_JSON_EXPECT_VALUE:
+				if (c == ']' && reader->expect == ADN_JSON_EXPECT_FIRST_VALUE)
+				{
+					return adn_json_reader_close_container(reader, c);
+				}
+				if (c == '{' || c == '[')
+				{
+					return adn_json_reader_open_container(reader, c);
+				}
+				if (c != '"')
+				{
+					int event = adn_json_reader_scalar(reader);
+					if (event == ADN_JSON_EVENT_MORE &&
+					    (adn_json_reader_fill(reader) || reader->finished))
+					{
+						continue;
+					}
+					return event;
+				}
+				found = adn_json_reader_string(reader);
+				break;
+		}
+
+		if (found < 0)
+		{
+			return adn_json_reader_fail(reader);
+		}
+		if (found == 0)
+		{
+			if (adn_json_reader_fill(reader))
+			{
+				continue;
+			}
+			return adn_json_reader_starved(reader);
+		}
+		if (reader->expect == ADN_JSON_EXPECT_FIRST_KEY || reader->expect == ADN_JSON_EXPECT_KEY)
+		{
+			reader->expect = ADN_JSON_EXPECT_COLON;
+			return ADN_JSON_EVENT_KEY;
+		}
+		adn_json_reader_after_value(reader);
+		return ADN_JSON_EVENT_STRING;
+	}
+}
+
+// Scans for the end of the pending top-level value without decoding it, tracking only
+// nesting and strings. Returns 1 with the value at record_start..record_scan, 0 when it
+// is not complete yet, or -1 at the end of the input.
+static int adn_json_reader_scan_record(AdnJsonReader* reader)
+{
+	for (;;)
+	{
+		const char* data = reader->data;
+		if (!reader->in_record)
+		{
+			while (reader->start < reader->length && adn_json_is_space(data[reader->start]))
+			{
+				reader->start++;
+			}
+			if (reader->start < reader->length)
+			{
+				reader->in_record = 1;
+				reader->record_start = reader->start;
+				reader->record_scan = reader->start;
+				reader->record_depth = 0;
+				reader->record_string = 0;
+				reader->record_escape = 0;
+			}
+		}
+		while (reader->in_record && reader->record_scan < reader->length)
+		{
+			char c = data[reader->record_scan++];
+			if (reader->record_string)
+			{
+				if (reader->record_escape)
+				{
+					reader->record_escape = 0;
+				}
+				else if (c == '\\')
+				{
+					reader->record_escape = 1;
+				}
+				else if (c == '"')
+				{
+					reader->record_string = 0;
+					if (reader->record_depth == 0)
+					{
+						return 1;
+					}
+				}
+			}
+			else if (c == '"')
+			{
+				reader->record_string = 1;
+			}
+			else if (c == '{' || c == '[')
+			{
+				reader->record_depth++;
+			}
+			else if (c == '}' || c == ']')
+			{
+				if (--reader->record_depth <= 0)
+				{
+					return 1;
+				}
+			}
+			else if (reader->record_depth == 0 && adn_json_is_delimiter(c))
+			{
+				// A top-level scalar ends at the first delimiter, which is not part of it.
+				reader->record_scan--;
+				return 1;
+			}
+		}
+		if (adn_json_reader_fill(reader))
+		{
+			continue;
+		}
+		if (!reader->finished)
+		{
+			return 0;
+		}
+		return reader->in_record ? 1 : -1;
+	}
+}
+
+void* adn_json_reader_open(const char* path)
+{
+	FILE* file = fopen(path ? path : "", "rb");
+	if (!file)
+	{
+		return NULL;
+	}
+	AdnJsonReader* reader = adn_json_reader_alloc(file);
+	if (!reader)
+	{
+		fclose(file);
+		return NULL;
+	}
+	setvbuf(file, NULL, _IONBF, 0);
+	return reader;
+}
+
+void* adn_json_reader_create(void)
+{
+	return adn_json_reader_alloc(NULL);
+}
+
+void adn_json_reader_feed(void* handle, const char* chunk)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	size_t size = chunk ? strlen(chunk) : 0;
+	if (!reader || reader->closed || reader->file || reader->finished || size == 0)
+	{
+		return;
+	}
+	if (adn_json_reader_compact(reader, size) != 0)
+	{
+		adn_json_reader_fail(reader);
+		return;
+	}
+	memcpy(reader->data + reader->length, chunk, size);
+	reader->length += size;
+}
+
+void adn_json_reader_finish(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	if (reader && !reader->file)
+	{
+		reader->finished = 1;
+	}
+}
+
+int64_t adn_json_reader_next(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	return reader && !reader->closed ? adn_json_reader_event(reader) : ADN_JSON_EVENT_ERROR;
+}
+
+char* adn_json_reader_text(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	if (!reader || !reader->text.data)
+	{
+		return adn_string_copy_bytes(NULL, 0);
+	}
+	return adn_string_copy_bytes(reader->text.data, (int64_t)reader->text.length);
+}
+
+double adn_json_reader_number(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	return reader ? reader->number : 0.0;
+}
+
+int64_t adn_json_reader_bool(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	return reader ? reader->truth : 0;
+}
+
+int64_t adn_json_reader_depth(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	return reader ? reader->depth : 0;
+}
+
+int64_t adn_json_reader_next_record(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	if (!reader || reader->closed || reader->failed)
+	{
+		return 0;
+	}
+	adn_release(reader->record);
+	reader->record = NULL;
+
+	int found = adn_json_reader_scan_record(reader);
+	if (found <= 0)
+	{
+		return 0;
+	}
+
+	AdnJsonParser parser;
+	char* end = reader->data + reader->record_scan;
+	char saved = *end;
+	*end = '\0';
+	adn_json_parser_init(&parser, reader->data + reader->record_start, 1);
+	int ok = adn_json_run(&parser, &reader->record) == 0;
+	adn_json_parser_free(&parser);
+	*end = saved;
+
+	reader->start = reader->record_scan;
+	reader->in_record = 0;
+	if (!ok)
+	{
+		adn_json_reader_fail(reader);
+		return 0;
+	}
+	return 1;
+}
+
+void* adn_json_reader_record(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	if (!reader || !reader->record)
+	{
+		return adn_json_new_null();
+	}
+	return adn_retain(reader->record);
+}
+
+int64_t adn_json_reader_failed(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	return reader && reader->failed ? 1 : 0;
+}
+
+void adn_json_reader_close(void* handle)
+{
+	AdnJsonReader* reader = (AdnJsonReader*)handle;
+	if (reader)
+	{
+		adn_json_reader_shut(reader);
+	}
+}
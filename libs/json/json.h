@@ -0,0 +1,94 @@
+#ifndef ADAN_JSON_H
+#define ADAN_JSON_H
+
+#include <stdint.h>
+
+// Parses `text` into a json_value tree, or the null value when it is not valid JSON.
+void* adn_json_parse(const char* text);
+
+int64_t adn_json_valid(const char* text);
+
+// json_value nodes. Constructors copy their arguments; the array and object ones expect
+// json_value items. Reads of the wrong kind return the zero value of their type, and
+// lookups that miss return a null node.
+void* adn_json_new_null(void);
+
+void* adn_json_new_bool(int64_t value);
+
+void* adn_json_new_number(double value);
+
+void* adn_json_new_string(const char* value);
+
+void* adn_json_new_array(void* values);
+
+void* adn_json_new_object(void* keys, void* values);
+
+int64_t adn_json_kind(void* value);
+
+char* adn_json_type_name(void* value);
+
+char* adn_json_as_string(void* value);
+
+double adn_json_as_number(void* value);
+
+int64_t adn_json_as_bool(void* value);
+
+int64_t adn_json_length(void* value);
+
+void* adn_json_at(void* value, int64_t index);
+
+char* adn_json_key_at(void* value, int64_t index);
+
+void* adn_json_value_at(void* value, int64_t index);
+
+void* adn_json_get(void* value, const char* key);
+
+int64_t adn_json_has(void* value, const char* key);
+
+// Streaming reader over a file (NULL when it cannot be opened) or over chunks passed to
+// adn_json_reader_feed. next returns one of the event codes in json.c, record the value
+// found by the last successful next_record. Readers are runtime values; close releases
+// the file and buffers early and is safe to repeat.
+void* adn_json_reader_open(const char* path);
+
+void* adn_json_reader_create(void);
+
+void adn_json_reader_feed(void* reader, const char* chunk);
+
+void adn_json_reader_finish(void* reader);
+
+int64_t adn_json_reader_next(void* reader);
+
+char* adn_json_reader_text(void* reader);
+
+double adn_json_reader_number(void* reader);
+
+int64_t adn_json_reader_bool(void* reader);
+
+int64_t adn_json_reader_depth(void* reader);
+
+int64_t adn_json_reader_next_record(void* reader);
+
+void* adn_json_reader_record(void* reader);
+
+int64_t adn_json_reader_failed(void* reader);
+
+void adn_json_reader_close(void* reader);
+
+int64_t adn_array_length(void* array);
+
+void* adn_array_get_ptr(void* array, int64_t index);
+
+char* adn_array_get_string(void* array, int64_t index);
+
+int64_t adn_string_length(const char* s);
+
+char* adn_string_copy_bytes(const char* bytes, int64_t length);
+
+void* adn_native_create(int64_t size, void (*destroy)(void*));
+
+void* adn_retain(void* value);
+
+void adn_release(void* value);
+
+#endif
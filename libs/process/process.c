@@ -27,6 +27,24 @@ extern char** environ;
 #define PATH_MAX 4096
 #endif
 
+#if defined(__GNUC__) && !defined(_WIN32)
+// Provided by the io module when it is linked in; it buffers stdout itself, so that
+// output has to be written out before a child shares the descriptor.
+__attribute__((weak)) void adn_flush(void);
+#endif
+
+static void adn_process_flush_output(void)
+{
+#if defined(__GNUC__) && !defined(_WIN32)
+	if (adn_flush)
+	{
+		adn_flush();
+	}
+#endif
+	fflush(stdout);
+	fflush(stderr);
+}
+
 typedef struct
 {
 	char* data;
@@ -245,7 +263,8 @@ static char** adn_process_build_argv(const char* command, void* args, int* argc_
 	for (int64_t i = 0; i < arg_count; i++)
 	{
 		char* value = adn_array_get_string(args, i);
-		argv[(size_t)i + 1] = value ? value : strdup("");
+		argv[(size_t)i + 1] = strdup(value ? value : "");
+		adn_release(value);
 	}
 	argv[(size_t)arg_count + 1] = NULL;
 	if (argc_out)
@@ -300,6 +319,7 @@ static void* adn_process_capture_exec(char* const argv[], int use_shell)
 		return adn_process_make_result(-1, "", "failed to create pipes");
 	}
 
+	adn_process_flush_output();
 	pid_t pid = fork();
 	if (pid < 0)
 	{
@@ -716,6 +736,7 @@ int64_t adn_process_run(const char* command)
 		free(normalized);
 		return -1;
 	}
+	adn_process_flush_output();
 	int status = system(normalized);
 	free(normalized);
 	return (int64_t)adn_process_result_code(status);
@@ -733,6 +754,7 @@ int64_t adn_process_run_args(const char* command, void* args)
 	{
 		return -1;
 	}
+	adn_process_flush_output();
 	pid_t pid = fork();
 	if (pid < 0)
 	{
@@ -799,6 +821,7 @@ int64_t adn_process_spawn(const char* command, void* args)
 	{
 		return -1;
 	}
+	adn_process_flush_output();
 	pid_t pid = fork();
 	if (pid < 0)
 	{
@@ -17,6 +17,8 @@ void adn_array_push_string(void* array, const char* value);
 
 char* adn_array_get_string(void* array, int64_t index);
 
+void adn_release(void* value);
+
 int64_t adn_process_id(void);
 
 int64_t adn_process_parent_id(void);
@@ -2,6 +2,7 @@
 
 #include <locale.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -93,14 +94,68 @@ typedef struct
 	int capture_count;
 } AdnRegexParser;
 
+// Instructions of the Pike VM that runs patterns without backreferences or lookaround.
+typedef enum
+{
+	ADN_REGEX_OP_CHAR,
+	ADN_REGEX_OP_ANY,
+	ADN_REGEX_OP_CLASS,
+	ADN_REGEX_OP_SPLIT,
+	ADN_REGEX_OP_JMP,
+	ADN_REGEX_OP_SAVE,
+	ADN_REGEX_OP_ASSERT_START,
+	ADN_REGEX_OP_ASSERT_END,
+	ADN_REGEX_OP_WORD_BOUNDARY,
+	ADN_REGEX_OP_NOT_WORD_BOUNDARY,
+	ADN_REGEX_OP_PROGRESS,
+	ADN_REGEX_OP_MATCH
+} AdnRegexOp;
+
+typedef struct
+{
+	AdnRegexOp op;
+	uint32_t literal;
+	const AdnRegexCharClass* char_class;
+	// SPLIT prefers x over y; JMP goes to x; SAVE stores into slot x. PROGRESS ends a loop
+	// iteration that started at slot x: an empty one leaves the loop for y.
+	int x;
+	int y;
+} AdnRegexInst;
+
+typedef struct AdnRegexDfa AdnRegexDfa;
+typedef struct AdnRegexVm AdnRegexVm;
+
 typedef struct
 {
 	AdnRegexNode* root;
 	int capture_count;
+	// Compiled VM code, or NULL when the pattern needs the backtracker.
+	AdnRegexInst* code;
+	size_t code_length;
+	// Capture slots followed by one iteration-start slot per loop that can match empty.
+	int slot_count;
+	// Lazily built DFAs for match/no-match questions: [0] anchored, [1] unanchored. NULL
+	// when the code tests word boundaries, which a DFA state cannot see.
+	AdnRegexDfa* dfa;
+	// Pike VM buffers, filled in by the first search.
+	AdnRegexVm* vm;
+	// Prefilter: a match can only start at 0 (anchored), where the UTF-8 prefix occurs,
+	// or at a byte in first_bytes. Used to skip ahead before running an engine. The
+	// prefix is searched for by its rarest byte, prefix[prefix_rare].
+	int anchored;
+	char* prefix;
+	size_t prefix_length;
+	size_t prefix_rare;
+	int has_first_bytes;
+	uint8_t first_bytes[32];
 } AdnRegexProgram;
 
+// Positions are codepoint indices. Pure ASCII text is matched straight from its bytes:
+// codepoints and offsets stay NULL and a position is a byte offset.
 typedef struct
 {
+	const char* source;
+	size_t size;
 	uint32_t* codepoints;
 	size_t* offsets;
 	size_t length;
@@ -120,6 +175,65 @@ typedef struct
 	AdnRegexCapture* captures;
 } AdnRegexMatch;
 
+// A lazy DFA state: the sorted set of VM pcs a match attempt can be waiting on. Its ASCII
+// transitions are cached as they are taken; other codepoints are stepped uncached.
+#define ADN_REGEX_DFA_MAX_STATES 256
+#define ADN_REGEX_DFA_ASCII 128
+
+typedef struct
+{
+	int* pcs;
+	size_t count;
+	uint64_t hash;
+	// MATCH is reachable here; match_at_end is -1 until the $ assertions are resolved.
+	int match;
+	int match_at_end;
+	uint16_t next[ADN_REGEX_DFA_ASCII];
+} AdnRegexDfaState;
+
+struct AdnRegexDfa
+{
+	AdnRegexDfaState* states;
+	size_t count;
+	size_t capacity;
+	// 1 + index of the start state at position 0 and elsewhere, 0 while unknown.
+	int start[2];
+	uint32_t* marks;
+	uint32_t generation;
+	int* stack;
+	int* seeds;
+	int* scratch;
+};
+
+typedef struct
+{
+	int* pcs;
+	size_t* slots;
+	size_t count;
+} AdnRegexThreadList;
+
+typedef struct
+{
+	int pc;
+	int slot;
+	size_t value;
+} AdnRegexVmJob;
+
+// Buffers sized for one program, kept with it in the cache between searches.
+struct AdnRegexVm
+{
+	const AdnRegexInst* code;
+	const AdnRegexText* text;
+	size_t slot_count;
+	uint32_t* marks;
+	uint32_t generation;
+	AdnRegexVmJob* stack;
+	size_t* scratch;
+	size_t* empty;
+	size_t* best;
+	AdnRegexThreadList lists[2];
+};
+
 enum
 {
 	ADN_REGEX_CLASS_DIGIT = 1u << 0,
@@ -368,6 +482,8 @@ static void adn_regex_text_free(AdnRegexText* text)
 	}
 	free(text->codepoints);
 	free(text->offsets);
+	text->source = NULL;
+	text->size = 0;
 	text->codepoints = NULL;
 	text->offsets = NULL;
 	text->length = 0;
@@ -390,6 +506,19 @@ static int adn_regex_text_init(AdnRegexText* view, const char* text)
 	}
 
 	length = strlen(text);
+	view->source = text;
+	view->size = length;
+	while (index < length && (unsigned char)text[index] < 0x80)
+	{
+		index++;
+	}
+	if (index == length)
+	{
+		view->length = length;
+		return 1;
+	}
+	index = 0;
+
 	view->codepoints = (uint32_t*)calloc(length + 1, sizeof(uint32_t));
 	view->offsets = (size_t*)calloc(length + 1, sizeof(size_t));
 	if (!view->codepoints || !view->offsets)
@@ -410,6 +539,43 @@ static int adn_regex_text_init(AdnRegexText* view, const char* text)
 	return 1;
 }
 
+static uint32_t adn_regex_text_at(const AdnRegexText* text, size_t position)
+{
+	return text->codepoints ? text->codepoints[position]
+	                        : (uint32_t)(unsigned char)text->source[position];
+}
+
+// Byte offset of a position; length maps to the end of the text.
+static size_t adn_regex_text_offset(const AdnRegexText* text, size_t position)
+{
+	return text->offsets ? text->offsets[position] : position;
+}
+
+// The position of the codepoint starting at a byte offset.
+static size_t adn_regex_text_position(const AdnRegexText* text, size_t offset)
+{
+	size_t low = 0;
+	size_t high = text->length;
+
+	if (!text->offsets)
+	{
+		return offset;
+	}
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (text->offsets[middle] < offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
 static int adn_regex_is_newline(uint32_t codepoint)
 {
 	return codepoint == '\n' || codepoint == '\r' || codepoint == 0x2028 ||
@@ -629,6 +795,10 @@ static void adn_regex_node_free(AdnRegexNode* node)
 	free(node);
 }
 
+static void adn_regex_dfa_free(AdnRegexDfa* dfa);
+
+static void adn_regex_vm_free(AdnRegexVm* vm);
+
 static void adn_regex_program_free(AdnRegexProgram* program)
 {
 	if (!program)
@@ -636,8 +806,24 @@ static void adn_regex_program_free(AdnRegexProgram* program)
 		return;
 	}
 	adn_regex_node_free(program->root);
+	free(program->code);
+	if (program->dfa)
+	{
+		adn_regex_dfa_free(&program->dfa[0]);
+		adn_regex_dfa_free(&program->dfa[1]);
+		free(program->dfa);
+	}
+	adn_regex_vm_free(program->vm);
+	free(program->vm);
+	free(program->prefix);
 	program->root = NULL;
 	program->capture_count = 0;
+	program->code = NULL;
+	program->code_length = 0;
+	program->dfa = NULL;
+	program->vm = NULL;
+	program->prefix = NULL;
+	program->prefix_length = 0;
 }
 
 static int adn_regex_node_list_push(AdnRegexNodeList* list, AdnRegexNode* node)
@@ -953,29 +1139,6 @@ static AdnRegexNode* adn_regex_parse_class(AdnRegexParser* parser)
 		{
 			if (have_pending_literal)
 			{
-				if (parser->index < parser->length && parser->pattern[parser->index] == '-' &&
-				    parser->index + 1 < parser->length &&
-				    parser->pattern[parser->index + 1] != ']')
-				{
-					AdnRegexClassItem range_item = {0};
-					parser->index++;
-					if (!adn_regex_parse_class_item(parser, &range_item) ||
-					    !range_item.is_literal)
-					{
-						parser->error = 1;
-						adn_regex_char_class_free(char_class);
-						return NULL;
-					}
-					if (!adn_regex_char_class_add_range(char_class, pending_literal,
-					                                   range_item.literal))
-					{
-						parser->error = 1;
-						adn_regex_char_class_free(char_class);
-						return NULL;
-					}
-					have_pending_literal = 0;
-					continue;
-				}
 				if (!adn_regex_char_class_add_range(char_class, pending_literal,
 				                               pending_literal))
 				{
@@ -983,6 +1146,27 @@ static AdnRegexNode* adn_regex_parse_class(AdnRegexParser* parser)
 					adn_regex_char_class_free(char_class);
 					return NULL;
 				}
+				have_pending_literal = 0;
+			}
+			if (parser->index < parser->length && parser->pattern[parser->index] == '-' &&
+			    parser->index + 1 < parser->length && parser->pattern[parser->index + 1] != ']')
+			{
+				AdnRegexClassItem range_item = {0};
+				parser->index++;
+				if (!adn_regex_parse_class_item(parser, &range_item) || !range_item.is_literal)
+				{
+					parser->error = 1;
+					adn_regex_char_class_free(char_class);
+					return NULL;
+				}
+				if (!adn_regex_char_class_add_range(char_class, item.literal,
+				                                   range_item.literal))
+				{
+					parser->error = 1;
+					adn_regex_char_class_free(char_class);
+					return NULL;
+				}
+				continue;
 			}
 			pending_literal = item.literal;
 			have_pending_literal = 1;
@@ -1443,95 +1627,708 @@ static AdnRegexNode* adn_regex_parse_expression(AdnRegexParser* parser)
 	return adn_regex_node_from_list(ADN_REGEX_NODE_ALTERNATION, &branches);
 }
 
-static int adn_regex_program_init(AdnRegexProgram* program, const char* pattern)
+// Upper bound on VM code size. Counted repeats are unrolled, so something like (...){500}
+// could otherwise get huge; such patterns stay on the backtracker.
+#define ADN_REGEX_MAX_CODE 20000
+
+typedef struct
 {
-	AdnRegexParser parser;
+	AdnRegexInst* code;
+	size_t length;
+	size_t capacity;
+	int slot_count;
+	int failed;
+} AdnRegexCompiler;
 
-	if (!program)
+static int adn_regex_node_nullable(const AdnRegexNode* node)
+{
+	if (!node)
 	{
-		return 0;
+		return 1;
 	}
-	memset(program, 0, sizeof(*program));
-	memset(&parser, 0, sizeof(parser));
-	parser.pattern = pattern ? pattern : "";
-	parser.length = strlen(parser.pattern);
-	program->root = adn_regex_parse_expression(&parser);
-	program->capture_count = parser.capture_count;
-	if (!program->root || parser.error || parser.index != parser.length)
+	switch (node->kind)
 	{
-		adn_regex_program_free(program);
-		return 0;
+		case ADN_REGEX_NODE_LITERAL:
+		case ADN_REGEX_NODE_DOT:
+		case ADN_REGEX_NODE_CLASS:
+			return 0;
+		case ADN_REGEX_NODE_SEQUENCE:
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				if (!adn_regex_node_nullable(node->as.list.items[i]))
+				{
+					return 0;
+				}
+			}
+			return 1;
+		case ADN_REGEX_NODE_ALTERNATION:
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				if (adn_regex_node_nullable(node->as.list.items[i]))
+				{
+					return 1;
+				}
+			}
+			return 0;
+		case ADN_REGEX_NODE_REPEAT:
+			return node->as.repeat.min == 0 || adn_regex_node_nullable(node->as.repeat.child);
+		case ADN_REGEX_NODE_GROUP:
+			return adn_regex_node_nullable(node->as.group.child);
+		default:
+			return 1;
 	}
-	return 1;
 }
 
-static AdnRegexCapture* adn_regex_captures_clone(const AdnRegexCapture* captures,
-	                                            size_t count)
+static int adn_regex_emit(AdnRegexCompiler* compiler, AdnRegexOp op)
 {
-	AdnRegexCapture* clone = (AdnRegexCapture*)calloc(count, sizeof(AdnRegexCapture));
-	if (!clone)
+	if (compiler->failed || compiler->length >= ADN_REGEX_MAX_CODE)
 	{
-		return NULL;
+		compiler->failed = 1;
+		return -1;
 	}
-	if (captures && count > 0)
+	if (compiler->length == compiler->capacity)
 	{
-		memcpy(clone, captures, sizeof(AdnRegexCapture) * count);
+		size_t capacity = compiler->capacity ? compiler->capacity * 2 : 32;
+		AdnRegexInst* code = realloc(compiler->code, capacity * sizeof(AdnRegexInst));
+		if (!code)
+		{
+			compiler->failed = 1;
+			return -1;
+		}
+		compiler->code = code;
+		compiler->capacity = capacity;
 	}
-	return clone;
+	AdnRegexInst* inst = &compiler->code[compiler->length];
+	memset(inst, 0, sizeof(*inst));
+	inst->op = op;
+	return (int)compiler->length++;
 }
 
-static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* text,
-	                            size_t position, AdnRegexCapture* captures,
-	                            size_t capture_count, size_t* out_position);
-
-static int adn_regex_match_sequence_items(const AdnRegexNode* const* items,
-	                                      size_t count, size_t index,
-	                                      const AdnRegexText* text,
-	                                      size_t position,
-	                                      AdnRegexCapture* captures,
-	                                      size_t capture_count,
-	                                      size_t* out_position);
+static void adn_regex_set_split(AdnRegexCompiler* compiler, int split, int body, int out,
+	                            int greedy)
+{
+	if (split >= 0 && !compiler->failed)
+	{
+		compiler->code[split].x = greedy ? body : out;
+		compiler->code[split].y = greedy ? out : body;
+	}
+}
 
-static int adn_regex_match_class(const AdnRegexCharClass* char_class,
-	                             uint32_t codepoint)
+static void adn_regex_compile_node(AdnRegexCompiler* compiler, const AdnRegexNode* node)
 {
-	int matched = 0;
-	size_t i;
+	int pc;
 
-	if (!char_class)
+	if (!node || compiler->failed)
 	{
-		return 0;
+		return;
 	}
 
-	for (i = 0; i < char_class->range_count; i++)
+	switch (node->kind)
 	{
-		if (codepoint >= char_class->ranges[i].start &&
-		    codepoint <= char_class->ranges[i].end)
+		case ADN_REGEX_NODE_EMPTY:
+			break;
+		case ADN_REGEX_NODE_LITERAL:
+			pc = adn_regex_emit(compiler, ADN_REGEX_OP_CHAR);
+			if (pc >= 0)
+			{
+				compiler->code[pc].literal = node->as.literal;
+			}
+			break;
+		case ADN_REGEX_NODE_DOT:
+			adn_regex_emit(compiler, ADN_REGEX_OP_ANY);
+			break;
+		case ADN_REGEX_NODE_CLASS:
+			pc = adn_regex_emit(compiler, ADN_REGEX_OP_CLASS);
+			if (pc >= 0)
+			{
+				compiler->code[pc].char_class = node->as.char_class;
+			}
+			break;
+		case ADN_REGEX_NODE_SEQUENCE:
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				adn_regex_compile_node(compiler, node->as.list.items[i]);
+			}
+			break;
+		case ADN_REGEX_NODE_ALTERNATION:
 		{
-			matched = 1;
+			// split L1, L2; L1: first; jmp end; L2: split ...; last
+			size_t count = node->as.list.count;
+			int* jumps = calloc(count ? count : 1, sizeof(int));
+			if (!jumps)
+			{
+				compiler->failed = 1;
+				return;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				if (i + 1 == count)
+				{
+					adn_regex_compile_node(compiler, node->as.list.items[i]);
+					break;
+				}
+				int split = adn_regex_emit(compiler, ADN_REGEX_OP_SPLIT);
+				adn_regex_compile_node(compiler, node->as.list.items[i]);
+				jumps[i] = adn_regex_emit(compiler, ADN_REGEX_OP_JMP);
+				adn_regex_set_split(compiler, split, split + 1, (int)compiler->length, 1);
+			}
+			for (size_t i = 0; i + 1 < count && !compiler->failed; i++)
+			{
+				compiler->code[jumps[i]].x = (int)compiler->length;
+			}
+			free(jumps);
+			break;
+		}
+		case ADN_REGEX_NODE_REPEAT:
+		{
+			int min = node->as.repeat.min;
+			int max = node->as.repeat.max;
+			int greedy = node->as.repeat.greedy;
+			if (min > ADN_REGEX_MAX_CODE || max > ADN_REGEX_MAX_CODE)
+			{
+				compiler->failed = 1;
+				return;
+			}
+			for (int i = 0; i < min; i++)
+			{
+				adn_regex_compile_node(compiler, node->as.repeat.child);
+			}
+			if (max < 0)
+			{
+				// Like the backtracker, an iteration that matched nothing ends the loop;
+				// otherwise the VM would drop that path as a revisit of the split.
+				int nullable = adn_regex_node_nullable(node->as.repeat.child);
+				int slot = compiler->slot_count;
+				int split = adn_regex_emit(compiler, ADN_REGEX_OP_SPLIT);
+				int progress = -1;
+				if (nullable)
+				{
+					compiler->slot_count++;
+					pc = adn_regex_emit(compiler, ADN_REGEX_OP_SAVE);
+					if (pc >= 0)
+					{
+						compiler->code[pc].x = slot;
+					}
+				}
+				adn_regex_compile_node(compiler, node->as.repeat.child);
+				if (nullable)
+				{
+					progress = adn_regex_emit(compiler, ADN_REGEX_OP_PROGRESS);
+				}
+				int jump = adn_regex_emit(compiler, ADN_REGEX_OP_JMP);
+				if (progress >= 0)
+				{
+					compiler->code[progress].x = slot;
+					compiler->code[progress].y = (int)compiler->length;
+				}
+				if (jump >= 0)
+				{
+					compiler->code[jump].x = split;
+				}
+				adn_regex_set_split(compiler, split, split + 1, (int)compiler->length, greedy);
+				break;
+			}
+			// x{min,max}: each optional copy can bail out to the end.
+			size_t optional = (size_t)(max - min);
+			int* splits = calloc(optional ? optional : 1, sizeof(int));
+			if (!splits)
+			{
+				compiler->failed = 1;
+				return;
+			}
+			for (size_t i = 0; i < optional; i++)
+			{
+				splits[i] = adn_regex_emit(compiler, ADN_REGEX_OP_SPLIT);
+				adn_regex_compile_node(compiler, node->as.repeat.child);
+			}
+			for (size_t i = 0; i < optional; i++)
+			{
+				adn_regex_set_split(compiler, splits[i], splits[i] + 1, (int)compiler->length,
+				                    greedy);
+			}
+			free(splits);
 			break;
 		}
+		case ADN_REGEX_NODE_GROUP:
+			if (node->as.group.capturing && node->as.group.index >= 0)
+			{
+				pc = adn_regex_emit(compiler, ADN_REGEX_OP_SAVE);
+				if (pc >= 0)
+				{
+					compiler->code[pc].x = node->as.group.index * 2;
+				}
+				adn_regex_compile_node(compiler, node->as.group.child);
+				pc = adn_regex_emit(compiler, ADN_REGEX_OP_SAVE);
+				if (pc >= 0)
+				{
+					compiler->code[pc].x = node->as.group.index * 2 + 1;
+				}
+			}
+			else
+			{
+				adn_regex_compile_node(compiler, node->as.group.child);
+			}
+			break;
+		case ADN_REGEX_NODE_ASSERT_START:
+			adn_regex_emit(compiler, ADN_REGEX_OP_ASSERT_START);
+			break;
+		case ADN_REGEX_NODE_ASSERT_END:
+			adn_regex_emit(compiler, ADN_REGEX_OP_ASSERT_END);
+			break;
+		case ADN_REGEX_NODE_WORD_BOUNDARY:
+			adn_regex_emit(compiler, ADN_REGEX_OP_WORD_BOUNDARY);
+			break;
+		case ADN_REGEX_NODE_NOT_WORD_BOUNDARY:
+			adn_regex_emit(compiler, ADN_REGEX_OP_NOT_WORD_BOUNDARY);
+			break;
+		case ADN_REGEX_NODE_BACKREF:
+		case ADN_REGEX_NODE_LOOK:
+			// These need the text matched so far; only the backtracker can do them.
+			compiler->failed = 1;
+			break;
 	}
+}
 
-	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_DIGIT) != 0)
+// Compiles the parsed pattern for the Pike VM as SAVE 0, pattern, SAVE 1, MATCH. Leaves
+// program->code NULL when the pattern has to stay on the backtracker.
+static void adn_regex_program_compile(AdnRegexProgram* program)
+{
+	AdnRegexCompiler compiler = {0};
+	compiler.slot_count = (program->capture_count + 1) * 2;
+	int pc = adn_regex_emit(&compiler, ADN_REGEX_OP_SAVE);
+	if (pc >= 0)
 	{
-		matched = adn_regex_is_digit(codepoint);
+		compiler.code[pc].x = 0;
 	}
-	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_SPACE) != 0)
+	adn_regex_compile_node(&compiler, program->root);
+	pc = adn_regex_emit(&compiler, ADN_REGEX_OP_SAVE);
+	if (pc >= 0)
 	{
-		matched = adn_regex_is_space(codepoint);
+		compiler.code[pc].x = 1;
 	}
-	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_WORD) != 0)
+	adn_regex_emit(&compiler, ADN_REGEX_OP_MATCH);
+	if (compiler.failed)
 	{
-		matched = adn_regex_is_word(codepoint);
+		free(compiler.code);
+		return;
 	}
-	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_ALPHA) != 0)
+	program->code = compiler.code;
+	program->code_length = compiler.length;
+	program->slot_count = compiler.slot_count;
+	program->vm = calloc(1, sizeof(AdnRegexVm));
+	if (!program->vm)
 	{
-		matched = adn_regex_is_alpha(codepoint);
+		free(program->code);
+		program->code = NULL;
+		return;
 	}
-	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_ALNUM) != 0)
+	for (size_t i = 0; i < compiler.length; i++)
 	{
-		matched = adn_regex_is_alnum(codepoint);
+		if (compiler.code[i].op == ADN_REGEX_OP_WORD_BOUNDARY ||
+		    compiler.code[i].op == ADN_REGEX_OP_NOT_WORD_BOUNDARY)
+		{
+			return;
+		}
+	}
+	program->dfa = calloc(2, sizeof(AdnRegexDfa));
+}
+
+static size_t adn_regex_encode_utf8(uint32_t codepoint, char* out)
+{
+	if (codepoint < 0x80)
+	{
+		out[0] = (char)codepoint;
+		return 1;
+	}
+	if (codepoint < 0x800)
+	{
+		out[0] = (char)(0xC0 | (codepoint >> 6));
+		out[1] = (char)(0x80 | (codepoint & 0x3F));
+		return 2;
+	}
+	if (codepoint < 0x10000)
+	{
+		out[0] = (char)(0xE0 | (codepoint >> 12));
+		out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (codepoint & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (codepoint >> 18));
+	out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (codepoint & 0x3F));
+	return 4;
+}
+
+// Appends the literal text every match of node starts with. Returns 1 when the whole
+// node was literal (or zero-width), so the caller may keep appending what follows it.
+static int adn_regex_node_prefix(const AdnRegexNode* node, AdnRegexStringBuilder* builder)
+{
+	if (!node)
+	{
+		return 1;
+	}
+	switch (node->kind)
+	{
+		case ADN_REGEX_NODE_EMPTY:
+		case ADN_REGEX_NODE_ASSERT_START:
+		case ADN_REGEX_NODE_ASSERT_END:
+		case ADN_REGEX_NODE_WORD_BOUNDARY:
+		case ADN_REGEX_NODE_NOT_WORD_BOUNDARY:
+		case ADN_REGEX_NODE_LOOK:
+			return 1;
+		case ADN_REGEX_NODE_LITERAL:
+		{
+			char bytes[4];
+			adn_regex_builder_append_n(builder, bytes,
+			                           adn_regex_encode_utf8(node->as.literal, bytes));
+			return 1;
+		}
+		case ADN_REGEX_NODE_SEQUENCE:
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				if (!adn_regex_node_prefix(node->as.list.items[i], builder))
+				{
+					return 0;
+				}
+			}
+			return 1;
+		case ADN_REGEX_NODE_ALTERNATION:
+			return node->as.list.count == 1 &&
+			       adn_regex_node_prefix(node->as.list.items[0], builder);
+		case ADN_REGEX_NODE_GROUP:
+			return adn_regex_node_prefix(node->as.group.child, builder);
+		case ADN_REGEX_NODE_REPEAT:
+			if (node->as.repeat.min > 0)
+			{
+				adn_regex_node_prefix(node->as.repeat.child, builder);
+			}
+			return 0;
+		default:
+			return 0;
+	}
+}
+
+static void adn_regex_first_byte_add(uint8_t* set, unsigned char byte)
+{
+	set[byte >> 3] |= (uint8_t)(1u << (byte & 7));
+}
+
+// Adds the first byte of every match of node to set. Returns whether node can match
+// without consuming anything; clears *known when the first byte cannot be told.
+static int adn_regex_node_first_bytes(const AdnRegexNode* node, uint8_t* set, int* known)
+{
+	int nullable;
+
+	if (!node)
+	{
+		return 1;
+	}
+	switch (node->kind)
+	{
+		case ADN_REGEX_NODE_LITERAL:
+		{
+			char bytes[4];
+			adn_regex_encode_utf8(node->as.literal, bytes);
+			adn_regex_first_byte_add(set, (unsigned char)bytes[0]);
+			return 0;
+		}
+		case ADN_REGEX_NODE_CLASS:
+		{
+			const AdnRegexCharClass* char_class = node->as.char_class;
+			if (char_class->negated || char_class->builtins != 0)
+			{
+				*known = 0;
+				return 0;
+			}
+			for (size_t i = 0; i < char_class->range_count; i++)
+			{
+				if (char_class->ranges[i].end >= 0x80)
+				{
+					*known = 0;
+					return 0;
+				}
+				for (uint32_t c = char_class->ranges[i].start; c <= char_class->ranges[i].end;
+				     c++)
+				{
+					adn_regex_first_byte_add(set, (unsigned char)c);
+				}
+			}
+			return 0;
+		}
+		case ADN_REGEX_NODE_SEQUENCE:
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				if (!adn_regex_node_first_bytes(node->as.list.items[i], set, known))
+				{
+					return 0;
+				}
+			}
+			return 1;
+		case ADN_REGEX_NODE_ALTERNATION:
+			nullable = 0;
+			for (size_t i = 0; i < node->as.list.count; i++)
+			{
+				nullable |= adn_regex_node_first_bytes(node->as.list.items[i], set, known);
+			}
+			return nullable;
+		case ADN_REGEX_NODE_GROUP:
+			return adn_regex_node_first_bytes(node->as.group.child, set, known);
+		case ADN_REGEX_NODE_REPEAT:
+			nullable = adn_regex_node_first_bytes(node->as.repeat.child, set, known);
+			return nullable || node->as.repeat.min == 0;
+		case ADN_REGEX_NODE_DOT:
+		case ADN_REGEX_NODE_BACKREF:
+			*known = 0;
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+// Rough byte frequencies in text and logs, most common last; 0 for everything rarer.
+static int adn_regex_byte_rank(unsigned char byte)
+{
+	static const char common[] = "kvbywgpfm9876543210ucdlhrsnioate ";
+	const char* hit = byte ? strchr(common, byte) : NULL;
+	return hit ? (int)(hit - common) + 1 : 0;
+}
+
+// Works out where matches can start, so searches can skip the rest with memchr.
+static void adn_regex_program_analyze(AdnRegexProgram* program)
+{
+	const AdnRegexNode* first = program->root;
+	AdnRegexStringBuilder prefix;
+	int known = 1;
+	int members = 0;
+	int member = 0;
+
+	while (first && first->kind == ADN_REGEX_NODE_SEQUENCE && first->as.list.count > 0)
+	{
+		first = first->as.list.items[0];
+	}
+	program->anchored = first && first->kind == ADN_REGEX_NODE_ASSERT_START;
+
+	adn_regex_builder_init(&prefix);
+	adn_regex_node_prefix(program->root, &prefix);
+	if (prefix.data && prefix.length > 0)
+	{
+		program->prefix = prefix.data;
+		program->prefix_length = prefix.length;
+		for (size_t i = 1; i < prefix.length; i++)
+		{
+			if (adn_regex_byte_rank((unsigned char)prefix.data[i]) <
+			    adn_regex_byte_rank((unsigned char)prefix.data[program->prefix_rare]))
+			{
+				program->prefix_rare = i;
+			}
+		}
+		return;
+	}
+	free(prefix.data);
+
+	if (adn_regex_node_first_bytes(program->root, program->first_bytes, &known) || !known)
+	{
+		return;
+	}
+	for (int byte = 0; byte < 256; byte++)
+	{
+		if ((program->first_bytes[byte >> 3] & (1u << (byte & 7))) != 0)
+		{
+			members++;
+			member = byte;
+		}
+	}
+	if (members == 1)
+	{
+		// A single possible first byte is a one-byte prefix.
+		program->prefix = malloc(2);
+		if (program->prefix)
+		{
+			program->prefix[0] = (char)member;
+			program->prefix[1] = '\0';
+			program->prefix_length = 1;
+			return;
+		}
+	}
+	program->has_first_bytes = 1;
+}
+
+static int adn_regex_program_init(AdnRegexProgram* program, const char* pattern)
+{
+	AdnRegexParser parser;
+
+	if (!program)
+	{
+		return 0;
+	}
+	memset(program, 0, sizeof(*program));
+	memset(&parser, 0, sizeof(parser));
+	parser.pattern = pattern ? pattern : "";
+	parser.length = strlen(parser.pattern);
+	program->root = adn_regex_parse_expression(&parser);
+	program->capture_count = parser.capture_count;
+	if (!program->root || parser.error || parser.index != parser.length)
+	{
+		adn_regex_program_free(program);
+		return 0;
+	}
+	adn_regex_program_compile(program);
+	adn_regex_program_analyze(program);
+	return 1;
+}
+
+// Compiled programs are kept in a small per-thread LRU cache keyed by the unwrapped
+// pattern, so a pattern used in a loop is parsed once. Programs handed out by
+// adn_regex_cached_program stay owned by the cache; nothing here nests, so an entry is
+// never evicted while a caller still uses it.
+#define ADN_REGEX_CACHE_SIZE 64
+
+typedef struct
+{
+	char* pattern;
+	uint64_t hash;
+	uint64_t last_used;
+	AdnRegexProgram program;
+} AdnRegexCacheEntry;
+
+typedef struct
+{
+	AdnRegexCacheEntry entries[ADN_REGEX_CACHE_SIZE];
+	uint64_t clock;
+	int64_t hits;
+	int64_t misses;
+} AdnRegexCache;
+
+static _Thread_local AdnRegexCache adn_regex_cache;
+
+static uint64_t adn_regex_hash_pattern(const char* pattern)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char* cursor = (const unsigned char*)pattern; *cursor; cursor++)
+	{
+		hash = (hash ^ *cursor) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+// The compiled program for `pattern`, or NULL when it does not parse.
+static const AdnRegexProgram* adn_regex_cached_program(const char* pattern)
+{
+	AdnRegexCache* cache = &adn_regex_cache;
+	uint64_t hash = adn_regex_hash_pattern(pattern);
+	AdnRegexCacheEntry* victim = &cache->entries[0];
+	cache->clock++;
+	for (size_t i = 0; i < ADN_REGEX_CACHE_SIZE; i++)
+	{
+		AdnRegexCacheEntry* entry = &cache->entries[i];
+		if (entry->pattern && entry->hash == hash && strcmp(entry->pattern, pattern) == 0)
+		{
+			entry->last_used = cache->clock;
+			cache->hits++;
+			return &entry->program;
+		}
+		if (!entry->pattern ? victim->pattern != NULL
+		                    : victim->pattern && entry->last_used < victim->last_used)
+		{
+			victim = entry;
+		}
+	}
+	cache->misses++;
+
+	AdnRegexProgram program;
+	char* key = strdup(pattern);
+	if (!key || !adn_regex_program_init(&program, pattern))
+	{
+		free(key);
+		return NULL;
+	}
+	free(victim->pattern);
+	adn_regex_program_free(&victim->program);
+	victim->pattern = key;
+	victim->hash = hash;
+	victim->last_used = cache->clock;
+	victim->program = program;
+	return &victim->program;
+}
+
+int64_t adn_regex_cache_hits(void)
+{
+	return adn_regex_cache.hits;
+}
+
+int64_t adn_regex_cache_misses(void)
+{
+	return adn_regex_cache.misses;
+}
+
+static AdnRegexCapture* adn_regex_captures_clone(const AdnRegexCapture* captures,
+	                                            size_t count)
+{
+	AdnRegexCapture* clone = (AdnRegexCapture*)calloc(count, sizeof(AdnRegexCapture));
+	if (!clone)
+	{
+		return NULL;
+	}
+	if (captures && count > 0)
+	{
+		memcpy(clone, captures, sizeof(AdnRegexCapture) * count);
+	}
+	return clone;
+}
+
+static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* text,
+	                            size_t position, AdnRegexCapture* captures,
+	                            size_t capture_count, size_t* out_position);
+
+static int adn_regex_match_sequence_items(const AdnRegexNode* const* items,
+	                                      size_t count, size_t index,
+	                                      const AdnRegexText* text,
+	                                      size_t position,
+	                                      AdnRegexCapture* captures,
+	                                      size_t capture_count,
+	                                      size_t* out_position);
+
+static int adn_regex_match_class(const AdnRegexCharClass* char_class,
+	                             uint32_t codepoint)
+{
+	int matched = 0;
+	size_t i;
+
+	if (!char_class)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < char_class->range_count; i++)
+	{
+		if (codepoint >= char_class->ranges[i].start &&
+		    codepoint <= char_class->ranges[i].end)
+		{
+			matched = 1;
+			break;
+		}
+	}
+
+	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_DIGIT) != 0)
+	{
+		matched = adn_regex_is_digit(codepoint);
+	}
+	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_SPACE) != 0)
+	{
+		matched = adn_regex_is_space(codepoint);
+	}
+	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_WORD) != 0)
+	{
+		matched = adn_regex_is_word(codepoint);
+	}
+	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_ALPHA) != 0)
+	{
+		matched = adn_regex_is_alpha(codepoint);
+	}
+	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_ALNUM) != 0)
+	{
+		matched = adn_regex_is_alnum(codepoint);
 	}
 	if (!matched && (char_class->builtins & ADN_REGEX_CLASS_LOWER) != 0)
 	{
@@ -1556,11 +2353,11 @@ static int adn_regex_is_word_boundary(const AdnRegexText* text, size_t position)
 
 	if (position > 0 && position - 1 < text->length)
 	{
-		left = adn_regex_is_word(text->codepoints[position - 1]);
+		left = adn_regex_is_word(adn_regex_text_at(text, position - 1));
 	}
 	if (position < text->length)
 	{
-		right = adn_regex_is_word(text->codepoints[position]);
+		right = adn_regex_is_word(adn_regex_text_at(text, position));
 	}
 	return left != right;
 }
@@ -1737,7 +2534,8 @@ static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* te
 			*out_position = position;
 			return 1;
 		case ADN_REGEX_NODE_LITERAL:
-			if (position < text->length && text->codepoints[position] == node->as.literal)
+			if (position < text->length &&
+			    adn_regex_text_at(text, position) == node->as.literal)
 			{
 				*out_position = position + 1;
 				return 1;
@@ -1745,7 +2543,7 @@ static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* te
 			return 0;
 		case ADN_REGEX_NODE_DOT:
 			if (position < text->length &&
-			    !adn_regex_is_newline(text->codepoints[position]))
+			    !adn_regex_is_newline(adn_regex_text_at(text, position)))
 			{
 				*out_position = position + 1;
 				return 1;
@@ -1753,7 +2551,8 @@ static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* te
 			return 0;
 		case ADN_REGEX_NODE_CLASS:
 			if (position < text->length &&
-			    adn_regex_match_class(node->as.char_class, text->codepoints[position]))
+			    adn_regex_match_class(node->as.char_class,
+			                          adn_regex_text_at(text, position)))
 			{
 				*out_position = position + 1;
 				return 1;
@@ -1831,8 +2630,8 @@ static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* te
 			}
 			for (size_t i = 0; i < length; i++)
 			{
-				if (text->codepoints[captures[index].start + i] !=
-				    text->codepoints[position + i])
+				if (adn_regex_text_at(text, captures[index].start + i) !=
+				    adn_regex_text_at(text, position + i))
 				{
 					return 0;
 				}
@@ -1911,9 +2710,716 @@ static int adn_regex_match_node(const AdnRegexNode* node, const AdnRegexText* te
 	return 0;
 }
 
-static int adn_regex_find_match(const AdnRegexProgram* program,
-	                           const AdnRegexText* text, size_t start,
-	                           AdnRegexMatch* match)
+static int adn_regex_inst_consumes(const AdnRegexInst* inst, uint32_t codepoint)
+{
+	switch (inst->op)
+	{
+		case ADN_REGEX_OP_CHAR:
+			return codepoint == inst->literal;
+		case ADN_REGEX_OP_ANY:
+			return !adn_regex_is_newline(codepoint);
+		case ADN_REGEX_OP_CLASS:
+			return adn_regex_match_class(inst->char_class, codepoint);
+		default:
+			return 0;
+	}
+}
+
+// Pike VM: every thread advances one codepoint at a time, so a search is
+// O(code_length * text_length) whatever the pattern looks like. Threads are kept in
+// priority order, which gives the same leftmost-first answer as the backtracker.
+// memchr for the prefix's rarest byte, then compare the rest around it. memchr is the
+// vectorised scan every libc has, unlike memmem.
+static const char* adn_regex_find_prefix(const AdnRegexProgram* program, const char* data,
+	                                     size_t size)
+{
+	size_t length = program->prefix_length;
+	size_t rare = program->prefix_rare;
+	const char* scan;
+	const char* last;
+
+	if (size < length)
+	{
+		return NULL;
+	}
+	scan = data + rare;
+	last = data + (size - length) + rare;
+	while (scan <= last)
+	{
+		const char* hit = memchr(scan, program->prefix[rare], (size_t)(last - scan) + 1);
+		if (!hit)
+		{
+			return NULL;
+		}
+		if (memcmp(hit - rare, program->prefix, length) == 0)
+		{
+			return hit - rare;
+		}
+		scan = hit + 1;
+	}
+	return NULL;
+}
+
+// The first position at or after start where a match can begin, or SIZE_MAX if there is
+// none.
+static size_t adn_regex_next_candidate(const AdnRegexProgram* program,
+	                                   const AdnRegexText* text, size_t start)
+{
+	size_t offset;
+
+	if (start > text->length)
+	{
+		return SIZE_MAX;
+	}
+	if (program->anchored)
+	{
+		return start == 0 ? 0 : SIZE_MAX;
+	}
+	offset = adn_regex_text_offset(text, start);
+	if (program->prefix_length > 0)
+	{
+		const char* hit = adn_regex_find_prefix(program, text->source + offset,
+		                                        text->size - offset);
+		return hit ? adn_regex_text_position(text, (size_t)(hit - text->source)) : SIZE_MAX;
+	}
+	if (program->has_first_bytes)
+	{
+		const unsigned char* bytes = (const unsigned char*)text->source;
+		for (; offset < text->size; offset++)
+		{
+			if ((program->first_bytes[bytes[offset] >> 3] & (1u << (bytes[offset] & 7))) != 0)
+			{
+				return adn_regex_text_position(text, offset);
+			}
+		}
+		return SIZE_MAX;
+	}
+	return start;
+}
+
+static int adn_regex_prefix_at(const AdnRegexProgram* program, const AdnRegexText* text,
+	                           size_t position)
+{
+	size_t offset = adn_regex_text_offset(text, position);
+	return text->size - offset >= program->prefix_length &&
+	       memcmp(text->source + offset, program->prefix, program->prefix_length) == 0;
+}
+
+static void adn_regex_vm_free(AdnRegexVm* vm)
+{
+	if (!vm)
+	{
+		return;
+	}
+	free(vm->marks);
+	free(vm->stack);
+	free(vm->scratch);
+	free(vm->empty);
+	free(vm->best);
+	for (size_t i = 0; i < 2; i++)
+	{
+		free(vm->lists[i].pcs);
+		free(vm->lists[i].slots);
+	}
+	memset(vm, 0, sizeof(*vm));
+}
+
+static AdnRegexVm* adn_regex_vm_prepare(const AdnRegexProgram* program)
+{
+	size_t code_length = program->code_length;
+	size_t slot_count = (size_t)program->slot_count;
+	AdnRegexVm* vm = program->vm;
+
+	if (!vm || vm->marks)
+	{
+		return vm;
+	}
+	vm->code = program->code;
+	vm->slot_count = slot_count;
+	vm->marks = calloc(code_length, sizeof(uint32_t));
+	vm->stack = malloc((code_length * 6 + 1) * sizeof(AdnRegexVmJob));
+	vm->scratch = malloc(slot_count * sizeof(size_t));
+	vm->empty = malloc(slot_count * sizeof(size_t));
+	vm->best = malloc(slot_count * sizeof(size_t));
+	for (size_t i = 0; i < 2; i++)
+	{
+		vm->lists[i].pcs = malloc(code_length * sizeof(int));
+		vm->lists[i].slots = malloc(code_length * slot_count * sizeof(size_t));
+	}
+	if (!vm->marks || !vm->stack || !vm->scratch || !vm->empty || !vm->best ||
+	    !vm->lists[0].pcs || !vm->lists[0].slots || !vm->lists[1].pcs || !vm->lists[1].slots)
+	{
+		adn_regex_vm_free(vm);
+		return NULL;
+	}
+	for (size_t i = 0; i < slot_count; i++)
+	{
+		vm->empty[i] = SIZE_MAX;
+	}
+	return vm;
+}
+
+// Adds pc and everything reachable from it without consuming input to the list. SAVE
+// instructions write into the scratch slots and are undone when the explore stack unwinds
+// past them, so each thread gets the slots of its own path.
+static void adn_regex_vm_add(AdnRegexVm* vm, AdnRegexThreadList* list, int pc,
+	                         const size_t* slots, size_t position)
+{
+	const AdnRegexInst* code = vm->code;
+	size_t depth = 0;
+
+	memcpy(vm->scratch, slots, vm->slot_count * sizeof(size_t));
+	vm->stack[depth++] = (AdnRegexVmJob){pc, -1, 0};
+	while (depth > 0)
+	{
+		AdnRegexVmJob job = vm->stack[--depth];
+		if (job.pc < 0)
+		{
+			vm->scratch[job.slot] = job.value;
+			continue;
+		}
+		if (code[job.pc].op == ADN_REGEX_OP_PROGRESS)
+		{
+			// Not marked: whether it continues depends on the slot, and both of its
+			// targets are marked, so it cannot loop.
+			int empty = vm->scratch[code[job.pc].x] == position;
+			vm->stack[depth++] = (AdnRegexVmJob){empty ? code[job.pc].y : job.pc + 1, -1, 0};
+			continue;
+		}
+		if (vm->marks[job.pc] == vm->generation)
+		{
+			continue;
+		}
+		vm->marks[job.pc] = vm->generation;
+
+		const AdnRegexInst* inst = &code[job.pc];
+		switch (inst->op)
+		{
+			case ADN_REGEX_OP_JMP:
+				vm->stack[depth++] = (AdnRegexVmJob){inst->x, -1, 0};
+				break;
+			case ADN_REGEX_OP_SPLIT:
+				vm->stack[depth++] = (AdnRegexVmJob){inst->y, -1, 0};
+				vm->stack[depth++] = (AdnRegexVmJob){inst->x, -1, 0};
+				break;
+			case ADN_REGEX_OP_SAVE:
+				vm->stack[depth++] = (AdnRegexVmJob){-1, inst->x, vm->scratch[inst->x]};
+				vm->scratch[inst->x] = position;
+				vm->stack[depth++] = (AdnRegexVmJob){job.pc + 1, -1, 0};
+				break;
+			case ADN_REGEX_OP_ASSERT_START:
+				if (position == 0)
+				{
+					vm->stack[depth++] = (AdnRegexVmJob){job.pc + 1, -1, 0};
+				}
+				break;
+			case ADN_REGEX_OP_ASSERT_END:
+				if (position == vm->text->length)
+				{
+					vm->stack[depth++] = (AdnRegexVmJob){job.pc + 1, -1, 0};
+				}
+				break;
+			case ADN_REGEX_OP_WORD_BOUNDARY:
+			case ADN_REGEX_OP_NOT_WORD_BOUNDARY:
+				if (adn_regex_is_word_boundary(vm->text, position) ==
+				    (inst->op == ADN_REGEX_OP_WORD_BOUNDARY))
+				{
+					vm->stack[depth++] = (AdnRegexVmJob){job.pc + 1, -1, 0};
+				}
+				break;
+			default:
+				list->pcs[list->count] = job.pc;
+				memcpy(list->slots + list->count * vm->slot_count, vm->scratch,
+				       vm->slot_count * sizeof(size_t));
+				list->count++;
+				break;
+		}
+	}
+}
+
+// Leftmost-first search from start. anchored only accepts a match starting at start;
+// must_end only accepts a match ending at the end of the text. match may be NULL.
+static int adn_regex_vm_search(const AdnRegexProgram* program, const AdnRegexText* text,
+	                           size_t start, int anchored, int must_end, AdnRegexMatch* match)
+{
+	size_t capture_count = (size_t)program->capture_count + 1;
+	AdnRegexVm* vm = adn_regex_vm_prepare(program);
+	AdnRegexThreadList* current;
+	AdnRegexThreadList* next;
+	int prefiltered = program->anchored || program->prefix_length > 0 ||
+	                  program->has_first_bytes;
+	int matched = 0;
+
+	if (!vm)
+	{
+		return 0;
+	}
+	vm->text = text;
+	current = &vm->lists[0];
+	next = &vm->lists[1];
+	current->count = 0;
+	vm->generation++;
+	for (size_t position = start;; position++)
+	{
+		if (!matched && !anchored && current->count == 0 && prefiltered)
+		{
+			// Nothing in flight: jump to where the next match could start.
+			position = adn_regex_next_candidate(program, text, position);
+			if (position == SIZE_MAX)
+			{
+				break;
+			}
+		}
+		if (!matched && (!anchored || position == start))
+		{
+			adn_regex_vm_add(vm, current, 0, vm->empty, position);
+		}
+		if (current->count == 0 && (matched || anchored || position >= text->length))
+		{
+			break;
+		}
+
+		vm->generation++;
+		next->count = 0;
+		for (size_t i = 0; i < current->count; i++)
+		{
+			const AdnRegexInst* inst = &program->code[current->pcs[i]];
+			const size_t* slots = current->slots + i * vm->slot_count;
+			if (inst->op == ADN_REGEX_OP_MATCH)
+			{
+				if (must_end && position != text->length)
+				{
+					continue;
+				}
+				memcpy(vm->best, slots, vm->slot_count * sizeof(size_t));
+				matched = 1;
+				// Threads after this one have lower priority than the match.
+				break;
+			}
+			if (position < text->length &&
+			    adn_regex_inst_consumes(inst, adn_regex_text_at(text, position)))
+			{
+				adn_regex_vm_add(vm, next, current->pcs[i] + 1, slots, position + 1);
+			}
+		}
+
+		AdnRegexThreadList* swap = current;
+		current = next;
+		next = swap;
+		if (position >= text->length)
+		{
+			break;
+		}
+	}
+	vm->text = NULL;
+
+	if (matched && match)
+	{
+		memset(match, 0, sizeof(*match));
+		match->captures = calloc(capture_count, sizeof(AdnRegexCapture));
+		if (!match->captures)
+		{
+			return 0;
+		}
+		for (size_t i = 0; i < capture_count; i++)
+		{
+			if (vm->best[i * 2] != SIZE_MAX && vm->best[i * 2 + 1] != SIZE_MAX)
+			{
+				match->captures[i].start = vm->best[i * 2];
+				match->captures[i].end = vm->best[i * 2 + 1];
+				match->captures[i].defined = 1;
+			}
+		}
+		match->start = vm->best[0];
+		match->end = vm->best[1];
+	}
+	return matched;
+}
+
+static void adn_regex_dfa_flush(AdnRegexDfa* dfa)
+{
+	for (size_t i = 0; i < dfa->count; i++)
+	{
+		free(dfa->states[i].pcs);
+	}
+	dfa->count = 0;
+	dfa->start[0] = 0;
+	dfa->start[1] = 0;
+}
+
+static void adn_regex_dfa_free(AdnRegexDfa* dfa)
+{
+	if (!dfa)
+	{
+		return;
+	}
+	adn_regex_dfa_flush(dfa);
+	free(dfa->states);
+	free(dfa->marks);
+	free(dfa->stack);
+	free(dfa->seeds);
+	free(dfa->scratch);
+	memset(dfa, 0, sizeof(*dfa));
+}
+
+static int adn_regex_compare_pcs(const void* left, const void* right)
+{
+	int a = *(const int*)left;
+	int b = *(const int*)right;
+	return (a > b) - (a < b);
+}
+
+// Follows the epsilon edges from the seeds into dfa->scratch and sorts the result. A state
+// keeps the consuming instructions, MATCH, and the $ assertions that may pass later.
+static size_t adn_regex_dfa_closure(AdnRegexDfa* dfa, const AdnRegexProgram* program,
+	                                size_t seed_count, int at_start, int at_end)
+{
+	size_t depth = 0;
+	size_t count = 0;
+
+	dfa->generation++;
+	for (size_t i = seed_count; i > 0; i--)
+	{
+		dfa->stack[depth++] = dfa->seeds[i - 1];
+	}
+	while (depth > 0)
+	{
+		int pc = dfa->stack[--depth];
+		if (dfa->marks[pc] == dfa->generation)
+		{
+			continue;
+		}
+		dfa->marks[pc] = dfa->generation;
+
+		const AdnRegexInst* inst = &program->code[pc];
+		switch (inst->op)
+		{
+			case ADN_REGEX_OP_JMP:
+				dfa->stack[depth++] = inst->x;
+				break;
+			case ADN_REGEX_OP_SPLIT:
+				dfa->stack[depth++] = inst->y;
+				dfa->stack[depth++] = inst->x;
+				break;
+			case ADN_REGEX_OP_SAVE:
+				dfa->stack[depth++] = pc + 1;
+				break;
+			case ADN_REGEX_OP_PROGRESS:
+				// Skipping an empty iteration does not change what can match.
+				dfa->stack[depth++] = inst->y;
+				dfa->stack[depth++] = pc + 1;
+				break;
+			case ADN_REGEX_OP_ASSERT_START:
+				if (at_start)
+				{
+					dfa->stack[depth++] = pc + 1;
+				}
+				break;
+			case ADN_REGEX_OP_ASSERT_END:
+				if (at_end)
+				{
+					dfa->stack[depth++] = pc + 1;
+				}
+				else
+				{
+					dfa->scratch[count++] = pc;
+				}
+				break;
+			default:
+				dfa->scratch[count++] = pc;
+				break;
+		}
+	}
+	qsort(dfa->scratch, count, sizeof(int), adn_regex_compare_pcs);
+	return count;
+}
+
+static int adn_regex_dfa_prepare(AdnRegexDfa* dfa, const AdnRegexProgram* program)
+{
+	if (dfa->marks)
+	{
+		return 1;
+	}
+	dfa->marks = calloc(program->code_length, sizeof(uint32_t));
+	dfa->stack = malloc((program->code_length * 2 + 1) * sizeof(int));
+	dfa->seeds = malloc((program->code_length + 1) * sizeof(int));
+	dfa->scratch = malloc((program->code_length + 1) * sizeof(int));
+	if (!dfa->marks || !dfa->stack || !dfa->seeds || !dfa->scratch)
+	{
+		free(dfa->marks);
+		free(dfa->stack);
+		free(dfa->seeds);
+		free(dfa->scratch);
+		dfa->marks = NULL;
+		dfa->stack = NULL;
+		dfa->seeds = NULL;
+		dfa->scratch = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+// Returns the index of the state holding the first count pcs of dfa->scratch, adding it
+// if needed. -1 when the state table is full or out of memory.
+static int adn_regex_dfa_intern(AdnRegexDfa* dfa, const AdnRegexProgram* program,
+	                            size_t count)
+{
+	uint64_t hash = 1469598103934665603ULL;
+	for (size_t i = 0; i < count; i++)
+	{
+		hash ^= (uint64_t)(unsigned int)dfa->scratch[i];
+		hash *= 1099511628211ULL;
+	}
+	for (size_t i = 0; i < dfa->count; i++)
+	{
+		AdnRegexDfaState* state = &dfa->states[i];
+		if (state->hash == hash && state->count == count &&
+		    memcmp(state->pcs, dfa->scratch, count * sizeof(int)) == 0)
+		{
+			return (int)i;
+		}
+	}
+	if (dfa->count >= ADN_REGEX_DFA_MAX_STATES)
+	{
+		return -1;
+	}
+	if (dfa->count == dfa->capacity)
+	{
+		size_t capacity = dfa->capacity ? dfa->capacity * 2 : 8;
+		AdnRegexDfaState* states = realloc(dfa->states, capacity * sizeof(AdnRegexDfaState));
+		if (!states)
+		{
+			return -1;
+		}
+		dfa->states = states;
+		dfa->capacity = capacity;
+	}
+
+	AdnRegexDfaState* state = &dfa->states[dfa->count];
+	memset(state, 0, sizeof(*state));
+	state->pcs = malloc((count ? count : 1) * sizeof(int));
+	if (!state->pcs)
+	{
+		return -1;
+	}
+	memcpy(state->pcs, dfa->scratch, count * sizeof(int));
+	state->count = count;
+	state->hash = hash;
+	state->match_at_end = -1;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (program->code[state->pcs[i]].op == ADN_REGEX_OP_MATCH)
+		{
+			state->match = 1;
+		}
+	}
+	return (int)dfa->count++;
+}
+
+// Interns the closure in dfa->scratch, flushing the whole table once it fills up. A
+// flush invalidates every state index the caller holds.
+static int adn_regex_dfa_intern_or_flush(AdnRegexDfa* dfa, const AdnRegexProgram* program,
+	                                     size_t count, int* flushed)
+{
+	int index = adn_regex_dfa_intern(dfa, program, count);
+	*flushed = 0;
+	if (index < 0 && dfa->count >= ADN_REGEX_DFA_MAX_STATES)
+	{
+		adn_regex_dfa_flush(dfa);
+		*flushed = 1;
+		index = adn_regex_dfa_intern(dfa, program, count);
+	}
+	return index;
+}
+
+static int adn_regex_dfa_start(AdnRegexDfa* dfa, const AdnRegexProgram* program,
+	                           int at_start)
+{
+	int flushed;
+	if (dfa->start[at_start])
+	{
+		return dfa->start[at_start] - 1;
+	}
+	dfa->seeds[0] = 0;
+	int index = adn_regex_dfa_intern_or_flush(dfa, program,
+	                                          adn_regex_dfa_closure(dfa, program, 1,
+	                                                                at_start, 0),
+	                                          &flushed);
+	if (index >= 0)
+	{
+		dfa->start[at_start] = index + 1;
+	}
+	return index;
+}
+
+static int adn_regex_dfa_step(AdnRegexDfa* dfa, const AdnRegexProgram* program, int from,
+	                          uint32_t codepoint, int unanchored)
+{
+	AdnRegexDfaState* state = &dfa->states[from];
+	size_t seed_count = 0;
+	int flushed;
+
+	if (codepoint < ADN_REGEX_DFA_ASCII && state->next[codepoint])
+	{
+		return state->next[codepoint] - 1;
+	}
+	for (size_t i = 0; i < state->count; i++)
+	{
+		if (adn_regex_inst_consumes(&program->code[state->pcs[i]], codepoint))
+		{
+			dfa->seeds[seed_count++] = state->pcs[i] + 1;
+		}
+	}
+	// The unanchored DFA also starts a new attempt at every position, at lowest priority.
+	if (unanchored)
+	{
+		dfa->seeds[seed_count++] = 0;
+	}
+	int index = adn_regex_dfa_intern_or_flush(dfa, program,
+	                                          adn_regex_dfa_closure(dfa, program, seed_count,
+	                                                                0, 0),
+	                                          &flushed);
+	if (index >= 0 && !flushed && codepoint < ADN_REGEX_DFA_ASCII)
+	{
+		dfa->states[from].next[codepoint] = (uint16_t)(index + 1);
+	}
+	return index;
+}
+
+static int adn_regex_dfa_match_at_end(AdnRegexDfa* dfa, const AdnRegexProgram* program,
+	                                  int index)
+{
+	AdnRegexDfaState* state = &dfa->states[index];
+	size_t seed_count = 0;
+
+	if (state->match)
+	{
+		return 1;
+	}
+	if (state->match_at_end < 0)
+	{
+		for (size_t i = 0; i < state->count; i++)
+		{
+			if (program->code[state->pcs[i]].op == ADN_REGEX_OP_ASSERT_END)
+			{
+				dfa->seeds[seed_count++] = state->pcs[i] + 1;
+			}
+		}
+		size_t count = adn_regex_dfa_closure(dfa, program, seed_count, 0, 1);
+		state->match_at_end = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (program->code[dfa->scratch[i]].op == ADN_REGEX_OP_MATCH)
+			{
+				state->match_at_end = 1;
+			}
+		}
+	}
+	return state->match_at_end;
+}
+
+// Answers whether the program matches without tracking where: 1 or 0, or -1 when this
+// program has no DFA (or it ran out of memory) and the VM has to answer instead.
+static int adn_regex_dfa_search(const AdnRegexProgram* program, const AdnRegexText* text,
+	                            size_t start, int anchored, int must_end)
+{
+	AdnRegexDfa* dfa;
+	int prefiltered = !anchored && (program->prefix_length > 0 || program->has_first_bytes);
+	size_t position;
+	int state;
+
+	if (!program->dfa)
+	{
+		return -1;
+	}
+	dfa = &program->dfa[anchored ? 0 : 1];
+	if (!adn_regex_dfa_prepare(dfa, program))
+	{
+		return -1;
+	}
+	if (text->length == 0)
+	{
+		// Both ^ and $ hold here, which the cached states do not model.
+		dfa->seeds[0] = 0;
+		size_t count = adn_regex_dfa_closure(dfa, program, 1, 1, 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (program->code[dfa->scratch[i]].op == ADN_REGEX_OP_MATCH)
+			{
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	position = start;
+	if (!anchored)
+	{
+		position = adn_regex_next_candidate(program, text, start);
+		if (position == SIZE_MAX)
+		{
+			return 0;
+		}
+	}
+	state = adn_regex_dfa_start(dfa, program, position == 0);
+	while (position < text->length)
+	{
+		if (state < 0)
+		{
+			return -1;
+		}
+		if (dfa->states[state].match && !must_end)
+		{
+			return 1;
+		}
+		if (dfa->states[state].count == 0)
+		{
+			return 0;
+		}
+		if (prefiltered && state + 1 == dfa->start[0])
+		{
+			// Back in the start state, so nothing is in flight: skip to the next candidate.
+			size_t next = adn_regex_next_candidate(program, text, position);
+			if (next == SIZE_MAX)
+			{
+				return 0;
+			}
+			if (next != position)
+			{
+				position = next;
+				continue;
+			}
+		}
+		state = adn_regex_dfa_step(dfa, program, state, adn_regex_text_at(text, position),
+		                           !anchored);
+		position++;
+	}
+	if (state < 0)
+	{
+		return -1;
+	}
+	return adn_regex_dfa_match_at_end(dfa, program, state);
+}
+
+// Whether the program matches anywhere from start, picking the cheapest engine.
+static int adn_regex_has_match(const AdnRegexProgram* program, const AdnRegexText* text,
+	                           size_t start, int anchored, int must_end)
+{
+	if (program->code)
+	{
+		int found = adn_regex_dfa_search(program, text, start, anchored, must_end);
+		if (found >= 0)
+		{
+			return found;
+		}
+		return adn_regex_vm_search(program, text, start, anchored, must_end, NULL);
+	}
+	return -1;
+}
+
+static int adn_regex_find_match(const AdnRegexProgram* program,
+	                           const AdnRegexText* text, size_t start,
+	                           AdnRegexMatch* match)
 {
 	size_t capture_count;
 
@@ -1923,8 +3429,18 @@ static int adn_regex_find_match(const AdnRegexProgram* program,
 	}
 
 	memset(match, 0, sizeof(*match));
+	if (program->code)
+	{
+		// The DFA rules out most non-matching texts before the VM tracks captures.
+		if (adn_regex_dfa_search(program, text, start, 0, 0) == 0)
+		{
+			return 0;
+		}
+		return adn_regex_vm_search(program, text, start, 0, 0, match);
+	}
 	capture_count = (size_t)program->capture_count + 1;
-	for (size_t position = start; position <= text->length; position++)
+	for (size_t position = adn_regex_next_candidate(program, text, start);
+	     position != SIZE_MAX; position = adn_regex_next_candidate(program, text, position + 1))
 	{
 		AdnRegexCapture* captures = (AdnRegexCapture*)calloc(capture_count,
 		                                                  sizeof(AdnRegexCapture));
@@ -1950,21 +3466,33 @@ static int adn_regex_find_match(const AdnRegexProgram* program,
 	return 0;
 }
 
+// Whole-text match: the engines run anchored at both ends, so "a|ab" matches "ab" even
+// though a leftmost-first search would stop at "a".
 static int adn_regex_match_full(const AdnRegexProgram* program,
 	                           const AdnRegexText* text)
 {
-	AdnRegexMatch match = {0};
-	if (!adn_regex_find_match(program, text, 0, &match))
+	if (!program || !program->root || !text)
 	{
 		return 0;
 	}
-	if (match.start == 0 && match.end == text->length)
+	int found = adn_regex_has_match(program, text, 0, 1, 1);
+	if (found >= 0)
 	{
-		free(match.captures);
-		return 1;
+		return found;
 	}
-	free(match.captures);
-	return 0;
+	size_t capture_count = (size_t)program->capture_count + 1;
+	AdnRegexCapture* captures = (AdnRegexCapture*)calloc(capture_count,
+	                                                  sizeof(AdnRegexCapture));
+	size_t end_position = 0;
+	if (!captures)
+	{
+		return 0;
+	}
+	found = adn_regex_match_node(program->root, text, 0, captures, capture_count,
+	                            &end_position) &&
+	        end_position == text->length;
+	free(captures);
+	return found;
 }
 
 static int adn_regex_match_from_start(const AdnRegexProgram* program,
@@ -1975,10 +3503,17 @@ static int adn_regex_match_from_start(const AdnRegexProgram* program,
 	                                                  sizeof(AdnRegexCapture));
 	size_t end_position = 0;
 	int matched;
-	if (!captures)
+	if (program->prefix_length > 0 && !adn_regex_prefix_at(program, text, 0))
 	{
+		free(captures);
 		return 0;
 	}
+	matched = adn_regex_has_match(program, text, 0, 1, 0);
+	if (matched >= 0 || !captures)
+	{
+		free(captures);
+		return matched > 0;
+	}
 	matched = adn_regex_match_node(program->root, text, 0, captures, capture_count,
 	                              &end_position);
 	free(captures);
@@ -1989,7 +3524,13 @@ static int adn_regex_match_to_end(const AdnRegexProgram* program,
 	                             const AdnRegexText* text)
 {
 	size_t capture_count = (size_t)program->capture_count + 1;
-	for (size_t position = 0; position <= text->length; position++)
+	int found = adn_regex_has_match(program, text, 0, 0, 1);
+	if (found >= 0)
+	{
+		return found;
+	}
+	for (size_t position = adn_regex_next_candidate(program, text, 0); position != SIZE_MAX;
+	     position = adn_regex_next_candidate(program, text, position + 1))
 	{
 		AdnRegexCapture* captures = (AdnRegexCapture*)calloc(capture_count,
 		                                                  sizeof(AdnRegexCapture));
@@ -2031,8 +3572,9 @@ static void adn_regex_builder_append_slice(AdnRegexStringBuilder* builder,
 	{
 		return;
 	}
-	adn_regex_builder_append_n(builder, text + view->offsets[start],
-	                         view->offsets[end] - view->offsets[start]);
+	size_t offset = adn_regex_text_offset(view, start);
+	adn_regex_builder_append_n(builder, text + offset,
+	                         adn_regex_text_offset(view, end) - offset);
 }
 
 static char* adn_regex_expand_replacement(const char* replacement,
@@ -2115,9 +3657,8 @@ static char* adn_regex_expand_replacement(const char* replacement,
 }
 
 static int adn_regex_compile_sources(const char* pattern, const char* text,
-	                                char** out_pattern,
 	                                char** out_text,
-	                                AdnRegexProgram* out_program,
+	                                const AdnRegexProgram** out_program,
 	                                AdnRegexText* out_view)
 {
 	char* raw_pattern = adn_regex_unwrap_string(pattern);
@@ -2128,33 +3669,30 @@ static int adn_regex_compile_sources(const char* pattern, const char* text,
 		free(raw_text);
 		return 0;
 	}
-	if (!adn_regex_program_init(out_program, raw_pattern))
+	*out_program = adn_regex_cached_program(raw_pattern);
+	free(raw_pattern);
+	if (!*out_program)
 	{
-		free(raw_pattern);
 		free(raw_text);
 		return 0;
 	}
 	if (!adn_regex_text_init(out_view, raw_text))
 	{
-		adn_regex_program_free(out_program);
-		free(raw_pattern);
 		free(raw_text);
 		return 0;
 	}
-	*out_pattern = raw_pattern;
 	*out_text = raw_text;
 	return 1;
 }
 
-static int adn_regex_compile_pattern(const char* pattern, char** out_pattern,
-	                                AdnRegexProgram* out_program)
+static int adn_regex_compile_pattern(const char* pattern, char** out_pattern)
 {
 	char* raw_pattern = adn_regex_unwrap_string(pattern);
 	if (!raw_pattern)
 	{
 		return 0;
 	}
-	if (!adn_regex_program_init(out_program, raw_pattern))
+	if (!adn_regex_cached_program(raw_pattern))
 	{
 		free(raw_pattern);
 		return 0;
@@ -2165,11 +3703,9 @@ static int adn_regex_compile_pattern(const char* pattern, char** out_pattern,
 
 int64_t adn_regex_valid(const char* pattern)
 {
-	AdnRegexProgram program = {0};
 	char* raw_pattern = NULL;
-	int ok = adn_regex_compile_pattern(pattern, &raw_pattern, &program);
+	int ok = adn_regex_compile_pattern(pattern, &raw_pattern);
 	free(raw_pattern);
-	adn_regex_program_free(&program);
 	return ok ? 1 : 0;
 }
 
@@ -2180,7 +3716,7 @@ char* adn_regex_escape(const char* text)
 	AdnRegexStringBuilder builder = {0};
 	if (!raw_text)
 	{
-		return strdup("");
+		return adn_string_adopt(strdup(""));
 	}
 	adn_regex_builder_init(&builder);
 	for (size_t i = 0; raw_text[i] != '\0'; i++)
@@ -2192,118 +3728,104 @@ char* adn_regex_escape(const char* text)
 		adn_regex_builder_append_char(&builder, raw_text[i]);
 	}
 	free(raw_text);
-	return adn_regex_builder_finish(&builder);
-}
-
-char* adn_regex_compile(const char* pattern)
-{
-	AdnRegexProgram program = {0};
-	char* raw_pattern = NULL;
-	if (!adn_regex_compile_pattern(pattern, &raw_pattern, &program))
-	{
-		return strdup("");
-	}
-	adn_regex_program_free(&program);
-	return raw_pattern;
+	return adn_string_adopt(adn_regex_builder_finish(&builder));
 }
 
 int64_t adn_regex_matches(const char* pattern, const char* text)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
 	int matched;
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
 		return 0;
 	}
-	matched = adn_regex_match_full(&program, &view);
+	matched = adn_regex_match_full(program, &view);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
 	free(raw_text);
 	return matched ? 1 : 0;
 }
 
 int64_t adn_regex_find(const char* pattern, const char* text)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
 	AdnRegexMatch match = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
 	int64_t result = -1;
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
 		return -1;
 	}
-	if (adn_regex_find_match(&program, &view, 0, &match))
+	if (adn_regex_find_match(program, &view, 0, &match))
 	{
-		result = (int64_t)view.offsets[match.start];
+		result = (int64_t)adn_regex_text_offset(&view, match.start);
 	}
 	adn_regex_match_free(&match);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
 	free(raw_text);
 	return result;
 }
 
 int64_t adn_regex_contains(const char* pattern, const char* text)
 {
-	return adn_regex_find(pattern, text) >= 0 ? 1 : 0;
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	char* raw_text = NULL;
+	int found;
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
+	{
+		return 0;
+	}
+	found = adn_regex_has_match(program, &view, 0, 0, 0);
+	adn_regex_text_free(&view);
+	free(raw_text);
+	if (found < 0)
+	{
+		return adn_regex_find(pattern, text) >= 0 ? 1 : 0;
+	}
+	return found ? 1 : 0;
 }
 
 int64_t adn_regex_starts_with(const char* pattern, const char* text)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
 	int matched;
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
 		return 0;
 	}
-	matched = adn_regex_match_from_start(&program, &view);
+	matched = adn_regex_match_from_start(program, &view);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
 	free(raw_text);
 	return matched ? 1 : 0;
 }
 
 int64_t adn_regex_ends_with(const char* pattern, const char* text)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
 	int matched;
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
 		return 0;
 	}
-	matched = adn_regex_match_to_end(&program, &view);
+	matched = adn_regex_match_to_end(program, &view);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
 	free(raw_text);
 	return matched ? 1 : 0;
 }
 
 char* adn_regex_replace(const char* pattern, const char* text, const char* replacement)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
 	AdnRegexMatch match = {0};
 	AdnRegexStringBuilder builder = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
 	char* raw_replacement = adn_regex_unwrap_string(replacement);
 	char* expanded;
@@ -2312,26 +3834,23 @@ char* adn_regex_replace(const char* pattern, const char* text, const char* repla
 
 	if (!raw_replacement)
 	{
-		return strdup("");
+		return adn_string_adopt(strdup(""));
 	}
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
 		free(raw_replacement);
-		return adn_regex_unwrap_string(text);
+		return adn_string_adopt(adn_regex_unwrap_string(text));
 	}
-	if (!adn_regex_find_match(&program, &view, 0, &match))
+	if (!adn_regex_find_match(program, &view, 0, &match))
 	{
 		adn_regex_text_free(&view);
-		adn_regex_program_free(&program);
-		free(raw_pattern);
 		free(raw_replacement);
-		return raw_text;
+		return adn_string_adopt(raw_text);
 	}
 
 	adn_regex_builder_init(&builder);
 	adn_regex_builder_append_slice(&builder, raw_text, &view, 0, match.start);
-	capture_count = (size_t)program.capture_count + 1;
+	capture_count = (size_t)program->capture_count + 1;
 	expanded = adn_regex_expand_replacement(raw_replacement, raw_text, &view, &match,
 	                                     capture_count);
 	adn_regex_builder_append(&builder, expanded ? expanded : "");
@@ -2341,60 +3860,42 @@ char* adn_regex_replace(const char* pattern, const char* text, const char* repla
 	free(raw_replacement);
 	adn_regex_match_free(&match);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
 	free(raw_text);
 	result = adn_regex_builder_finish(&builder);
-	return result;
+	return adn_string_adopt(result);
 }
 
-char* adn_regex_replace_all(const char* pattern, const char* text,
-	                        const char* replacement)
+static char* adn_regex_program_replace_all(const AdnRegexProgram* program,
+	                                      const char* raw_text, const AdnRegexText* view,
+	                                      const char* raw_replacement)
 {
-	AdnRegexProgram program = {0};
-	AdnRegexText view = {0};
 	AdnRegexStringBuilder builder = {0};
-	char* raw_pattern = NULL;
-	char* raw_text = NULL;
-	char* raw_replacement = adn_regex_unwrap_string(replacement);
 	size_t search_start = 0;
 	size_t emit_start = 0;
-	size_t capture_count;
-
-	if (!raw_replacement)
-	{
-		return strdup("");
-	}
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
-	{
-		free(raw_replacement);
-		return adn_regex_unwrap_string(text);
-	}
+	size_t capture_count = (size_t)program->capture_count + 1;
 
-	capture_count = (size_t)program.capture_count + 1;
 	adn_regex_builder_init(&builder);
 
-	while (search_start <= view.length)
+	while (search_start <= view->length)
 	{
 		AdnRegexMatch match = {0};
 		char* expanded;
-		if (!adn_regex_find_match(&program, &view, search_start, &match))
+		if (!adn_regex_find_match(program, view, search_start, &match))
 		{
 			break;
 		}
-		adn_regex_builder_append_slice(&builder, raw_text, &view, emit_start,
+		adn_regex_builder_append_slice(&builder, raw_text, view, emit_start,
 		                             match.start);
-		expanded = adn_regex_expand_replacement(raw_replacement, raw_text, &view,
+		expanded = adn_regex_expand_replacement(raw_replacement, raw_text, view,
 		                                     &match, capture_count);
 		adn_regex_builder_append(&builder, expanded ? expanded : "");
 		free(expanded);
 
 		if (match.end == match.start)
 		{
-			if (match.start < view.length)
+			if (match.start < view->length)
 			{
-				adn_regex_builder_append_slice(&builder, raw_text, &view, match.start,
+				adn_regex_builder_append_slice(&builder, raw_text, view, match.start,
 				                             match.start + 1);
 				emit_start = match.start + 1;
 				search_start = match.start + 1;
@@ -2402,7 +3903,7 @@ char* adn_regex_replace_all(const char* pattern, const char* text,
 			else
 			{
 				emit_start = match.end;
-				search_start = view.length + 1;
+				search_start = view->length + 1;
 			}
 		}
 		else
@@ -2413,65 +3914,75 @@ char* adn_regex_replace_all(const char* pattern, const char* text,
 		adn_regex_match_free(&match);
 	}
 
-	if (emit_start <= view.length)
+	if (emit_start <= view->length)
 	{
-		adn_regex_builder_append_slice(&builder, raw_text, &view, emit_start,
-		                             view.length);
+		adn_regex_builder_append_slice(&builder, raw_text, view, emit_start,
+		                             view->length);
 	}
 
-	free(raw_replacement);
-	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
-	free(raw_pattern);
-	free(raw_text);
 	return adn_regex_builder_finish(&builder);
 }
 
-void* adn_regex_split(const char* pattern, const char* text)
+char* adn_regex_replace_all(const char* pattern, const char* text,
+	                        const char* replacement)
 {
-	AdnRegexProgram program = {0};
+	const AdnRegexProgram* program = NULL;
 	AdnRegexText view = {0};
-	char* raw_pattern = NULL;
 	char* raw_text = NULL;
-	void* result = adn_array_create();
-	size_t search_start = 0;
-	size_t emit_start = 0;
+	char* raw_replacement = adn_regex_unwrap_string(replacement);
+	char* result;
 
-	if (!result)
+	if (!raw_replacement)
 	{
-		return NULL;
+		return adn_string_adopt(strdup(""));
 	}
-	if (!adn_regex_compile_sources(pattern, text, &raw_pattern, &raw_text, &program,
-	                             &view))
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
 	{
-		char* copy = adn_regex_unwrap_string(text);
-		adn_array_push_string(result, copy ? copy : "");
-		free(copy);
-		return result;
+		free(raw_replacement);
+		return adn_string_adopt(adn_regex_unwrap_string(text));
+	}
+
+	result = adn_regex_program_replace_all(program, raw_text, &view, raw_replacement);
+	free(raw_replacement);
+	adn_regex_text_free(&view);
+	free(raw_text);
+	return adn_string_adopt(result);
+}
+
+static void adn_regex_push_slice(void* array, const char* raw_text, const AdnRegexText* view,
+	                             size_t start, size_t end)
+{
+	size_t offset = adn_regex_text_offset(view, start);
+	size_t length = adn_regex_text_offset(view, end) - offset;
+	char* piece = (char*)malloc(length + 1);
+	if (piece)
+	{
+		memcpy(piece, raw_text + offset, length);
+		piece[length] = '\0';
+		adn_array_push_string(array, piece);
+		free(piece);
 	}
+}
+
+static void adn_regex_program_split(const AdnRegexProgram* program, const char* raw_text,
+	                                const AdnRegexText* view, void* result)
+{
+	size_t search_start = 0;
+	size_t emit_start = 0;
 
-	while (search_start <= view.length)
+	while (search_start <= view->length)
 	{
 		AdnRegexMatch match = {0};
-		char* piece;
-		if (!adn_regex_find_match(&program, &view, search_start, &match))
+		if (!adn_regex_find_match(program, view, search_start, &match))
 		{
 			break;
 		}
-		piece = (char*)malloc(view.offsets[match.start] - view.offsets[emit_start] + 1);
-		if (piece)
-		{
-			size_t length = view.offsets[match.start] - view.offsets[emit_start];
-			memcpy(piece, raw_text + view.offsets[emit_start], length);
-			piece[length] = '\0';
-			adn_array_push_string(result, piece);
-			free(piece);
-		}
+		adn_regex_push_slice(result, raw_text, view, emit_start, match.start);
 
 		if (match.end == match.start)
 		{
 			emit_start = match.start;
-			search_start = match.start < view.length ? match.start + 1 : view.length + 1;
+			search_start = match.start < view->length ? match.start + 1 : view->length + 1;
 		}
 		else
 		{
@@ -2481,21 +3992,332 @@ void* adn_regex_split(const char* pattern, const char* text)
 		adn_regex_match_free(&match);
 	}
 
+	adn_regex_push_slice(result, raw_text, view, emit_start, view->length);
+}
+
+void* adn_regex_split(const char* pattern, const char* text)
+{
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	char* raw_text = NULL;
+	void* result = adn_array_create();
+
+	if (!result)
 	{
-		char* tail = (char*)malloc(view.offsets[view.length] - view.offsets[emit_start] + 1);
-		if (tail)
-		{
-			size_t length = view.offsets[view.length] - view.offsets[emit_start];
-			memcpy(tail, raw_text + view.offsets[emit_start], length);
-			tail[length] = '\0';
-			adn_array_push_string(result, tail);
-			free(tail);
-		}
+		return NULL;
+	}
+	if (!adn_regex_compile_sources(pattern, text, &raw_text, &program, &view))
+	{
+		char* copy = adn_regex_unwrap_string(text);
+		adn_array_push_string(result, copy ? copy : "");
+		free(copy);
+		return result;
 	}
 
+	adn_regex_program_split(program, raw_text, &view, result);
 	adn_regex_text_free(&view);
-	adn_regex_program_free(&program);
+	free(raw_text);
+	return result;
+}
+
+// Handles from adn_regex_new are runtime values that own their program outside the
+// pattern cache, so they survive any number of other patterns. A handle for a pattern
+// that does not parse behaves like that pattern in the string API. adn_regex_free marks
+// the handle freed, so later calls on it fail cleanly; the program goes with the last
+// reference, and iterators hold one, so they keep working after adn_regex_free.
+typedef struct
+{
+	int valid;
+	int freed;
+	AdnRegexProgram program;
+} AdnRegexHandle;
+
+// Iterators retain the handle and yield one match per adn_regex_iter_next, advancing
+// past empty matches the same way replace_all and split do. adn_regex_iter_close lets go
+// of the text and the handle early; a closed iterator is exhausted.
+typedef struct
+{
+	AdnRegexHandle* handle;
+	const AdnRegexProgram* program;
+	char* text;
+	AdnRegexText view;
+	size_t search_start;
+	int has_match;
+	AdnRegexMatch match;
+} AdnRegexIter;
+
+static void adn_regex_handle_destroy(void* regex)
+{
+	AdnRegexHandle* handle = (AdnRegexHandle*)regex;
+	if (handle->valid)
+	{
+		adn_regex_program_free(&handle->program);
+	}
+}
+
+void* adn_regex_new(const char* pattern)
+{
+	char* raw_pattern = adn_regex_unwrap_string(pattern);
+	AdnRegexHandle* handle;
+	if (!raw_pattern)
+	{
+		return NULL;
+	}
+	handle = (AdnRegexHandle*)adn_native_create((int64_t)sizeof(AdnRegexHandle),
+	                                           adn_regex_handle_destroy);
+	if (!handle)
+	{
+		free(raw_pattern);
+		return NULL;
+	}
+	handle->valid = adn_regex_program_init(&handle->program, raw_pattern);
 	free(raw_pattern);
+	return handle;
+}
+
+void adn_regex_free(void* regex)
+{
+	AdnRegexHandle* handle = (AdnRegexHandle*)regex;
+	if (handle)
+	{
+		handle->freed = 1;
+	}
+}
+
+static const AdnRegexProgram* adn_regex_handle_program(void* regex, const char* action)
+{
+	AdnRegexHandle* handle = (AdnRegexHandle*)regex;
+	if (handle && handle->freed)
+	{
+		fprintf(stderr, "%s() on a freed regex. (Error)\n", action);
+		exit(1);
+	}
+	return handle && handle->valid ? &handle->program : NULL;
+}
+
+static int adn_regex_handle_sources(void* regex, const char* action, const char* text,
+	                               char** out_text, const AdnRegexProgram** out_program,
+	                               AdnRegexText* out_view)
+{
+	char* raw_text;
+	*out_program = adn_regex_handle_program(regex, action);
+	if (!*out_program)
+	{
+		return 0;
+	}
+	raw_text = adn_regex_unwrap_string(text);
+	if (!raw_text)
+	{
+		return 0;
+	}
+	if (!adn_regex_text_init(out_view, raw_text))
+	{
+		free(raw_text);
+		return 0;
+	}
+	*out_text = raw_text;
+	return 1;
+}
+
+int64_t adn_regex_handle_matches(void* regex, const char* text)
+{
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	char* raw_text = NULL;
+	int matched;
+	if (!adn_regex_handle_sources(regex, "compiled_matches", text, &raw_text, &program, &view))
+	{
+		return 0;
+	}
+	matched = adn_regex_match_full(program, &view);
+	adn_regex_text_free(&view);
+	free(raw_text);
+	return matched ? 1 : 0;
+}
+
+int64_t adn_regex_handle_find(void* regex, const char* text)
+{
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	AdnRegexMatch match = {0};
+	char* raw_text = NULL;
+	int64_t result = -1;
+	if (!adn_regex_handle_sources(regex, "compiled_find", text, &raw_text, &program, &view))
+	{
+		return -1;
+	}
+	if (adn_regex_find_match(program, &view, 0, &match))
+	{
+		result = (int64_t)adn_regex_text_offset(&view, match.start);
+	}
+	adn_regex_match_free(&match);
+	adn_regex_text_free(&view);
+	free(raw_text);
+	return result;
+}
+
+char* adn_regex_handle_replace_all(void* regex, const char* text, const char* replacement)
+{
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	char* raw_text = NULL;
+	char* raw_replacement = adn_regex_unwrap_string(replacement);
+	char* result;
+
+	if (!raw_replacement)
+	{
+		return adn_string_adopt(strdup(""));
+	}
+	if (!adn_regex_handle_sources(regex, "compiled_replace_all", text, &raw_text, &program, &view))
+	{
+		free(raw_replacement);
+		return adn_string_adopt(adn_regex_unwrap_string(text));
+	}
+
+	result = adn_regex_program_replace_all(program, raw_text, &view, raw_replacement);
+	free(raw_replacement);
+	adn_regex_text_free(&view);
+	free(raw_text);
+	return adn_string_adopt(result);
+}
+
+void* adn_regex_handle_split(void* regex, const char* text)
+{
+	const AdnRegexProgram* program = NULL;
+	AdnRegexText view = {0};
+	char* raw_text = NULL;
+	void* result = adn_array_create();
+
+	if (!result)
+	{
+		return NULL;
+	}
+	if (!adn_regex_handle_sources(regex, "compiled_split", text, &raw_text, &program, &view))
+	{
+		char* copy = adn_regex_unwrap_string(text);
+		adn_array_push_string(result, copy ? copy : "");
+		free(copy);
+		return result;
+	}
+
+	adn_regex_program_split(program, raw_text, &view, result);
+	adn_regex_text_free(&view);
 	free(raw_text);
 	return result;
-}
\ No newline at end of file
+}
+
+static void adn_regex_iter_shut(AdnRegexIter* iter)
+{
+	adn_regex_match_free(&iter->match);
+	iter->has_match = 0;
+	if (iter->text)
+	{
+		adn_regex_text_free(&iter->view);
+		free(iter->text);
+		iter->text = NULL;
+	}
+	iter->program = NULL;
+	adn_release(iter->handle);
+	iter->handle = NULL;
+}
+
+static void adn_regex_iter_destroy(void* iterator)
+{
+	adn_regex_iter_shut((AdnRegexIter*)iterator);
+}
+
+void* adn_regex_iter(void* regex, const char* text)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)adn_native_create((int64_t)sizeof(AdnRegexIter),
+	                                                     adn_regex_iter_destroy);
+	if (!iter)
+	{
+		return NULL;
+	}
+	if (!adn_regex_handle_sources(regex, "find_iter", text, &iter->text, &iter->program,
+	                              &iter->view))
+	{
+		// Nothing to match against; the iterator is simply exhausted.
+		iter->program = NULL;
+		return iter;
+	}
+	iter->handle = (AdnRegexHandle*)adn_retain(regex);
+	return iter;
+}
+
+int64_t adn_regex_iter_next(void* iterator)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)iterator;
+	if (!iter || !iter->program)
+	{
+		return 0;
+	}
+	adn_regex_match_free(&iter->match);
+	iter->has_match = 0;
+	if (iter->search_start > iter->view.length ||
+	    !adn_regex_find_match(iter->program, &iter->view, iter->search_start, &iter->match))
+	{
+		iter->search_start = iter->view.length + 1;
+		return 0;
+	}
+	iter->has_match = 1;
+	if (iter->match.end == iter->match.start)
+	{
+		iter->search_start = iter->match.start + 1;
+	}
+	else
+	{
+		iter->search_start = iter->match.end;
+	}
+	return 1;
+}
+
+static const AdnRegexCapture* adn_regex_iter_capture(const AdnRegexIter* iter, int64_t group)
+{
+	const AdnRegexCapture* capture;
+	if (!iter || !iter->has_match || !iter->match.captures || group < 0 ||
+	    group > iter->program->capture_count)
+	{
+		return NULL;
+	}
+	capture = &iter->match.captures[group];
+	return capture->defined ? capture : NULL;
+}
+
+int64_t adn_regex_iter_start(void* iterator, int64_t group)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)iterator;
+	const AdnRegexCapture* capture = adn_regex_iter_capture(iter, group);
+	return capture ? (int64_t)adn_regex_text_offset(&iter->view, capture->start) : -1;
+}
+
+int64_t adn_regex_iter_end(void* iterator, int64_t group)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)iterator;
+	const AdnRegexCapture* capture = adn_regex_iter_capture(iter, group);
+	return capture ? (int64_t)adn_regex_text_offset(&iter->view, capture->end) : -1;
+}
+
+char* adn_regex_iter_group(void* iterator, int64_t group)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)iterator;
+	const AdnRegexCapture* capture = adn_regex_iter_capture(iter, group);
+	AdnRegexStringBuilder builder = {0};
+	if (!capture)
+	{
+		return adn_string_adopt(strdup(""));
+	}
+	adn_regex_builder_init(&builder);
+	adn_regex_builder_append_slice(&builder, iter->text, &iter->view, capture->start,
+	                             capture->end);
+	return adn_string_adopt(adn_regex_builder_finish(&builder));
+}
+
+void adn_regex_iter_close(void* iterator)
+{
+	AdnRegexIter* iter = (AdnRegexIter*)iterator;
+	if (iter)
+	{
+		adn_regex_iter_shut(iter);
+	}
+}
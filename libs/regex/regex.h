@@ -7,8 +7,6 @@ int64_t adn_regex_valid(const char* pattern);
 
 char* adn_regex_escape(const char* text);
 
-char* adn_regex_compile(const char* pattern);
-
 int64_t adn_regex_matches(const char* pattern, const char* text);
 
 int64_t adn_regex_find(const char* pattern, const char* text);
@@ -26,8 +24,49 @@ char* adn_regex_replace_all(const char* pattern, const char* text,
 
 void* adn_regex_split(const char* pattern, const char* text);
 
+// Lookups in this thread's cache of compiled patterns.
+int64_t adn_regex_cache_hits(void);
+
+int64_t adn_regex_cache_misses(void);
+
+// Compiled handles are runtime values that own their program. adn_regex_free marks one
+// freed; the program is released with the last reference.
+void* adn_regex_new(const char* pattern);
+
+void adn_regex_free(void* regex);
+
+int64_t adn_regex_handle_matches(void* regex, const char* text);
+
+int64_t adn_regex_handle_find(void* regex, const char* text);
+
+char* adn_regex_handle_replace_all(void* regex, const char* text, const char* replacement);
+
+void* adn_regex_handle_split(void* regex, const char* text);
+
+// Lazy iteration over the matches of a handle; the iterator keeps the handle alive until
+// adn_regex_iter_close or its last reference, even if adn_regex_free is called first.
+void* adn_regex_iter(void* regex, const char* text);
+
+int64_t adn_regex_iter_next(void* iterator);
+
+int64_t adn_regex_iter_start(void* iterator, int64_t group);
+
+int64_t adn_regex_iter_end(void* iterator, int64_t group);
+
+char* adn_regex_iter_group(void* iterator, int64_t group);
+
+void adn_regex_iter_close(void* iterator);
+
 void* adn_array_create(void);
 
 void adn_array_push_string(void* array, const char* value);
 
+char* adn_string_adopt(char* text);
+
+void* adn_native_create(int64_t size, void (*destroy)(void*));
+
+void* adn_retain(void* value);
+
+void adn_release(void* value);
+
 #endif
\ No newline at end of file
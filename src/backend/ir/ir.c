@@ -49,6 +49,8 @@ void ir_module_destroy(IRModule* mod)
 					i->call_args = NULL;
 					i->call_nargs = 0;
 				}
+				free(i->phi_blocks);
+				i->phi_blocks = NULL;
 				i = i->next;
 			}
 			b = b->next;
@@ -335,7 +337,7 @@ IRValue* ir_emit_binop(IRBlock* block, const char* op, IRValue* lhs, IRValue* rh
 		fprintf(stderr, "Invalid arguments to ir_emit_binop. (Error)\n");
 		return NULL;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	if (!ins)
 	{
 		return NULL;
@@ -443,7 +445,7 @@ void ir_emit_ret(IRBlock* block, IRValue* value)
 		fprintf(stderr, "Attempted to emit return into a NULL block. (Warning)\n");
 		return;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	if (!ins)
 	{
 		return;
@@ -920,7 +922,7 @@ IRValue* ir_emit_alloca(IRBlock* b, IRType* type)
 		fprintf(stderr, "Invalid arguments to ir_emit_alloca. (Error)\n");
 		return NULL;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	fprintf(stderr, "ir_emit_alloca: malloc IRInstruction -> %p\n", (void*)ins);
 	if (!ins)
 	{
@@ -950,7 +952,7 @@ IRValue* ir_emit_load(IRBlock* b, IRValue* ptr)
 		fprintf(stderr, "Invalid arguments to ir_emit_load. (Error)\n");
 		return NULL;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	fprintf(stderr, "ir_emit_load: malloc IRInstruction -> %p\n", (void*)ins);
 	if (!ins)
 	{
@@ -984,7 +986,7 @@ void ir_emit_store(IRBlock* b, IRValue* ptr, IRValue* val)
 		fprintf(stderr, "Invalid arguments to ir_emit_store. (Error)\n");
 		return;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	fprintf(stderr, "ir_emit_store: malloc IRInstruction -> %p\n", (void*)ins);
 	if (!ins)
 	{
@@ -1016,7 +1018,7 @@ IRValue* ir_emit_call(IRBlock* b, IRFunction* callee, IRValue** args, size_t nar
 		fprintf(stderr, "Invalid arguments to ir_emit_call. (Error)\n");
 		return NULL;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	fprintf(stderr, "ir_emit_call: malloc IRInstruction -> %p\n", (void*)ins);
 	if (!ins)
 	{
@@ -1072,7 +1074,7 @@ void ir_emit_br(IRBlock* b, IRBlock* target)
 		fprintf(stderr, "Invalid arguments to ir_emit_br. (Error)\n");
 		return;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	if (!ins)
 	{
 		return;
@@ -1111,7 +1113,7 @@ void ir_emit_cbr(IRBlock* b, IRValue* cond, IRBlock* true_b, IRBlock* false_b)
 		fprintf(stderr, "Invalid arguments to ir_emit_cbr. (Error)\n");
 		return;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	if (!ins)
 	{
 		return;
@@ -1143,6 +1145,54 @@ void ir_emit_cbr(IRBlock* b, IRValue* cond, IRBlock* true_b, IRBlock* false_b)
 	}
 }
 
+IRInstruction* ir_insert_phi(IRBlock* b, IRType* t)
+{
+	if (!b || !t)
+	{
+		fprintf(stderr, "Invalid arguments to ir_insert_phi. (Error)\n");
+		return NULL;
+	}
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
+	if (!ins)
+	{
+		return NULL;
+	}
+	ins->kind = IR_PHI;
+	ins->dest = ir_temp(b, t);
+	ins->next = b->first;
+	b->first = ins;
+	if (!b->last)
+	{
+		b->last = ins;
+	}
+	return ins;
+}
+
+int ir_phi_add_incoming(IRInstruction* phi, IRValue* value, IRBlock* pred)
+{
+	if (!phi || phi->kind != IR_PHI || !value || !pred)
+	{
+		fprintf(stderr, "Invalid arguments to ir_phi_add_incoming. (Error)\n");
+		return -1;
+	}
+	IRValue** values = realloc(phi->call_args, (phi->call_nargs + 1) * sizeof(*values));
+	if (!values)
+	{
+		return -1;
+	}
+	phi->call_args = values;
+	IRBlock** blocks = realloc(phi->phi_blocks, (phi->call_nargs + 1) * sizeof(*blocks));
+	if (!blocks)
+	{
+		return -1;
+	}
+	phi->phi_blocks = blocks;
+	phi->call_args[phi->call_nargs] = value;
+	phi->phi_blocks[phi->call_nargs] = pred;
+	phi->call_nargs++;
+	return 0;
+}
+
 IRValue* ir_emit_phi(IRBlock* b, IRType* t, IRValue** values, IRBlock** blocks, size_t n)
 {
 	if (!b || !t || (n && (!values || !blocks)))
@@ -1150,7 +1200,7 @@ IRValue* ir_emit_phi(IRBlock* b, IRType* t, IRValue** values, IRBlock** blocks,
 		fprintf(stderr, "Invalid arguments to ir_emit_phi. (Error)\n");
 		return NULL;
 	}
-	IRInstruction* ins = malloc(sizeof(IRInstruction));
+	IRInstruction* ins = calloc(1, sizeof(IRInstruction));
 	if (!ins)
 	{
 		return NULL;
@@ -1158,21 +1208,17 @@ IRValue* ir_emit_phi(IRBlock* b, IRType* t, IRValue** values, IRBlock** blocks,
 	ins->kind = IR_PHI;
 	IRValue* dst = ir_temp(b, t);
 	ins->dest = dst;
-	ins->operands[0] = (n > 0) ? values[0] : NULL;
-	ins->operands[1] = (n > 1) ? values[1] : NULL;
-	ins->operands[2] = NULL;
-	ins->call_args = NULL;
-	ins->call_nargs = 0;
-	ins->next = NULL;
-	if (b->last)
+	for (size_t i = 0; i < n; ++i)
 	{
-		b->last->next = ins;
-		b->last = ins;
-	}
-	else
-	{
-		b->first = b->last = ins;
+		if (ir_phi_add_incoming(ins, values[i], blocks[i]) != 0)
+		{
+			free(ins->call_args);
+			free(ins->phi_blocks);
+			free(ins);
+			return NULL;
+		}
 	}
+	ir_instr_append(b, ins);
 	return dst;
 }
 
@@ -1279,6 +1325,7 @@ void ir_remove_instruction(IRBlock* b, IRInstruction* i)
 			{
 				free(cur->call_args);
 			}
+			free(cur->phi_blocks);
 			free(cur);
 			return;
 		}
@@ -1371,7 +1418,7 @@ IRValue* ir_emit_fpcvt(IRBlock* b, IRValue* val, IRType* target_type)
 	if (!b || !val || !target_type)
 		return NULL;
 	IRValue* dst = ir_temp(b, target_type);
-	IRInstruction* ins = (IRInstruction*)malloc(sizeof(IRInstruction));
+	IRInstruction* ins = (IRInstruction*)calloc(1, sizeof(IRInstruction));
 	if (!ins)
 		return NULL;
 	ins->kind = IR_FPCVT;
@@ -1391,7 +1438,7 @@ IRValue* ir_emit_itofp(IRBlock* b, IRValue* val, IRType* target_type)
 	if (!b || !val || !target_type)
 		return NULL;
 	IRValue* dst = ir_temp(b, target_type);
-	IRInstruction* ins = (IRInstruction*)malloc(sizeof(IRInstruction));
+	IRInstruction* ins = (IRInstruction*)calloc(1, sizeof(IRInstruction));
 	if (!ins)
 		return NULL;
 	ins->kind = IR_ITOFP;
@@ -1405,3 +1452,64 @@ IRValue* ir_emit_itofp(IRBlock* b, IRValue* val, IRType* target_type)
 	ir_instr_append(b, ins);
 	return dst;
 }
+
+IRValue* ir_emit_icast(IRBlock* b, IRValue* val, IRType* target_type)
+{
+	if (!b || !val || !target_type)
+		return NULL;
+	IRValue* dst = ir_temp(b, target_type);
+	IRInstruction* ins = (IRInstruction*)calloc(1, sizeof(IRInstruction));
+	if (!ins)
+		return NULL;
+	ins->kind = IR_ICAST;
+	ins->dest = dst;
+	ins->operands[0] = val;
+	ins->operands[1] = NULL;
+	ins->operands[2] = NULL;
+	ins->next = NULL;
+	ins->call_args = NULL;
+	ins->call_nargs = 0;
+	ir_instr_append(b, ins);
+	return dst;
+}
+
+IRValue* ir_emit_gep(IRBlock* b, IRValue* base, int64_t byte_offset, IRType* result_type)
+{
+	if (!b || !base || !result_type || result_type->kind != IR_T_PTR)
+		return NULL;
+	IRValue* dst = ir_temp(b, result_type);
+	IRInstruction* ins = (IRInstruction*)calloc(1, sizeof(IRInstruction));
+	if (!ins)
+		return NULL;
+	ins->kind = IR_GEP;
+	ins->dest = dst;
+	ins->operands[0] = base;
+	ins->operands[1] = ir_const_i64(byte_offset);
+	ins->operands[2] = NULL;
+	ins->next = NULL;
+	ins->call_args = NULL;
+	ins->call_nargs = 0;
+	ir_instr_append(b, ins);
+	return dst;
+}
+
+IRValue* ir_emit_gep_index(IRBlock* b, IRValue* base, IRValue* index, IRType* result_type)
+{
+	if (!b || !base || !index || !result_type || result_type->kind != IR_T_PTR ||
+	    !result_type->pointee)
+		return NULL;
+	IRValue* dst = ir_temp(b, result_type);
+	IRInstruction* ins = (IRInstruction*)calloc(1, sizeof(IRInstruction));
+	if (!ins)
+		return NULL;
+	ins->kind = IR_GEP;
+	ins->dest = dst;
+	ins->operands[0] = base;
+	ins->operands[1] = ir_const_i64(0);
+	ins->operands[2] = index;
+	ins->next = NULL;
+	ins->call_args = NULL;
+	ins->call_nargs = 0;
+	ir_instr_append(b, ins);
+	return dst;
+}
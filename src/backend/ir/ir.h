@@ -19,6 +19,8 @@ typedef enum
 	IR_CBR,
 	IR_FPCVT,
 	IR_ITOFP,
+	IR_ICAST,
+	IR_GEP,
 	IR_NOP
 } IrInstrKind;
 
@@ -78,6 +80,8 @@ typedef struct IRInstruction
 	IRValue* operands[3];
 	IRValue** call_args;
 	size_t call_nargs;
+	// PHI: incoming values are in call_args, the matching predecessor blocks here.
+	struct IRBlock** phi_blocks;
 	int opcode;
 	struct IRInstruction* next;
 } IRInstruction;
@@ -187,10 +191,25 @@ void ir_emit_cbr(IRBlock* b, IRValue* cond, IRBlock* true_b, IRBlock* false_b);
 
 IRValue* ir_emit_phi(IRBlock* b, IRType* t, IRValue** values, IRBlock** blocks, size_t n);
 
+// Creates an empty phi at the top of `b`; fill it with ir_phi_add_incoming.
+IRInstruction* ir_insert_phi(IRBlock* b, IRType* t);
+
+int ir_phi_add_incoming(IRInstruction* phi, IRValue* value, IRBlock* pred);
+
 IRValue* ir_emit_fpcvt(IRBlock* b, IRValue* val, IRType* target_type);
 
 IRValue* ir_emit_itofp(IRBlock* b, IRValue* val, IRType* target_type);
 
+// Widens or narrows an integer to `target_type`; unsigned and bool sources zero-extend.
+IRValue* ir_emit_icast(IRBlock* b, IRValue* val, IRType* target_type);
+
+// Address `byte_offset` bytes past `base`, typed as `result_type` (a pointer type).
+IRValue* ir_emit_gep(IRBlock* b, IRValue* base, int64_t byte_offset, IRType* result_type);
+
+// Address of element `index` of the array at `base`, whose element type is the pointee
+// of `result_type`.
+IRValue* ir_emit_gep_index(IRBlock* b, IRValue* base, IRValue* index, IRType* result_type);
+
 int ir_validate_module(IRModule* m);
 
 void ir_replace_value(IRModule* m, IRValue* oldv, IRValue* newv);
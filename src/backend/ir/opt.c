@@ -1,5 +1,1635 @@
 #include "opt.h"
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+#define IR_OPT_MAX_ROUNDS 8
+
+static int opt_pass_enabled[IR_OPT_PASS_COUNT] = {1, 1, 1, 1, 1};
+
+static const char* const opt_pass_names[IR_OPT_PASS_COUNT] = {
+    "const-fold",
+    "simplify",
+    "unreachable",
+    "mem2reg",
+    "dce",
+};
+
+void ir_opt_set_pass_enabled(IrOptPass pass, int enabled)
+{
+	if ((int)pass < 0 || pass >= IR_OPT_PASS_COUNT)
+	{
+		fprintf(stderr, "ir_opt_set_pass_enabled called with unknown pass %d. (Warning)\n",
+		        (int)pass);
+		return;
+	}
+	opt_pass_enabled[pass] = enabled ? 1 : 0;
+}
+
+int ir_opt_pass_enabled(IrOptPass pass)
+{
+	if ((int)pass < 0 || pass >= IR_OPT_PASS_COUNT)
+	{
+		return 0;
+	}
+	return opt_pass_enabled[pass];
+}
+
+const char* ir_opt_pass_name(IrOptPass pass)
+{
+	if ((int)pass < 0 || pass >= IR_OPT_PASS_COUNT)
+	{
+		return NULL;
+	}
+	return opt_pass_names[pass];
+}
+
+int ir_opt_pass_from_name(const char* name)
+{
+	if (!name)
+	{
+		return -1;
+	}
+	for (int i = 0; i < IR_OPT_PASS_COUNT; ++i)
+	{
+		if (strcmp(opt_pass_names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Open-addressing map keyed by IRValue*/IRBlock* identity. Passes use it both for
+// value replacements and for use counts (stored as uintptr_t).
+typedef struct
+{
+	const void** keys;
+	void** values;
+	size_t capacity;
+	size_t count;
+} OptPtrMap;
+
+static size_t opt_hash_ptr(const void* p)
+{
+	uint64_t x = (uint64_t)(uintptr_t)p;
+	x ^= x >> 33;
+	x *= UINT64_C(0xff51afd7ed558ccd);
+	x ^= x >> 33;
+	return (size_t)x;
+}
+
+static void opt_map_free(OptPtrMap* m)
+{
+	free(m->keys);
+	free(m->values);
+	m->keys = NULL;
+	m->values = NULL;
+	m->capacity = 0;
+	m->count = 0;
+}
+
+static size_t opt_map_index(const OptPtrMap* m, const void* key)
+{
+	size_t mask = m->capacity - 1;
+	size_t i = opt_hash_ptr(key) & mask;
+	while (m->keys[i] && m->keys[i] != key)
+	{
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+static int opt_map_grow(OptPtrMap* m)
+{
+	size_t capacity = m->capacity ? m->capacity * 2 : 64;
+	OptPtrMap grown = {0};
+	grown.keys = calloc(capacity, sizeof(*grown.keys));
+	grown.values = calloc(capacity, sizeof(*grown.values));
+	if (!grown.keys || !grown.values)
+	{
+		opt_map_free(&grown);
+		fprintf(stderr, "Failed to allocate optimizer value map. (Error)\n");
+		return -1;
+	}
+	grown.capacity = capacity;
+	for (size_t i = 0; i < m->capacity; ++i)
+	{
+		if (m->keys[i])
+		{
+			size_t j = opt_map_index(&grown, m->keys[i]);
+			grown.keys[j] = m->keys[i];
+			grown.values[j] = m->values[i];
+			grown.count++;
+		}
+	}
+	opt_map_free(m);
+	*m = grown;
+	return 0;
+}
+
+static void* opt_map_get(const OptPtrMap* m, const void* key)
+{
+	if (!key || !m->capacity)
+	{
+		return NULL;
+	}
+	size_t i = opt_map_index(m, key);
+	return m->keys[i] ? m->values[i] : NULL;
+}
+
+static int opt_map_put(OptPtrMap* m, const void* key, void* value)
+{
+	if (!key)
+	{
+		return -1;
+	}
+	if ((m->count + 1) * 4 > m->capacity * 3 && opt_map_grow(m) != 0)
+	{
+		return -1;
+	}
+	size_t i = opt_map_index(m, key);
+	if (!m->keys[i])
+	{
+		m->keys[i] = key;
+		m->count++;
+	}
+	m->values[i] = value;
+	return 0;
+}
+
+static uintptr_t opt_count_get(const OptPtrMap* m, const void* key)
+{
+	return (uintptr_t)opt_map_get(m, key);
+}
+
+static void opt_count_add(OptPtrMap* m, const void* key, intptr_t delta)
+{
+	if (!key)
+	{
+		return;
+	}
+	uintptr_t n = opt_count_get(m, key) + (uintptr_t)delta;
+	opt_map_put(m, key, (void*)n);
+}
+
+static int opt_int_width(const IRType* t)
+{
+	if (!t)
+	{
+		return 0;
+	}
+	switch (t->kind)
+	{
+		case IR_T_I1:
+		case IR_T_BOOL:
+			return 1;
+		case IR_T_I8:
+		case IR_T_U8:
+			return 8;
+		case IR_T_I16:
+		case IR_T_U16:
+			return 16;
+		case IR_T_I32:
+		case IR_T_U32:
+			return 32;
+		case IR_T_I64:
+		case IR_T_U64:
+		case IR_T_INTPTR:
+		case IR_T_UINTPTR:
+			return 64;
+		default:
+			return 0;
+	}
+}
+
+static int opt_is_float(const IRType* t)
+{
+	return t && (t->kind == IR_T_F32 || t->kind == IR_T_F64);
+}
+
+static int opt_same_kind(const IRValue* v, const IRType* t)
+{
+	return v && v->type && t && v->type->kind == t->kind;
+}
+
+// Truncates to `width` bits and sign-extends, matching what the emitted LLVM
+// integer op would produce (the emitter always uses the signed forms). The one
+// exception is i1, which stays 0/1 so that booleans keep their usual values;
+// signed LLVM compares read an i1 1 as -1, so opt_fold_binop leaves those alone.
+static int64_t opt_wrap_int(uint64_t v, int width)
+{
+	if (width >= 64)
+	{
+		return (int64_t)v;
+	}
+	if (width <= 1)
+	{
+		return (int64_t)(v & 1);
+	}
+	uint64_t mask = (UINT64_C(1) << width) - 1;
+	uint64_t sign = UINT64_C(1) << (width - 1);
+	return (int64_t)(((v & mask) ^ sign) - sign);
+}
+
+static IRValue* opt_const_int(int64_t value, IRType* type)
+{
+	IRValue* v = ir_const_i64(opt_wrap_int((uint64_t)value, opt_int_width(type)));
+	if (v && type)
+	{
+		v->type = type;
+	}
+	return v;
+}
+
+static IRValue* opt_const_float(double value, IRType* type)
+{
+	IRValue* v = ir_const_f64(value);
+	if (v && type)
+	{
+		v->type = type;
+		if (type->kind == IR_T_F32)
+		{
+			v->u.f64 = (double)(float)value;
+		}
+	}
+	return v;
+}
+
+static int opt_is_int_const(const IRValue* v, int64_t value)
+{
+	return v && v->kind == IRV_CONST && !opt_is_float(v->type) &&
+	       opt_wrap_int((uint64_t)v->u.i64, opt_int_width(v->type)) == value;
+}
+
+static int opt_is_float_const(const IRValue* v, double value)
+{
+	return v && v->kind == IRV_CONST && opt_is_float(v->type) && v->u.f64 == value &&
+	       !signbit(v->u.f64);
+}
+
+// Mirrors adn_powi in the runtime, with wrapping multiplication.
+static int64_t opt_powi(int64_t base, int64_t exp)
+{
+	if (exp < 0)
+	{
+		return 0;
+	}
+	uint64_t result = 1;
+	uint64_t current = (uint64_t)base;
+	while (exp > 0)
+	{
+		if (exp & 1)
+		{
+			result *= current;
+		}
+		current *= current;
+		exp >>= 1;
+	}
+	return (int64_t)result;
+}
+
+static IRValue* opt_fold_float(int opcode, double a, double b, IRType* type)
+{
+	switch (opcode)
+	{
+		case 1:
+			return opt_const_float(a + b, type);
+		case 2:
+			return opt_const_float(a - b, type);
+		case 3:
+			return opt_const_float(a * b, type);
+		case 4:
+			return opt_const_float(a / b, type);
+		case 6:
+			return opt_const_int(a == b, type);
+		case 7:
+			return opt_const_int(a != b, type);
+		case 8:
+			return opt_const_int(a < b, type);
+		case 9:
+			return opt_const_int(a > b, type);
+		case 10:
+			return opt_const_int(a <= b, type);
+		case 11:
+			return opt_const_int(a >= b, type);
+		default:
+			// frem and pow go through libm at runtime; leave them alone.
+			return NULL;
+	}
+}
+
+static IRValue* opt_fold_binop(IRInstruction* ins)
+{
+	IRValue* lhs = ins->operands[0];
+	IRValue* rhs = ins->operands[1];
+	IRType* type = ins->dest ? ins->dest->type : NULL;
+	if (ins->kind != IR_BINOP || !type || !rhs || rhs->kind != IRV_CONST)
+	{
+		return NULL;
+	}
+	if (ins->opcode == 15)
+	{
+		return opt_is_float(rhs->type) ? NULL : opt_const_int(rhs->u.i64 == 0, type);
+	}
+	if (!lhs || lhs->kind != IRV_CONST || opt_is_float(lhs->type) != opt_is_float(rhs->type))
+	{
+		return NULL;
+	}
+	if (opt_is_float(lhs->type))
+	{
+		return opt_is_float(type) || (ins->opcode >= 6 && ins->opcode <= 11)
+		           ? opt_fold_float(ins->opcode, lhs->u.f64, rhs->u.f64, type)
+		           : NULL;
+	}
+
+	int width = opt_int_width(lhs->type);
+	if (!width || !opt_int_width(type))
+	{
+		return NULL;
+	}
+	if (width == 1 && ins->opcode >= 8 && ins->opcode <= 11)
+	{
+		return NULL;
+	}
+	int64_t a = opt_wrap_int((uint64_t)lhs->u.i64, width);
+	int64_t b = opt_wrap_int((uint64_t)rhs->u.i64, width);
+	switch (ins->opcode)
+	{
+		case 1:
+			return opt_const_int((int64_t)((uint64_t)a + (uint64_t)b), type);
+		case 2:
+			return opt_const_int((int64_t)((uint64_t)a - (uint64_t)b), type);
+		case 3:
+			return opt_const_int((int64_t)((uint64_t)a * (uint64_t)b), type);
+		case 4:
+		case 5:
+		{
+			// Division by zero and INT_MIN / -1 trap (or are undefined) at runtime.
+			int64_t min = opt_wrap_int(UINT64_C(1) << (width - 1), width);
+			if (width < 8 || b == 0 || (b == -1 && a == min))
+			{
+				return NULL;
+			}
+			return opt_const_int(ins->opcode == 4 ? a / b : a % b, type);
+		}
+		case 6:
+			return opt_const_int(a == b, type);
+		case 7:
+			return opt_const_int(a != b, type);
+		case 8:
+			return opt_const_int(a < b, type);
+		case 9:
+			return opt_const_int(a > b, type);
+		case 10:
+			return opt_const_int(a <= b, type);
+		case 11:
+			return opt_const_int(a >= b, type);
+		case 12:
+			return opt_const_int(opt_powi(a, b), type);
+		case 13:
+			return opt_const_int(a | b, type);
+		case 14:
+			return opt_const_int(a & b, type);
+		default:
+			return NULL;
+	}
+}
+
+static IRValue* opt_simplify_binop(IRInstruction* ins)
+{
+	IRValue* lhs = ins->operands[0];
+	IRValue* rhs = ins->operands[1];
+	IRType* type = ins->dest ? ins->dest->type : NULL;
+	if (ins->kind != IR_BINOP || !type || !lhs || !rhs)
+	{
+		return NULL;
+	}
+
+	if (opt_is_float(type))
+	{
+		// Only rewrites that are exact for every IEEE input, including -0.0 and NaN.
+		if ((ins->opcode == 3 || ins->opcode == 4) && opt_is_float_const(rhs, 1.0))
+		{
+			return opt_same_kind(lhs, type) ? lhs : NULL;
+		}
+		if (ins->opcode == 3 && opt_is_float_const(lhs, 1.0))
+		{
+			return opt_same_kind(rhs, type) ? rhs : NULL;
+		}
+		if (ins->opcode == 2 && opt_is_float_const(rhs, 0.0))
+		{
+			return opt_same_kind(lhs, type) ? lhs : NULL;
+		}
+		return NULL;
+	}
+	if (!opt_int_width(type) || opt_is_float(lhs->type) || opt_is_float(rhs->type))
+	{
+		return NULL;
+	}
+
+	int same = lhs == rhs && lhs->kind != IRV_CONST;
+	switch (ins->opcode)
+	{
+		case 1:
+			if (opt_is_int_const(rhs, 0) && opt_same_kind(lhs, type))
+				return lhs;
+			if (opt_is_int_const(lhs, 0) && opt_same_kind(rhs, type))
+				return rhs;
+			break;
+		case 2:
+			if (opt_is_int_const(rhs, 0) && opt_same_kind(lhs, type))
+				return lhs;
+			if (same)
+				return opt_const_int(0, type);
+			break;
+		case 3:
+			if (opt_is_int_const(rhs, 0) || opt_is_int_const(lhs, 0))
+				return opt_const_int(0, type);
+			if (opt_is_int_const(rhs, 1) && opt_same_kind(lhs, type))
+				return lhs;
+			if (opt_is_int_const(lhs, 1) && opt_same_kind(rhs, type))
+				return rhs;
+			break;
+		case 4:
+			if (opt_is_int_const(rhs, 1) && opt_same_kind(lhs, type))
+				return lhs;
+			break;
+		case 5:
+			if (opt_is_int_const(rhs, 1) || opt_is_int_const(rhs, -1))
+				return opt_const_int(0, type);
+			break;
+		case 6:
+		case 10:
+		case 11:
+			if (same)
+				return opt_const_int(1, type);
+			break;
+		case 7:
+		case 8:
+		case 9:
+			if (same)
+				return opt_const_int(0, type);
+			break;
+		case 12:
+			if (opt_is_int_const(rhs, 0))
+				return opt_const_int(1, type);
+			if (opt_is_int_const(rhs, 1) && opt_same_kind(lhs, type))
+				return lhs;
+			break;
+		case 13:
+			if ((opt_is_int_const(rhs, 0) || same) && opt_same_kind(lhs, type))
+				return lhs;
+			if (opt_is_int_const(lhs, 0) && opt_same_kind(rhs, type))
+				return rhs;
+			break;
+		case 14:
+			if (opt_is_int_const(rhs, 0) || opt_is_int_const(lhs, 0))
+				return opt_const_int(0, type);
+			if (same && opt_same_kind(lhs, type))
+				return lhs;
+			break;
+		default:
+			break;
+	}
+	return NULL;
+}
+
+static int opt_same_value(const IRValue* a, const IRValue* b)
+{
+	if (a == b)
+	{
+		return 1;
+	}
+	return a && b && a->kind == IRV_CONST && b->kind == IRV_CONST && a->type && b->type &&
+	       a->type->kind == b->type->kind && a->u.i64 == b->u.i64;
+}
+
+// A phi whose incoming values are all the same (ignoring itself) is that value.
+static IRValue* opt_simplify_phi(IRInstruction* ins)
+{
+	IRValue* same = NULL;
+	for (size_t i = 0; i < ins->call_nargs; ++i)
+	{
+		IRValue* v = ins->call_args[i];
+		if (v == ins->dest)
+		{
+			continue;
+		}
+		if (same && !opt_same_value(same, v))
+		{
+			return NULL;
+		}
+		same = v;
+	}
+	return opt_same_kind(same, ins->dest->type) ? same : NULL;
+}
+
+static IRValue* opt_simplify_instruction(IRInstruction* ins)
+{
+	if (ins->kind == IR_PHI)
+	{
+		return opt_simplify_phi(ins);
+	}
+	return opt_simplify_binop(ins);
+}
+
+static IRValue* opt_resolve(const OptPtrMap* replaced, IRValue* v)
+{
+	IRValue* next;
+	while (v && (next = (IRValue*)opt_map_get(replaced, v)) != NULL)
+	{
+		v = next;
+	}
+	return v;
+}
+
+static void opt_resolve_operands(const OptPtrMap* replaced, IRInstruction* ins)
+{
+	if (!replaced->count)
+	{
+		return;
+	}
+	// Branch targets and call callees live in the operand slots too, but they are
+	// never map keys, so resolving them is a no-op.
+	for (int i = 0; i < 3; ++i)
+	{
+		ins->operands[i] = opt_resolve(replaced, ins->operands[i]);
+	}
+	for (size_t i = 0; ins->call_args && i < ins->call_nargs; ++i)
+	{
+		ins->call_args[i] = opt_resolve(replaced, ins->call_args[i]);
+	}
+}
+
+static void opt_unlink(IRBlock* b, IRInstruction* prev, IRInstruction* ins)
+{
+	if (prev)
+	{
+		prev->next = ins->next;
+	}
+	else
+	{
+		b->first = ins->next;
+	}
+	if (b->last == ins)
+	{
+		b->last = prev;
+	}
+	free(ins->call_args);
+	free(ins->phi_blocks);
+	free(ins);
+}
+
+static int opt_is_terminator(const IRInstruction* ins)
+{
+	return ins->kind == IR_RET || ins->kind == IR_BR || ins->kind == IR_CBR;
+}
+
+// Fills `out` with the targets of the block's terminator, one per CFG edge.
+static int opt_successors(const IRBlock* b, IRBlock* out[2])
+{
+	const IRInstruction* term = b->last;
+	if (!term)
+	{
+		return 0;
+	}
+	if (term->kind == IR_BR)
+	{
+		out[0] = (IRBlock*)(void*)term->operands[0];
+		return out[0] ? 1 : 0;
+	}
+	if (term->kind == IR_CBR)
+	{
+		out[0] = (IRBlock*)(void*)term->operands[1];
+		out[1] = (IRBlock*)(void*)term->operands[2];
+		return out[0] && out[1] ? 2 : 0;
+	}
+	return 0;
+}
+
+static void opt_phi_remove_entry(IRInstruction* phi, size_t i)
+{
+	memmove(&phi->call_args[i], &phi->call_args[i + 1],
+	        (phi->call_nargs - i - 1) * sizeof(*phi->call_args));
+	memmove(&phi->phi_blocks[i], &phi->phi_blocks[i + 1],
+	        (phi->call_nargs - i - 1) * sizeof(*phi->phi_blocks));
+	phi->call_nargs--;
+}
+
+// Drops the incoming entry for one CFG edge pred -> b from every phi in `b`.
+static void opt_phi_remove_incoming(IRBlock* b, const IRBlock* pred)
+{
+	for (IRInstruction* ins = b ? b->first : NULL; ins; ins = ins->next)
+	{
+		for (size_t i = 0; ins->kind == IR_PHI && i < ins->call_nargs; ++i)
+		{
+			if (ins->phi_blocks[i] == pred)
+			{
+				opt_phi_remove_entry(ins, i);
+				break;
+			}
+		}
+	}
+}
+
+// Replaces every instruction for which `rewrite` produces an equivalent value and
+// forwards the uses. Returns the number of instructions removed.
+static int opt_rewrite_function(IRFunction* f, IRValue* (*rewrite)(IRInstruction*))
+{
+	OptPtrMap replaced = {0};
+	int changed = 0;
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		IRInstruction* prev = NULL;
+		IRInstruction* ins = b->first;
+		while (ins)
+		{
+			IRInstruction* next = ins->next;
+			opt_resolve_operands(&replaced, ins);
+			IRValue* value = ins->dest ? rewrite(ins) : NULL;
+			if (value && value != ins->dest && opt_map_put(&replaced, ins->dest, value) == 0)
+			{
+				opt_unlink(b, prev, ins);
+				changed++;
+			}
+			else
+			{
+				prev = ins;
+			}
+			ins = next;
+		}
+	}
+	// Uses that appear before their (now removed) definition in block order, such as
+	// loop back-edges, still need forwarding.
+	if (replaced.count)
+	{
+		for (IRBlock* b = f->blocks; b; b = b->next)
+		{
+			for (IRInstruction* ins = b->first; ins; ins = ins->next)
+			{
+				opt_resolve_operands(&replaced, ins);
+			}
+		}
+	}
+	opt_map_free(&replaced);
+	return changed;
+}
+
+static int opt_block_has_phi(const IRBlock* b)
+{
+	for (const IRInstruction* ins = b->first; ins; ins = ins->next)
+	{
+		if (ins->kind == IR_PHI)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int opt_simplify_branches(IRFunction* f)
+{
+	int changed = 0;
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		for (IRInstruction* ins = b->first; ins; ins = ins->next)
+		{
+			if (ins->kind != IR_CBR)
+			{
+				continue;
+			}
+			IRValue* cond = ins->operands[0];
+			IRValue* target = NULL;
+			IRValue* dropped = NULL;
+			if (ins->operands[1] == ins->operands[2])
+			{
+				target = ins->operands[1];
+				dropped = ins->operands[2];
+			}
+			else if (cond && cond->kind == IRV_CONST && !opt_is_float(cond->type))
+			{
+				target = cond->u.i64 != 0 ? ins->operands[1] : ins->operands[2];
+				dropped = cond->u.i64 != 0 ? ins->operands[2] : ins->operands[1];
+			}
+			if (target)
+			{
+				opt_phi_remove_incoming((IRBlock*)(void*)dropped, b);
+				ins->kind = IR_BR;
+				ins->operands[0] = target;
+				ins->operands[1] = NULL;
+				ins->operands[2] = NULL;
+				changed++;
+			}
+		}
+	}
+
+	// Retarget edges that go through a block holding nothing but `br` so that the
+	// forwarding block becomes unreachable. Blocks feeding a phi keep their edge.
+	for (IRBlock* b = f->blocks ? f->blocks->next : NULL; b; b = b->next)
+	{
+		IRInstruction* only = b->first;
+		if (!only || only->next || only->kind != IR_BR)
+		{
+			continue;
+		}
+		IRBlock* target = (IRBlock*)(void*)only->operands[0];
+		if (!target || target == b || opt_block_has_phi(target))
+		{
+			continue;
+		}
+		for (IRBlock* p = f->blocks; p; p = p->next)
+		{
+			for (IRInstruction* ins = p->first; ins; ins = ins->next)
+			{
+				if (ins == only || (ins->kind != IR_BR && ins->kind != IR_CBR))
+				{
+					continue;
+				}
+				for (int i = ins->kind == IR_BR ? 0 : 1; i < 3; ++i)
+				{
+					if (ins->operands[i] == (IRValue*)(void*)b)
+					{
+						ins->operands[i] = (IRValue*)(void*)target;
+						changed++;
+					}
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+static int opt_unreachable_function(IRFunction* f)
+{
+	int changed = 0;
+	size_t block_count = 0;
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		// Anything after the first terminator can never run.
+		for (IRInstruction* ins = b->first; ins; ins = ins->next)
+		{
+			if (opt_is_terminator(ins))
+			{
+				while (ins->next)
+				{
+					opt_unlink(b, ins, ins->next);
+					changed++;
+				}
+				break;
+			}
+		}
+		block_count++;
+	}
+	if (block_count < 2)
+	{
+		return changed;
+	}
+
+	IRBlock** stack = malloc(block_count * sizeof(*stack));
+	OptPtrMap reachable = {0};
+	if (!stack)
+	{
+		fprintf(stderr, "Failed to allocate unreachable-block worklist. (Error)\n");
+		return changed;
+	}
+	size_t top = 0;
+	stack[top++] = f->blocks;
+	opt_map_put(&reachable, f->blocks, f->blocks);
+	while (top > 0)
+	{
+		IRBlock* succs[2];
+		IRBlock* b = stack[--top];
+		int n = opt_successors(b, succs);
+		for (int i = 0; i < n; ++i)
+		{
+			if (!opt_map_get(&reachable, succs[i]) && top < block_count)
+			{
+				opt_map_put(&reachable, succs[i], succs[i]);
+				stack[top++] = succs[i];
+			}
+		}
+	}
+	free(stack);
+
+	// Phis in surviving blocks must forget edges that come from removed blocks.
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		for (IRInstruction* ins = b->first; ins; ins = ins->next)
+		{
+			for (size_t i = ins->kind == IR_PHI ? ins->call_nargs : 0; i > 0; --i)
+			{
+				if (!opt_map_get(&reachable, ins->phi_blocks[i - 1]))
+				{
+					opt_phi_remove_entry(ins, i - 1);
+				}
+			}
+		}
+	}
+
+	IRBlock* prev = f->blocks;
+	IRBlock* b = prev->next;
+	while (b)
+	{
+		IRBlock* next = b->next;
+		if (opt_map_get(&reachable, b))
+		{
+			prev = b;
+		}
+		else
+		{
+			prev->next = next;
+			while (b->first)
+			{
+				opt_unlink(b, NULL, b->first);
+				changed++;
+			}
+			free(b->name);
+			free(b);
+			changed++;
+		}
+		b = next;
+	}
+	opt_map_free(&reachable);
+	return changed;
+}
+
+static int opt_is_pure(const IRInstruction* ins)
+{
+	switch (ins->kind)
+	{
+		case IR_CONST:
+		case IR_ALLOCA:
+		case IR_LOAD:
+		case IR_BINOP:
+		case IR_PHI:
+		case IR_FPCVT:
+		case IR_ITOFP:
+		case IR_ICAST:
+		case IR_GEP:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static void opt_count_operands(OptPtrMap* uses, const IRInstruction* ins, intptr_t delta)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		opt_count_add(uses, ins->operands[i], delta);
+	}
+	for (size_t i = 0; ins->call_args && i < ins->call_nargs; ++i)
+	{
+		opt_count_add(uses, ins->call_args[i], delta);
+	}
+}
+
+static int opt_dead_code_function(IRFunction* f)
+{
+	OptPtrMap uses = {0};
+	OptPtrMap store_uses = {0};
+	OptPtrMap slots = {0};
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		for (IRInstruction* ins = b->first; ins; ins = ins->next)
+		{
+			opt_count_operands(&uses, ins, 1);
+			if (ins->kind == IR_STORE)
+			{
+				opt_count_add(&store_uses, ins->operands[0], 1);
+			}
+			else if (ins->kind == IR_ALLOCA && ins->dest)
+			{
+				opt_map_put(&slots, ins->dest, ins->dest);
+			}
+		}
+	}
+
+	int changed = 0;
+	int removed;
+	do
+	{
+		removed = 0;
+		for (IRBlock* b = f->blocks; b; b = b->next)
+		{
+			IRInstruction* prev = NULL;
+			IRInstruction* ins = b->first;
+			while (ins)
+			{
+				IRInstruction* next = ins->next;
+				int dead = ins->kind == IR_NOP;
+				if (!dead && opt_is_pure(ins) && ins->dest)
+				{
+					dead = opt_count_get(&uses, ins->dest) == 0;
+				}
+				else if (!dead && ins->kind == IR_STORE &&
+				         opt_map_get(&slots, ins->operands[0]))
+				{
+					// A local slot that is only ever written is never observed; its
+					// stores go first and the alloca follows once it has no uses.
+					dead = opt_count_get(&uses, ins->operands[0]) ==
+					       opt_count_get(&store_uses, ins->operands[0]);
+					if (dead)
+					{
+						opt_count_add(&store_uses, ins->operands[0], -1);
+					}
+				}
+				if (dead)
+				{
+					opt_count_operands(&uses, ins, -1);
+					opt_unlink(b, prev, ins);
+					removed++;
+				}
+				else
+				{
+					prev = ins;
+				}
+				ins = next;
+			}
+		}
+		changed += removed;
+	} while (removed);
+
+	opt_map_free(&uses);
+	opt_map_free(&store_uses);
+	opt_map_free(&slots);
+	return changed;
+}
+
+#define OPT_NO_BLOCK ((size_t)-1)
+
+typedef struct
+{
+	IRBlock** blocks; // reverse postorder, entry first
+	size_t count;
+	OptPtrMap index; // IRBlock* -> position in `blocks` + 1
+	size_t* idom;
+	size_t* first_child;
+	size_t* next_sibling;
+	size_t** frontier;
+	size_t* frontier_count;
+	IRValue** slots;
+	size_t slot_count;
+	OptPtrMap slot_of;  // alloca dest -> slot + 1
+	OptPtrMap phi_slot; // phi instruction -> slot + 1
+	OptPtrMap replaced; // promoted load dest -> reaching value
+} OptMem2Reg;
+
+static size_t opt_block_index(const OptMem2Reg* ctx, const IRBlock* b)
+{
+	uintptr_t i = (uintptr_t)opt_map_get(&ctx->index, b);
+	return i ? (size_t)i - 1 : OPT_NO_BLOCK;
+}
+
+static int opt_collect_rpo(IRFunction* f, OptMem2Reg* ctx)
+{
+	size_t total = 0;
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		total++;
+	}
+	IRBlock** order = malloc(total * sizeof(*order));
+	IRBlock** stack = malloc(total * sizeof(*stack));
+	int* next_succ = calloc(total, sizeof(*next_succ));
+	OptPtrMap visited = {0};
+	if (!order || !stack || !next_succ)
+	{
+		free(order);
+		free(stack);
+		free(next_succ);
+		return -1;
+	}
+
+	// Iterative DFS; stack slots are paired with next_succ to resume each block.
+	size_t top = 0;
+	size_t post = total;
+	stack[top++] = f->blocks;
+	opt_map_put(&visited, f->blocks, f->blocks);
+	while (top > 0)
+	{
+		IRBlock* succs[2];
+		IRBlock* b = stack[top - 1];
+		int n = opt_successors(b, succs);
+		if (next_succ[top - 1] < n)
+		{
+			IRBlock* s = succs[next_succ[top - 1]++];
+			if (!opt_map_get(&visited, s) && top < total)
+			{
+				opt_map_put(&visited, s, s);
+				next_succ[top] = 0;
+				stack[top++] = s;
+			}
+			continue;
+		}
+		order[--post] = b;
+		top--;
+	}
+	opt_map_free(&visited);
+	free(stack);
+	free(next_succ);
+
+	ctx->count = total - post;
+	memmove(order, order + post, ctx->count * sizeof(*order));
+	ctx->blocks = order;
+	for (size_t i = 0; i < ctx->count; ++i)
+	{
+		opt_map_put(&ctx->index, order[i], (void*)(uintptr_t)(i + 1));
+	}
+	return 0;
+}
+
+static size_t opt_dom_intersect(const size_t* idom, size_t a, size_t b)
+{
+	while (a != b)
+	{
+		while (a > b)
+		{
+			a = idom[a];
+		}
+		while (b > a)
+		{
+			b = idom[b];
+		}
+	}
+	return a;
+}
+
+// Cooper, Harvey and Kennedy's iterative dominator algorithm over the RPO, followed
+// by dominance frontiers computed from each join point's predecessors.
+static int opt_build_dominators(OptMem2Reg* ctx)
+{
+	size_t n = ctx->count;
+	size_t* pred_count = calloc(n, sizeof(*pred_count));
+	size_t** preds = calloc(n, sizeof(*preds));
+	ctx->idom = malloc(n * sizeof(*ctx->idom));
+	ctx->first_child = malloc(n * sizeof(*ctx->first_child));
+	ctx->next_sibling = malloc(n * sizeof(*ctx->next_sibling));
+	ctx->frontier = calloc(n, sizeof(*ctx->frontier));
+	ctx->frontier_count = calloc(n, sizeof(*ctx->frontier_count));
+	int rc = -1;
+	if (!pred_count || !preds || !ctx->idom || !ctx->first_child || !ctx->next_sibling ||
+	    !ctx->frontier || !ctx->frontier_count)
+	{
+		goto cleanup;
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		IRBlock* succs[2];
+		int ns = opt_successors(ctx->blocks[i], succs);
+		for (int k = 0; k < ns; ++k)
+		{
+			size_t s = opt_block_index(ctx, succs[k]);
+			size_t* grown = realloc(preds[s], (pred_count[s] + 1) * sizeof(*grown));
+			if (!grown)
+			{
+				goto cleanup;
+			}
+			preds[s] = grown;
+			preds[s][pred_count[s]++] = i;
+		}
+		ctx->idom[i] = OPT_NO_BLOCK;
+		ctx->first_child[i] = OPT_NO_BLOCK;
+		ctx->next_sibling[i] = OPT_NO_BLOCK;
+	}
+
+	ctx->idom[0] = 0;
+	int changed = 1;
+	while (changed)
+	{
+		changed = 0;
+		for (size_t b = 1; b < n; ++b)
+		{
+			size_t new_idom = OPT_NO_BLOCK;
+			for (size_t k = 0; k < pred_count[b]; ++k)
+			{
+				size_t p = preds[b][k];
+				if (ctx->idom[p] == OPT_NO_BLOCK)
+				{
+					continue;
+				}
+				new_idom = new_idom == OPT_NO_BLOCK
+				               ? p
+				               : opt_dom_intersect(ctx->idom, p, new_idom);
+			}
+			if (new_idom != ctx->idom[b])
+			{
+				ctx->idom[b] = new_idom;
+				changed = 1;
+			}
+		}
+	}
+
+	// Children are linked in reverse so the tree walk visits them in RPO.
+	for (size_t b = n; b-- > 1;)
+	{
+		size_t parent = ctx->idom[b];
+		ctx->next_sibling[b] = ctx->first_child[parent];
+		ctx->first_child[parent] = b;
+	}
+
+	for (size_t b = 0; b < n; ++b)
+	{
+		if (pred_count[b] < 2)
+		{
+			continue;
+		}
+		for (size_t k = 0; k < pred_count[b]; ++k)
+		{
+			size_t runner = preds[b][k];
+			while (runner != ctx->idom[b])
+			{
+				size_t c = ctx->frontier_count[runner];
+				if (c == 0 || ctx->frontier[runner][c - 1] != b)
+				{
+					size_t* grown =
+					    realloc(ctx->frontier[runner], (c + 1) * sizeof(*grown));
+					if (!grown)
+					{
+						goto cleanup;
+					}
+					ctx->frontier[runner] = grown;
+					ctx->frontier[runner][ctx->frontier_count[runner]++] = b;
+				}
+				runner = ctx->idom[runner];
+			}
+		}
+	}
+	rc = 0;
+
+cleanup:
+	for (size_t i = 0; preds && i < n; ++i)
+	{
+		free(preds[i]);
+	}
+	free(preds);
+	free(pred_count);
+	return rc;
+}
+
+static IRType* opt_slot_type(const IRValue* slot)
+{
+	return slot->type ? slot->type->pointee : NULL;
+}
+
+// Baseline lowering sometimes stores an i64 literal into a narrower slot; a constant
+// can simply be re-typed to the slot, anything else keeps the slot in memory.
+static IRValue* opt_value_for_slot(IRValue* v, IRType* type)
+{
+	if (opt_same_kind(v, type))
+	{
+		return v;
+	}
+	if (!v || v->kind != IRV_CONST || !type)
+	{
+		return NULL;
+	}
+	if (type->kind == IR_T_PTR)
+	{
+		return v->u.i64 == 0 && !opt_is_float(v->type) ? opt_const_int(0, type) : NULL;
+	}
+	if (opt_is_float(type))
+	{
+		return opt_const_float(opt_is_float(v->type) ? v->u.f64 : (double)v->u.i64, type);
+	}
+	if (opt_int_width(type))
+	{
+		return opt_const_int(opt_is_float(v->type) ? (int64_t)v->u.f64 : v->u.i64, type);
+	}
+	return NULL;
+}
+
+static IRValue* opt_zero_for_slot(IRType* type)
+{
+	return opt_is_float(type) ? opt_const_float(0.0, type) : opt_const_int(0, type);
+}
+
+static void opt_reject_slot_uses(OptMem2Reg* ctx, IRInstruction* ins, int* promotable)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		uintptr_t s = (uintptr_t)opt_map_get(&ctx->slot_of, ins->operands[i]);
+		if (!s)
+		{
+			continue;
+		}
+		IRType* type = opt_slot_type(ctx->slots[s - 1]);
+		int ok = i == 0 && ((ins->kind == IR_LOAD && ins->dest &&
+		                     opt_same_kind(ins->dest, type)) ||
+		                    (ins->kind == IR_STORE && ins->operands[1] != ins->operands[0] &&
+		                     opt_value_for_slot(ins->operands[1], type) != NULL));
+		if (!ok)
+		{
+			promotable[s - 1] = 0;
+		}
+	}
+	for (size_t i = 0; ins->call_args && i < ins->call_nargs; ++i)
+	{
+		uintptr_t s = (uintptr_t)opt_map_get(&ctx->slot_of, ins->call_args[i]);
+		if (s)
+		{
+			promotable[s - 1] = 0;
+		}
+	}
+}
+
+static void opt_rename_block(OptMem2Reg* ctx, size_t bi, IRValue** incoming)
+{
+	IRBlock* b = ctx->blocks[bi];
+	IRValue** current = malloc(ctx->slot_count * sizeof(*current));
+	if (!current)
+	{
+		return;
+	}
+	memcpy(current, incoming, ctx->slot_count * sizeof(*current));
+
+	IRInstruction* prev = NULL;
+	IRInstruction* ins = b->first;
+	while (ins)
+	{
+		IRInstruction* next = ins->next;
+		uintptr_t s = (uintptr_t)opt_map_get(&ctx->phi_slot, ins);
+		if (s)
+		{
+			current[s - 1] = ins->dest;
+			prev = ins;
+			ins = next;
+			continue;
+		}
+		opt_resolve_operands(&ctx->replaced, ins);
+		s = (uintptr_t)opt_map_get(&ctx->slot_of, ins->operands[0]);
+		if (s && ins->kind == IR_LOAD)
+		{
+			opt_map_put(&ctx->replaced, ins->dest, current[s - 1]);
+			opt_unlink(b, prev, ins);
+		}
+		else if (s && ins->kind == IR_STORE)
+		{
+			current[s - 1] =
+			    opt_value_for_slot(ins->operands[1], opt_slot_type(ctx->slots[s - 1]));
+			opt_unlink(b, prev, ins);
+		}
+		else
+		{
+			prev = ins;
+		}
+		ins = next;
+	}
+
+	IRBlock* succs[2];
+	int ns = opt_successors(b, succs);
+	for (int k = 0; k < ns; ++k)
+	{
+		for (IRInstruction* phi = succs[k]->first; phi; phi = phi->next)
+		{
+			uintptr_t s = (uintptr_t)opt_map_get(&ctx->phi_slot, phi);
+			if (s)
+			{
+				ir_phi_add_incoming(phi, current[s - 1], b);
+			}
+		}
+	}
+
+	for (size_t c = ctx->first_child[bi]; c != OPT_NO_BLOCK; c = ctx->next_sibling[c])
+	{
+		opt_rename_block(ctx, c, current);
+	}
+	free(current);
+}
+
+static void opt_place_phis(OptMem2Reg* ctx)
+{
+	size_t n = ctx->count;
+	size_t* has_phi = calloc(n, sizeof(*has_phi));
+	size_t* queued = calloc(n, sizeof(*queued));
+	size_t* work = malloc(n * sizeof(*work));
+	size_t** def_blocks = calloc(ctx->slot_count, sizeof(*def_blocks));
+	size_t* def_count = calloc(ctx->slot_count, sizeof(*def_count));
+	if (!has_phi || !queued || !work || !def_blocks || !def_count)
+	{
+		goto cleanup;
+	}
+	for (size_t b = 0; b < n; ++b)
+	{
+		for (IRInstruction* ins = ctx->blocks[b]->first; ins; ins = ins->next)
+		{
+			uintptr_t s = ins->kind == IR_STORE
+			                  ? (uintptr_t)opt_map_get(&ctx->slot_of, ins->operands[0])
+			                  : 0;
+			size_t c = s ? def_count[s - 1] : 0;
+			if (!s || (c > 0 && def_blocks[s - 1][c - 1] == b))
+			{
+				continue;
+			}
+			size_t* grown = realloc(def_blocks[s - 1], (c + 1) * sizeof(*grown));
+			if (!grown)
+			{
+				goto cleanup;
+			}
+			def_blocks[s - 1] = grown;
+			def_blocks[s - 1][def_count[s - 1]++] = b;
+		}
+	}
+
+	for (size_t s = 0; s < ctx->slot_count; ++s)
+	{
+		size_t stamp = s + 1;
+		size_t top = 0;
+		for (size_t k = 0; k < def_count[s]; ++k)
+		{
+			queued[def_blocks[s][k]] = stamp;
+			work[top++] = def_blocks[s][k];
+		}
+		while (top > 0)
+		{
+			size_t b = work[--top];
+			for (size_t k = 0; k < ctx->frontier_count[b]; ++k)
+			{
+				size_t d = ctx->frontier[b][k];
+				if (has_phi[d] == stamp)
+				{
+					continue;
+				}
+				has_phi[d] = stamp;
+				IRInstruction* phi =
+				    ir_insert_phi(ctx->blocks[d], opt_slot_type(ctx->slots[s]));
+				if (phi)
+				{
+					opt_map_put(&ctx->phi_slot, phi, (void*)(uintptr_t)stamp);
+				}
+				if (queued[d] != stamp)
+				{
+					queued[d] = stamp;
+					work[top++] = d;
+				}
+			}
+		}
+	}
+
+cleanup:
+	for (size_t s = 0; def_blocks && s < ctx->slot_count; ++s)
+	{
+		free(def_blocks[s]);
+	}
+	free(def_blocks);
+	free(def_count);
+	free(has_phi);
+	free(queued);
+	free(work);
+}
+
+// Minimal SSA leaves phis nothing reads (or only other dead phis read); keep the
+// ones reachable from a real use.
+static int opt_prune_phis(OptMem2Reg* ctx)
+{
+	OptPtrMap phi_of = {0};
+	OptPtrMap live = {0};
+	size_t pending = 0;
+	IRInstruction** work = NULL;
+	int removed = 0;
+	for (size_t b = 0; b < ctx->count; ++b)
+	{
+		for (IRInstruction* ins = ctx->blocks[b]->first; ins; ins = ins->next)
+		{
+			if (opt_map_get(&ctx->phi_slot, ins))
+			{
+				opt_map_put(&phi_of, ins->dest, ins);
+				pending++;
+			}
+		}
+	}
+	work = malloc((pending + 1) * sizeof(*work));
+	if (!work)
+	{
+		opt_map_free(&phi_of);
+		return 0;
+	}
+
+	size_t top = 0;
+	for (size_t b = 0; b < ctx->count; ++b)
+	{
+		for (IRInstruction* ins = ctx->blocks[b]->first; ins; ins = ins->next)
+		{
+			if (opt_map_get(&ctx->phi_slot, ins))
+			{
+				continue;
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				IRInstruction* phi = opt_map_get(&phi_of, ins->operands[i]);
+				if (phi && !opt_map_get(&live, phi))
+				{
+					opt_map_put(&live, phi, phi);
+					work[top++] = phi;
+				}
+			}
+			for (size_t i = 0; ins->call_args && i < ins->call_nargs; ++i)
+			{
+				IRInstruction* phi = opt_map_get(&phi_of, ins->call_args[i]);
+				if (phi && !opt_map_get(&live, phi))
+				{
+					opt_map_put(&live, phi, phi);
+					work[top++] = phi;
+				}
+			}
+		}
+	}
+	while (top > 0)
+	{
+		IRInstruction* ins = work[--top];
+		for (size_t i = 0; i < ins->call_nargs; ++i)
+		{
+			IRInstruction* phi = opt_map_get(&phi_of, ins->call_args[i]);
+			if (phi && !opt_map_get(&live, phi))
+			{
+				opt_map_put(&live, phi, phi);
+				work[top++] = phi;
+			}
+		}
+	}
+
+	for (size_t b = 0; b < ctx->count; ++b)
+	{
+		IRInstruction* prev = NULL;
+		IRInstruction* ins = ctx->blocks[b]->first;
+		while (ins)
+		{
+			IRInstruction* next = ins->next;
+			if (opt_map_get(&ctx->phi_slot, ins) && !opt_map_get(&live, ins))
+			{
+				opt_unlink(ctx->blocks[b], prev, ins);
+				removed++;
+			}
+			else
+			{
+				prev = ins;
+			}
+			ins = next;
+		}
+	}
+	free(work);
+	opt_map_free(&phi_of);
+	opt_map_free(&live);
+	return removed;
+}
+
+static int opt_mem2reg_function(IRFunction* f)
+{
+	OptMem2Reg ctx = {0};
+	int* promotable = NULL;
+	IRValue** initial = NULL;
+	int changed = 0;
+
+	for (IRInstruction* ins = f->blocks->first; ins; ins = ins->next)
+	{
+		if (ins->kind == IR_ALLOCA && ins->dest && opt_slot_type(ins->dest))
+		{
+			ctx.slot_count++;
+		}
+	}
+	if (!ctx.slot_count)
+	{
+		return changed;
+	}
+	ctx.slots = malloc(ctx.slot_count * sizeof(*ctx.slots));
+	promotable = malloc(ctx.slot_count * sizeof(*promotable));
+	initial = malloc(ctx.slot_count * sizeof(*initial));
+	if (!ctx.slots || !promotable || !initial)
+	{
+		goto cleanup;
+	}
+	ctx.slot_count = 0;
+	for (IRInstruction* ins = f->blocks->first; ins; ins = ins->next)
+	{
+		if (ins->kind == IR_ALLOCA && ins->dest && opt_slot_type(ins->dest))
+		{
+			promotable[ctx.slot_count] = 1;
+			ctx.slots[ctx.slot_count] = ins->dest;
+			opt_map_put(&ctx.slot_of, ins->dest, (void*)(uintptr_t)(ctx.slot_count + 1));
+			ctx.slot_count++;
+		}
+	}
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		for (IRInstruction* ins = b->first; ins; ins = ins->next)
+		{
+			opt_reject_slot_uses(&ctx, ins, promotable);
+		}
+	}
+
+	// Only promotable slots stay in the map, so the rename walk ignores the rest.
+	int any = 0;
+	for (size_t s = 0; s < ctx.slot_count; ++s)
+	{
+		if (promotable[s])
+		{
+			any = 1;
+			initial[s] = opt_zero_for_slot(opt_slot_type(ctx.slots[s]));
+		}
+		else
+		{
+			opt_map_put(&ctx.slot_of, ctx.slots[s], NULL);
+			initial[s] = NULL;
+		}
+	}
+	if (!any || opt_collect_rpo(f, &ctx) != 0)
+	{
+		goto cleanup;
+	}
+	size_t total = 0;
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		total++;
+	}
+	// Loads in unreachable blocks have no reaching definition; wait for the
+	// unreachable-block pass to drop them.
+	if (ctx.count != total || opt_build_dominators(&ctx) != 0)
+	{
+		goto cleanup;
+	}
+
+	opt_place_phis(&ctx);
+	opt_rename_block(&ctx, 0, initial);
+
+	for (IRBlock* b = f->blocks; b; b = b->next)
+	{
+		IRInstruction* prev = NULL;
+		IRInstruction* ins = b->first;
+		while (ins)
+		{
+			IRInstruction* next = ins->next;
+			opt_resolve_operands(&ctx.replaced, ins);
+			if (ins->kind == IR_ALLOCA && opt_map_get(&ctx.slot_of, ins->dest))
+			{
+				opt_unlink(b, prev, ins);
+				changed++;
+			}
+			else
+			{
+				prev = ins;
+			}
+			ins = next;
+		}
+	}
+	opt_prune_phis(&ctx);
+	fprintf(stderr, "Promoted stack slots of '%s' to SSA values. (Info)\n",
+	        f->name ? f->name : "<anon>");
+
+cleanup:
+	for (size_t i = 0; ctx.frontier && i < ctx.count; ++i)
+	{
+		free(ctx.frontier[i]);
+	}
+	free(ctx.frontier);
+	free(ctx.frontier_count);
+	free(ctx.idom);
+	free(ctx.first_child);
+	free(ctx.next_sibling);
+	free(ctx.blocks);
+	free(ctx.slots);
+	free(promotable);
+	free(initial);
+	opt_map_free(&ctx.index);
+	opt_map_free(&ctx.slot_of);
+	opt_map_free(&ctx.phi_slot);
+	opt_map_free(&ctx.replaced);
+	return changed;
+}
+
+static int opt_run_on_functions(IRModule* m, int (*pass)(IRFunction*))
+{
+	int changed = 0;
+	for (IRFunction* f = m->functions; f; f = f->next)
+	{
+		if (!f->is_extern && f->blocks)
+		{
+			changed += pass(f);
+		}
+	}
+	return changed;
+}
+
+static int opt_const_fold_function(IRFunction* f)
+{
+	return opt_rewrite_function(f, opt_fold_binop);
+}
+
+static int opt_simplify_function(IRFunction* f)
+{
+	return opt_rewrite_function(f, opt_simplify_instruction) + opt_simplify_branches(f);
+}
+
+static int (*const opt_pass_functions[IR_OPT_PASS_COUNT])(IRFunction*) = {
+    opt_const_fold_function,
+    opt_simplify_function,
+    opt_unreachable_function,
+    opt_mem2reg_function,
+    opt_dead_code_function,
+};
 
 void ir_opt_const_fold(void* module)
 {
@@ -9,7 +1639,8 @@ void ir_opt_const_fold(void* module)
 		return;
 	}
 	fprintf(stderr, "Starting constant-folding optimization. (Info)\n");
-	fprintf(stderr, "Finished constant-folding optimization. (Info)\n");
+	int changed = opt_run_on_functions((IRModule*)module, opt_const_fold_function);
+	fprintf(stderr, "Finished constant-folding optimization: %d folded. (Info)\n", changed);
 }
 
 void ir_opt_dead_code_elim(void* module)
@@ -20,7 +1651,20 @@ void ir_opt_dead_code_elim(void* module)
 		return;
 	}
 	fprintf(stderr, "Starting dead-code elimination. (Info)\n");
-	fprintf(stderr, "Finished dead-code elimination. (Info)\n");
+	int changed = opt_run_on_functions((IRModule*)module, opt_dead_code_function);
+	fprintf(stderr, "Finished dead-code elimination: %d removed. (Info)\n", changed);
+}
+
+void ir_opt_unreachable_elim(void* module)
+{
+	if (!module)
+	{
+		fprintf(stderr, "ir_opt_unreachable_elim called with NULL module. (Warning)\n");
+		return;
+	}
+	fprintf(stderr, "Starting unreachable-block elimination. (Info)\n");
+	int changed = opt_run_on_functions((IRModule*)module, opt_unreachable_function);
+	fprintf(stderr, "Finished unreachable-block elimination: %d removed. (Info)\n", changed);
 }
 
 void ir_opt_simplify(void* module)
@@ -31,7 +1675,20 @@ void ir_opt_simplify(void* module)
 		return;
 	}
 	fprintf(stderr, "Starting IR simplification. (Info)\n");
-	fprintf(stderr, "Finished IR simplification. (Info)\n");
+	int changed = opt_run_on_functions((IRModule*)module, opt_simplify_function);
+	fprintf(stderr, "Finished IR simplification: %d simplified. (Info)\n", changed);
+}
+
+void ir_opt_mem2reg(void* module)
+{
+	if (!module)
+	{
+		fprintf(stderr, "ir_opt_mem2reg called with NULL module. (Warning)\n");
+		return;
+	}
+	fprintf(stderr, "Starting stack-slot promotion. (Info)\n");
+	int changed = opt_run_on_functions((IRModule*)module, opt_mem2reg_function);
+	fprintf(stderr, "Finished stack-slot promotion: %d promoted. (Info)\n", changed);
 }
 
 void ir_opt_run_all(void* module)
@@ -42,8 +1699,24 @@ void ir_opt_run_all(void* module)
 		return;
 	}
 	fprintf(stderr, "Running all IR optimizations. (Info)\n");
-	ir_opt_const_fold(module);
-	ir_opt_simplify(module);
-	ir_opt_dead_code_elim(module);
+	// Passes feed each other (folding exposes constant branches, which expose
+	// unreachable blocks, which expose dead values), so iterate to a fixed point.
+	for (int round = 1; round <= IR_OPT_MAX_ROUNDS; ++round)
+	{
+		int changed = 0;
+		for (int pass = 0; pass < IR_OPT_PASS_COUNT; ++pass)
+		{
+			if (opt_pass_enabled[pass])
+			{
+				changed += opt_run_on_functions((IRModule*)module,
+				                                opt_pass_functions[pass]);
+			}
+		}
+		fprintf(stderr, "IR optimization round %d: %d change(s). (Info)\n", round, changed);
+		if (!changed)
+		{
+			break;
+		}
+	}
 	fprintf(stderr, "Completed all IR optimizations. (Info)\n");
-}
\ No newline at end of file
+}
@@ -1,12 +1,39 @@
 #ifndef BACKEND_IR_OPT_H
 #define BACKEND_IR_OPT_H
 
+// Passes run in this order on every round of ir_opt_run_all.
+typedef enum
+{
+	IR_OPT_CONST_FOLD,
+	IR_OPT_SIMPLIFY,
+	IR_OPT_UNREACHABLE_ELIM,
+	IR_OPT_MEM2REG,
+	IR_OPT_DEAD_CODE_ELIM,
+	IR_OPT_PASS_COUNT
+} IrOptPass;
+
+// Every pass is enabled by default; ir_opt_run_all skips disabled ones.
+void ir_opt_set_pass_enabled(IrOptPass pass, int enabled);
+
+int ir_opt_pass_enabled(IrOptPass pass);
+
+const char* ir_opt_pass_name(IrOptPass pass);
+
+// Returns the pass with the given name, or -1 if there is none.
+int ir_opt_pass_from_name(const char* name);
+
 void ir_opt_const_fold(void* module);
 
 void ir_opt_dead_code_elim(void* module);
 
+void ir_opt_unreachable_elim(void* module);
+
 void ir_opt_simplify(void* module);
 
+// Promotes entry-block allocas that are only loaded and stored into SSA values,
+// inserting phis on the dominance frontier of each store.
+void ir_opt_mem2reg(void* module);
+
 void ir_opt_run_all(void* module);
 
 #endif
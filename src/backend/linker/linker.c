@@ -3,6 +3,8 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "linker.h"
 #include "../../embedded_libs.h"
@@ -11,10 +13,13 @@
 #include <windows.h>
 #include <io.h>
 #include <direct.h>
+#include <sys/utime.h>
 #define unlink      _unlink
 #define rmdir       _rmdir
 #define mkdir(p, m) _mkdir(p)
 #define getpid      (int)GetCurrentProcessId
+#define popen       _popen
+#define pclose      _pclose
 static char* get_tmp_dir(void)
 {
 	static char buf[MAX_PATH];
@@ -26,6 +31,8 @@ static char* get_tmp_dir(void)
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <utime.h>
 static char* get_tmp_dir(void)
 {
 	return "/tmp";
@@ -1374,49 +1381,657 @@ static int find_windows_libsodium_library(const char* search_paths_csv,
 }
 #endif
 
-static int run_clang_compile(const char* srcpath, const char* output_path,
-	                        const char* temp_include_dir,
-	                        const char* native_libraries_csv,
-	                        const char* native_search_paths_csv)
+// the -O flag for module compiles and the final link, or NULL for clang's default.
+// LTO defaults to -O2: at -O0 clang marks the runtime optnone and never inlines it.
+static const char* linker_opt_level(const LinkerConfig* config)
 {
-	arg_list argv = {0};
-	int result = -1;
+	if (config && config->opt_level && config->opt_level[0] != '\0')
+	{
+		return config->opt_level;
+	}
+
+	return config && config->lto ? "-O2" : NULL;
+}
+
+// flags shared by every `clang -c` of a bundled or embedded C module; they
+// are also hashed into the object cache key. With LTO the modules are
+// emitted as bitcode so they can be merged with the user module.
+static int arg_list_append_clang_compile_flags(arg_list* list, const LinkerConfig* config,
+	                                           const char* native_search_paths_csv)
+{
+	const char* opt_level = linker_opt_level(config);
 
-	if (!srcpath || !output_path)
+	if (opt_level && arg_list_append(list, opt_level) != 0)
 	{
 		return -1;
 	}
 
-	if (arg_list_append(&argv, "clang") != 0 ||
-	    arg_list_append(&argv, "-c") != 0 ||
-	    arg_list_append(&argv, srcpath) != 0)
+	if (config && config->lto && arg_list_append(list, "-emit-llvm") != 0)
 	{
-		goto cleanup;
+		return -1;
+	}
+
+	return arg_list_append_inferred_include_paths(list, native_search_paths_csv);
+}
+
+static const char* compiled_module_extension(const LinkerConfig* config)
+{
+	return config && config->lto ? ".bc" : ".o";
+}
+
+static int build_clang_compile_args(arg_list* argv, const LinkerConfig* config,
+	                                const char* srcpath, const char* output_path,
+	                                const char* temp_include_dir,
+	                                const char* native_search_paths_csv)
+{
+	if (!argv || !srcpath || !output_path)
+	{
+		return -1;
+	}
+
+	if (arg_list_append(argv, "clang") != 0 ||
+	    arg_list_append(argv, "-c") != 0 ||
+	    arg_list_append(argv, srcpath) != 0)
+	{
+		return -1;
 	}
 
 	if (temp_include_dir && temp_include_dir[0] != '\0' &&
-	    (arg_list_append(&argv, "-I") != 0 ||
-	     arg_list_append(&argv, temp_include_dir) != 0))
+	    (arg_list_append(argv, "-I") != 0 ||
+	     arg_list_append(argv, temp_include_dir) != 0))
+	{
+		return -1;
+	}
+
+	if (arg_list_append_clang_compile_flags(argv, config, native_search_paths_csv) != 0)
+	{
+		return -1;
+	}
+
+	if (arg_list_append(argv, "-o") != 0 ||
+	    arg_list_append(argv, output_path) != 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+// object cache: compiled runtime/stdlib C modules are stored under
+// <cache dir>/objects/<key>.o (<key>.bc with --lto), where the key hashes the
+// C source, the local headers it includes, the clang version and the compile
+// flags. Hits refresh an entry's mtime, and once the directory grows past
+// ADAN_CACHE_MAX_MB (default OBJECT_CACHE_MAX_MB; 0 disables pruning) the least
+// recently used entries are removed after the final link.
+#define OBJECT_CACHE_FORMAT       "adan-object-cache-1"
+#define OBJECT_CACHE_MAX_MB       512
+#define OBJECT_CACHE_HASH_OFFSET  14695981039346656037ULL
+#define OBJECT_CACHE_HASH_PRIME   1099511628211ULL
+#define OBJECT_CACHE_MAX_INCLUDES 8
+
+static uint64_t object_cache_hash_bytes(uint64_t hash, const void* data, size_t length)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= OBJECT_CACHE_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+static uint64_t object_cache_hash_string(uint64_t hash, const char* value)
+{
+	if (!value)
+	{
+		value = "";
+	}
+
+	// include the terminator so adjacent fields cannot run together
+	return object_cache_hash_bytes(hash, value, strlen(value) + 1);
+}
+
+static int make_dirs(const char* path)
+{
+	char buffer[1024];
+	size_t length;
+
+	if (!path || path[0] == '\0')
+	{
+		return -1;
+	}
+
+	length = strlen(path);
+	if (length + 1 > sizeof(buffer))
+	{
+		return -1;
+	}
+	memcpy(buffer, path, length + 1);
+
+	for (size_t i = 1; i <= length; ++i)
+	{
+		if (buffer[i] != '\0' && !is_path_separator(buffer[i]))
+		{
+			continue;
+		}
+
+		char saved = buffer[i];
+		buffer[i] = '\0';
+		if (!path_is_dir(buffer) && mkdir(buffer, 0755) != 0 && errno != EEXIST)
+		{
+			return -1;
+		}
+		buffer[i] = saved;
+	}
+
+	return path_is_dir(path) ? 0 : -1;
+}
+
+static const char* object_cache_dir(void)
+{
+	static char dir[1024];
+	static int resolved = 0;
+	const char* env;
+	char root[1024];
+
+	if (resolved)
+	{
+		return dir[0] ? dir : NULL;
+	}
+	resolved = 1;
+	dir[0] = '\0';
+
+	env = getenv("ADAN_NO_CACHE");
+	if (env && env[0] != '\0' && strcmp(env, "0") != 0)
+	{
+		return NULL;
+	}
+
+	env = getenv("ADAN_CACHE_DIR");
+	if (env && env[0] != '\0')
+	{
+		snprintf(root, sizeof(root), "%s", env);
+	}
+#ifdef _WIN32
+	else if ((env = getenv("LOCALAPPDATA")) && env[0] != '\0' &&
+	         path_join(root, sizeof(root), env, "adan") == 0)
+	{
+	}
+#else
+	else if ((env = getenv("XDG_CACHE_HOME")) && env[0] != '\0' &&
+	         path_join(root, sizeof(root), env, "adan") == 0)
+	{
+	}
+	else if ((env = getenv("HOME")) && env[0] != '\0' &&
+	         path_join(root, sizeof(root), env, ".cache/adan") == 0)
+	{
+	}
+#endif
+	else if (path_join(root, sizeof(root), get_tmp_dir(), "adan_cache") != 0)
+	{
+		return NULL;
+	}
+
+	if (path_join(dir, sizeof(dir), root, "objects") != 0 || make_dirs(dir) != 0)
+	{
+		fprintf(stderr, "linker: object cache disabled, cannot create '%s'.\n", root);
+		dir[0] = '\0';
+		return NULL;
+	}
+
+	return dir;
+}
+
+static const char* clang_version_string(void)
+{
+	static char version[1024];
+	static int resolved = 0;
+	FILE* pipe;
+	size_t length = 0;
+
+	if (resolved)
+	{
+		return version;
+	}
+	resolved = 1;
+
+	pipe = popen("clang --version", "r");
+	if (pipe)
+	{
+		length = fread(version, 1, sizeof(version) - 1, pipe);
+		pclose(pipe);
+	}
+	version[length] = '\0';
+
+	return version;
+}
+
+static char* read_file_bytes(const char* path, size_t* out_length)
+{
+	FILE* f = fopen(path, "rb");
+	char* buffer = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+
+	if (!f)
+	{
+		return NULL;
+	}
+
+	for (;;)
+	{
+		if (length + 4096 + 1 > capacity)
+		{
+			size_t new_capacity = capacity == 0 ? 8192 : capacity * 2;
+			char* resized = realloc(buffer, new_capacity);
+			if (!resized)
+			{
+				free(buffer);
+				fclose(f);
+				return NULL;
+			}
+			buffer = resized;
+			capacity = new_capacity;
+		}
+
+		size_t n = fread(buffer + length, 1, 4096, f);
+		length += n;
+		if (n < 4096)
+		{
+			break;
+		}
+	}
+
+	fclose(f);
+	buffer[length] = '\0';
+	*out_length = length;
+	return buffer;
+}
+
+// hashes every `#include "..."` that resolves next to the including file
+static uint64_t object_cache_hash_local_includes(uint64_t hash, const char* path,
+	                                              const char* source, int depth)
+{
+	char dir[1024];
+	const char* cursor = source;
+
+	if (depth >= OBJECT_CACHE_MAX_INCLUDES || path_dirname(path, dir, sizeof(dir)) != 0)
+	{
+		return hash;
+	}
+
+	while ((cursor = strstr(cursor, "#include")) != NULL)
+	{
+		const char* open;
+		const char* close;
+		char name[512];
+		char header_path[1024];
+		size_t name_length;
+		size_t header_length = 0;
+		char* header;
+
+		cursor += strlen("#include");
+		open = cursor;
+		while (*open == ' ' || *open == '\t')
+		{
+			open++;
+		}
+		if (*open != '"')
+		{
+			continue;
+		}
+		close = strchr(open + 1, '"');
+		if (!close)
+		{
+			break;
+		}
+
+		name_length = (size_t)(close - open - 1);
+		if (name_length == 0 || name_length >= sizeof(name))
+		{
+			continue;
+		}
+		memcpy(name, open + 1, name_length);
+		name[name_length] = '\0';
+
+		if (path_join(header_path, sizeof(header_path), dir, name) != 0)
+		{
+			continue;
+		}
+
+		header = read_file_bytes(header_path, &header_length);
+		hash = object_cache_hash_string(hash, name);
+		if (header)
+		{
+			hash = object_cache_hash_bytes(hash, header, header_length);
+			hash = object_cache_hash_local_includes(hash, header_path, header, depth + 1);
+			free(header);
+		}
+	}
+
+	return hash;
+}
+
+static int object_cache_key_begin(uint64_t* out_hash, const LinkerConfig* config,
+	                              const char* native_search_paths_csv)
+{
+	arg_list flags = {0};
+	uint64_t hash = OBJECT_CACHE_HASH_OFFSET;
+
+	if (arg_list_append_clang_compile_flags(&flags, config, native_search_paths_csv) != 0)
+	{
+		arg_list_free(&flags);
+		return -1;
+	}
+
+	hash = object_cache_hash_string(hash, OBJECT_CACHE_FORMAT);
+	hash = object_cache_hash_string(hash, clang_version_string());
+	for (size_t i = 0; i < flags.count; ++i)
+	{
+		hash = object_cache_hash_string(hash, flags.args[i]);
+	}
+
+	arg_list_free(&flags);
+	*out_hash = hash;
+	return 0;
+}
+
+static int object_cache_key_for_file(const char* srcpath, const LinkerConfig* config,
+	                                 const char* native_search_paths_csv, uint64_t* out_hash)
+{
+	size_t length = 0;
+	char* source;
+	uint64_t hash;
+
+	if (object_cache_key_begin(&hash, config, native_search_paths_csv) != 0)
+	{
+		return -1;
+	}
+
+	source = read_file_bytes(srcpath, &length);
+	if (!source)
+	{
+		return -1;
+	}
+
+	hash = object_cache_hash_bytes(hash, source, length);
+	hash = object_cache_hash_local_includes(hash, srcpath, source, 0);
+	free(source);
+
+	*out_hash = hash;
+	return 0;
+}
+
+static int object_cache_key_for_embedded(const char* c_src, const char* h_filename,
+	                                     const char* h_src, const LinkerConfig* config,
+	                                     const char* native_search_paths_csv,
+	                                     uint64_t* out_hash)
+{
+	uint64_t hash;
+
+	if (object_cache_key_begin(&hash, config, native_search_paths_csv) != 0)
+	{
+		return -1;
+	}
+
+	hash = object_cache_hash_string(hash, c_src);
+	hash = object_cache_hash_string(hash, h_filename);
+	hash = object_cache_hash_string(hash, h_src);
+
+	*out_hash = hash;
+	return 0;
+}
+
+// returns 1 on a hit, 0 on a miss and -1 when the cache is unavailable;
+// `out_path` receives the cache entry path for hits and misses
+static int object_cache_lookup(uint64_t key, const char* extension, char* out_path,
+	                           size_t out_size)
+{
+	const char* dir = object_cache_dir();
+	int written;
+
+	if (!dir)
+	{
+		return -1;
+	}
+
+	written = snprintf(out_path, out_size, "%s/%016llx%s", dir, (unsigned long long)key,
+	                   extension);
+	if (written < 0 || (size_t)written >= out_size)
+	{
+		return -1;
+	}
+
+	if (!path_exists(out_path))
+	{
+		return 0;
+	}
+
+	// mark the entry as recently used for object_cache_prune
+#ifdef _WIN32
+	_utime(out_path, NULL);
+#else
+	utime(out_path, NULL);
+#endif
+	return 1;
+}
+
+static int object_cache_staging_path(const char* cache_path, char* out_path,
+	                                 size_t out_size)
+{
+	static int staging_id = 0;
+	int written = snprintf(out_path, out_size, "%s.%d_%d.tmp", cache_path, (int)getpid(),
+	                       staging_id++);
+	return written >= 0 && (size_t)written < out_size ? 0 : -1;
+}
+
+// objects are compiled into a private staging file and renamed over the cache
+// entry, so concurrent builds never observe a partially written object
+static int object_cache_publish(const char* staging_path, const char* cache_path)
+{
+	if (rename(staging_path, cache_path) != 0)
+	{
+		// another build published the same key first
+		unlink(staging_path);
+		if (!path_exists(cache_path))
+		{
+			fprintf(stderr, "linker: failed to publish cached object '%s'.\n",
+			        cache_path);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+typedef struct
+{
+	char name[256];
+	uint64_t size;
+	int64_t mtime;
+} object_cache_entry;
+
+static int object_cache_entry_compare(const void* a, const void* b)
+{
+	int64_t left = ((const object_cache_entry*)a)->mtime;
+	int64_t right = ((const object_cache_entry*)b)->mtime;
+	return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static int object_cache_is_entry_name(const char* name)
+{
+	size_t length = strlen(name);
+	return length < 256 && ((length > 2 && strcmp(name + length - 2, ".o") == 0) ||
+	                        (length > 3 && strcmp(name + length - 3, ".bc") == 0));
+}
+
+static int object_cache_entry_push(object_cache_entry** entries, size_t* count,
+	                               size_t* capacity, const char* name, uint64_t size,
+	                               int64_t mtime)
+{
+	if (*count == *capacity)
+	{
+		size_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+		object_cache_entry* resized = realloc(*entries, new_capacity * sizeof(**entries));
+		if (!resized)
+		{
+			return -1;
+		}
+		*entries = resized;
+		*capacity = new_capacity;
+	}
+
+	object_cache_entry* entry = &(*entries)[(*count)++];
+	snprintf(entry->name, sizeof(entry->name), "%s", name);
+	entry->size = size;
+	entry->mtime = mtime;
+	return 0;
+}
+
+// the ADAN_CACHE_MAX_MB cap in bytes, or 0 when pruning is off (0 or invalid input)
+static uint64_t object_cache_limit(void)
+{
+	const char* env = getenv("ADAN_CACHE_MAX_MB");
+	unsigned long long megabytes;
+	char* end = NULL;
+
+	if (!env || env[0] == '\0')
+	{
+		return (uint64_t)OBJECT_CACHE_MAX_MB << 20;
+	}
+
+	errno = 0;
+	megabytes = strtoull(env, &end, 10);
+	if (!isdigit((unsigned char)env[0]) || *end != '\0' || errno == ERANGE ||
+	    megabytes > (UINT64_MAX >> 20))
+	{
+		fprintf(stderr, "linker: ignoring invalid ADAN_CACHE_MAX_MB '%s'; the object "
+		        "cache will not be pruned.\n", env);
+		return 0;
+	}
+
+	return (uint64_t)megabytes << 20;
+}
+
+// entries linked into the current build or written since it started are in use
+static int object_cache_entry_in_use(const char* path, int64_t mtime, int64_t build_start,
+	                                 char** link_items, size_t link_count)
+{
+	if (mtime >= build_start)
+	{
+		return 1;
+	}
+	for (size_t i = 0; i < link_count; ++i)
+	{
+		if (strcmp(link_items[i], path) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// removes the least recently used entries once the cache exceeds its size cap,
+// down to three quarters of the cap so that not every build has to prune. Runs
+// after the final link and never touches entries the build in progress uses.
+static void object_cache_prune(time_t build_start, char** link_items, size_t link_count)
+{
+	const char* dir = object_cache_dir();
+	uint64_t limit = object_cache_limit();
+	uint64_t total = 0;
+	int64_t start = (int64_t)build_start;
+	object_cache_entry* entries = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+
+	if (!dir || limit == 0)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	// FILETIME counts 100ns ticks since 1601
+	start = (start + 11644473600LL) * 10000000LL;
+	char pattern[4096];
+	snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA(pattern, &fd);
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	do
 	{
-		goto cleanup;
+		if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+		    object_cache_is_entry_name(fd.cFileName))
+		{
+			uint64_t size = ((uint64_t)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+			int64_t mtime = (int64_t)(((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32) |
+			                          fd.ftLastWriteTime.dwLowDateTime);
+			if (object_cache_entry_push(&entries, &count, &capacity, fd.cFileName, size,
+			                            mtime) != 0)
+			{
+				break;
+			}
+			total += size;
+		}
+	} while (FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	DIR* d = opendir(dir);
+	if (!d)
+	{
+		return;
 	}
-
-	if (arg_list_append_inferred_include_paths(&argv, native_search_paths_csv) != 0)
+	struct dirent* e;
+	while ((e = readdir(d)) != NULL)
 	{
-		goto cleanup;
+		char path[4096];
+		struct stat st;
+		if (!object_cache_is_entry_name(e->d_name))
+		{
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			continue;
+		}
+		if (object_cache_entry_push(&entries, &count, &capacity, e->d_name,
+		                            (uint64_t)st.st_size, (int64_t)st.st_mtime) != 0)
+		{
+			break;
+		}
+		total += (uint64_t)st.st_size;
 	}
+	closedir(d);
+#endif
 
-	if (arg_list_append(&argv, "-o") != 0 ||
-	    arg_list_append(&argv, output_path) != 0)
+	if (total > limit)
 	{
-		goto cleanup;
+		uint64_t target = limit / 4 * 3;
+		qsort(entries, count, sizeof(*entries), object_cache_entry_compare);
+		for (size_t i = 0; i < count && total > target; ++i)
+		{
+			char path[4096];
+			snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+			if (object_cache_entry_in_use(path, entries[i].mtime, start, link_items,
+			                              link_count))
+			{
+				continue;
+			}
+			// ENOENT: a concurrent build already pruned it
+			if (unlink(path) == 0 || errno == ENOENT)
+			{
+				total -= entries[i].size;
+			}
+		}
 	}
 
-	result = run_cmd(argv.args);
-
-cleanup:
-	arg_list_free(&argv);
-	return result;
+	free(entries);
 }
 
 static int append_string_item(char*** items, size_t* count, const char* value)
@@ -1697,12 +2312,321 @@ static int arg_list_append_native_libraries(arg_list* list, const char* csv,
 	return 0;
 }
 
+// compile jobs are queued while the link items are collected and then run
+// through a bounded process pool; diagnostics are captured per job and
+// replayed in queue order so the report does not depend on scheduling.
+typedef struct
+{
+	char* srcpath;
+	char* output_path;
+	char* cache_path;
+	char* temp_dir;
+	char* temp_files[2];
+	char* log_path;
+	const char* native_search_paths_csv;
+	int status;
+} compile_job;
+
+typedef struct
+{
+	compile_job* jobs;
+	size_t count;
+	size_t capacity;
+	const LinkerConfig* config;
+	int published;
+} compile_queue;
+
+static char* strdup_or_null(const char* value)
+{
+	return value ? strdup(value) : NULL;
+}
+
+static compile_job* compile_queue_push(compile_queue* queue, const char* srcpath,
+	                                   const char* output_path, const char* cache_path,
+	                                   const char* native_search_paths_csv)
+{
+	compile_job* job;
+
+	if (queue->count == queue->capacity)
+	{
+		size_t new_capacity = queue->capacity == 0 ? 8 : queue->capacity * 2;
+		compile_job* resized = realloc(queue->jobs, sizeof(compile_job) * new_capacity);
+		if (!resized)
+		{
+			return NULL;
+		}
+		queue->jobs = resized;
+		queue->capacity = new_capacity;
+	}
+
+	job = &queue->jobs[queue->count];
+	memset(job, 0, sizeof(*job));
+	job->srcpath = strdup(srcpath);
+	job->output_path = strdup(output_path);
+	job->cache_path = strdup_or_null(cache_path);
+	job->native_search_paths_csv = native_search_paths_csv;
+	job->status = -1;
+	if (!job->srcpath || !job->output_path || (cache_path && !job->cache_path))
+	{
+		free(job->srcpath);
+		free(job->output_path);
+		free(job->cache_path);
+		return NULL;
+	}
+
+	queue->count++;
+	return job;
+}
+
+static int resolve_job_count(int requested)
+{
+	if (requested > 0)
+	{
+		return requested;
+	}
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	return online > 0 ? (int)online : 1;
+#endif
+}
+
+#ifndef _WIN32
+static pid_t spawn_cmd(char* const argv[], const char* log_path)
+{
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		fprintf(stderr, "linker: fork() failed\n");
+		return -1;
+	}
+	if (pid == 0)
+	{
+		if (log_path)
+		{
+			int fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+			if (fd != -1)
+			{
+				dup2(fd, STDOUT_FILENO);
+				dup2(fd, STDERR_FILENO);
+				close(fd);
+			}
+		}
+		execvp(argv[0], argv);
+		perror("linker: execvp failed");
+		_exit(127);
+	}
+	return pid;
+}
+#endif
+
+static void replay_job_log(const char* log_path)
+{
+	size_t length = 0;
+	char* log;
+
+	if (!log_path)
+	{
+		return;
+	}
+
+	log = read_file_bytes(log_path, &length);
+	if (log)
+	{
+		fwrite(log, 1, length, stderr);
+		free(log);
+	}
+	unlink(log_path);
+}
+
+static int compile_queue_run(compile_queue* queue, int max_jobs)
+{
+	int failed = 0;
+
+	if (!queue || queue->count == 0)
+	{
+		return 0;
+	}
+
+#ifdef _WIN32
+	(void)max_jobs;
+	for (size_t i = 0; i < queue->count; ++i)
+	{
+		compile_job* job = &queue->jobs[i];
+		arg_list argv = {0};
+		if (build_clang_compile_args(&argv, queue->config, job->srcpath, job->output_path,
+		                             job->temp_dir, job->native_search_paths_csv) == 0)
+		{
+			job->status = run_cmd(argv.args);
+		}
+		arg_list_free(&argv);
+	}
+#else
+	pid_t* pids = calloc(queue->count, sizeof(pid_t));
+	size_t next = 0;
+	size_t running = 0;
+	size_t limit = (size_t)resolve_job_count(max_jobs);
+	int pid = (int)getpid();
+
+	if (!pids)
+	{
+		return -1;
+	}
+
+	while (next < queue->count || running > 0)
+	{
+		while (running < limit && next < queue->count)
+		{
+			compile_job* job = &queue->jobs[next];
+			char log_path[512];
+			arg_list argv = {0};
+
+			snprintf(log_path, sizeof(log_path), "%s/adan_job_%d_%zu.log", get_tmp_dir(),
+			         pid, next);
+			job->log_path = strdup(log_path);
+			if (build_clang_compile_args(&argv, queue->config, job->srcpath,
+			                             job->output_path, job->temp_dir,
+			                             job->native_search_paths_csv) == 0)
+			{
+				pids[next] = spawn_cmd(argv.args, job->log_path);
+				if (pids[next] > 0)
+				{
+					running++;
+				}
+			}
+			arg_list_free(&argv);
+			next++;
+		}
+
+		if (running == 0)
+		{
+			continue;
+		}
+
+		int status;
+		pid_t done = waitpid(-1, &status, 0);
+		if (done == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "linker: waitpid() failed\n");
+			for (size_t i = 0; i < next; ++i)
+			{
+				if (pids[i] > 0)
+				{
+					waitpid(pids[i], &status, 0);
+					pids[i] = 0;
+				}
+			}
+			break;
+		}
+
+		for (size_t i = 0; i < next; ++i)
+		{
+			if (pids[i] == done)
+			{
+				queue->jobs[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+				pids[i] = 0;
+				running--;
+				break;
+			}
+		}
+	}
+
+	free(pids);
+#endif
+
+	for (size_t i = 0; i < queue->count; ++i)
+	{
+		compile_job* job = &queue->jobs[i];
+		replay_job_log(job->log_path);
+		if (job->status != 0)
+		{
+			fprintf(stderr, "linker: failed to compile '%s' (code=%d).\n", job->srcpath,
+			        job->status);
+			failed = 1;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
+
+// publishes successful cache entries and removes materialized sources
+static int compile_queue_finish(compile_queue* queue)
+{
+	int result = 0;
+
+	if (!queue)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < queue->count; ++i)
+	{
+		compile_job* job = &queue->jobs[i];
+
+		if (job->cache_path)
+		{
+			if (job->status == 0)
+			{
+				if (object_cache_publish(job->output_path, job->cache_path) != 0)
+				{
+					result = -1;
+				}
+				else
+				{
+					queue->published = 1;
+				}
+			}
+			else
+			{
+				unlink(job->output_path);
+			}
+		}
+
+		for (size_t j = 0; j < 2; ++j)
+		{
+			if (job->temp_files[j])
+			{
+				unlink(job->temp_files[j]);
+				free(job->temp_files[j]);
+			}
+		}
+		if (job->temp_dir)
+		{
+			rmdir(job->temp_dir);
+			free(job->temp_dir);
+		}
+		if (job->log_path)
+		{
+			unlink(job->log_path);
+			free(job->log_path);
+		}
+		free(job->srcpath);
+		free(job->output_path);
+		free(job->cache_path);
+	}
+
+	free(queue->jobs);
+	queue->jobs = NULL;
+	queue->count = 0;
+	queue->capacity = 0;
+	return result;
+}
+
 typedef struct
 {
 	char*** link_items;
 	size_t* link_count;
 	char*** temp_objs;
 	size_t* temp_count;
+	compile_queue* queue;
 	int* tmpid;
 	int pid;
 	int error;
@@ -1713,32 +2637,52 @@ static void compile_c_file(const char* srcpath, void* vctx)
 	bundle_ctx* ctx = (bundle_ctx*)vctx;
 	if (ctx->error)
 		return;
-	char tmpobj[4096];
-	snprintf(tmpobj, sizeof(tmpobj), "%s/adan_bundle_%d_%d.o", get_tmp_dir(), ctx->pid,
-	         (*ctx->tmpid)++);
-	int r = run_clang_compile(srcpath, tmpobj, NULL, NULL, NULL);
-	if (r != 0)
+	char cached[4096];
+	char staging[4096];
+	uint64_t key;
+	const char* extension = compiled_module_extension(ctx->queue->config);
+	int lookup = object_cache_key_for_file(srcpath, ctx->queue->config, NULL, &key) == 0
+	                 ? object_cache_lookup(key, extension, cached, sizeof(cached))
+	                 : -1;
+	if (lookup == 1)
+	{
+		if (append_string_item(ctx->link_items, ctx->link_count, cached) != 0)
+		{
+			ctx->error = 1;
+		}
+		return;
+	}
+	if (lookup == 0)
 	{
-		ctx->error = 1;
+		if (object_cache_staging_path(cached, staging, sizeof(staging)) != 0 ||
+		    !compile_queue_push(ctx->queue, srcpath, staging, cached, NULL) ||
+		    append_string_item(ctx->link_items, ctx->link_count, cached) != 0)
+		{
+			ctx->error = 1;
+		}
 		return;
 	}
-	if (append_string_item(ctx->link_items, ctx->link_count, tmpobj) != 0 ||
+	char tmpobj[4096];
+	snprintf(tmpobj, sizeof(tmpobj), "%s/adan_bundle_%d_%d%s", get_tmp_dir(), ctx->pid,
+	         (*ctx->tmpid)++, extension);
+	if (!compile_queue_push(ctx->queue, srcpath, tmpobj, NULL, NULL) ||
+	    append_string_item(ctx->link_items, ctx->link_count, tmpobj) != 0 ||
 	    append_string_item(ctx->temp_objs, ctx->temp_count, tmpobj) != 0)
 	{
 		ctx->error = 1;
 	}
 }
 
-static int collect_bundle_link_items(const char* bundle_csv, char*** link_items,
-	                                 size_t* link_count, char*** temp_objs,
-	                                 size_t* temp_count)
+static int collect_bundle_link_items(const char* bundle_csv, compile_queue* queue,
+	                                 char*** link_items, size_t* link_count,
+	                                 char*** temp_objs, size_t* temp_count)
 {
 	char* dup;
 	char* saveptr = NULL;
 	char* tok;
 	int pid = (int)getpid();
 	int tmpid = 0;
-	bundle_ctx ctx = {link_items, link_count, temp_objs, temp_count, &tmpid, pid, 0};
+	bundle_ctx ctx = {link_items, link_count, temp_objs, temp_count, queue, &tmpid, pid, 0};
 
 	if (!bundle_csv || bundle_csv[0] == '\0')
 	{
@@ -1804,8 +2748,8 @@ static int collect_bundle_link_items(const char* bundle_csv, char*** link_items,
 }
 
 static int collect_embedded_link_items(const char* modules_csv,
-	                                   const char* native_libraries_csv,
 	                                   const char* native_search_paths_csv,
+	                                   compile_queue* queue,
 	                                   char*** link_items,
 	                                   size_t* link_count,
 	                                   char*** temp_objs,
@@ -1816,6 +2760,7 @@ static int collect_embedded_link_items(const char* modules_csv,
 	char* tok;
 	int pid = (int)getpid();
 	int tmpid = 0;
+	const char* extension = compiled_module_extension(queue->config);
 
 	if (!modules_csv || modules_csv[0] == '\0')
 	{
@@ -1838,6 +2783,11 @@ static int collect_embedded_link_items(const char* modules_csv,
 		char tmp_dir[256];
 		char tmp_c[300];
 		char tmp_obj[256];
+		char cached[4096];
+		char staging[4096];
+		uint64_t key;
+		int lookup;
+		compile_job* job;
 		FILE* f;
 
 		if (!module[0])
@@ -1855,11 +2805,33 @@ static int collect_embedded_link_items(const char* modules_csv,
 			return -1;
 		}
 
+		h_filename = embedded_lib_get_h_filename(module);
+		h_src = embedded_lib_get_h_source(module);
+		lookup = object_cache_key_for_embedded(c_src, h_filename, h_src, queue->config,
+		                                      native_search_paths_csv, &key) == 0
+		             ? object_cache_lookup(key, extension, cached, sizeof(cached))
+		             : -1;
+		if (lookup == 1)
+		{
+			if (append_string_item(link_items, link_count, cached) != 0)
+			{
+				free(dup);
+				return -1;
+			}
+			tok = strtok_r(NULL, ",", &saveptr);
+			continue;
+		}
+
 		snprintf(tmp_dir, sizeof(tmp_dir), "%s/adan_emb_%d_%d", get_tmp_dir(), pid,
 		         tmpid);
 		snprintf(tmp_c, sizeof(tmp_c), "%s/source.c", tmp_dir);
-		snprintf(tmp_obj, sizeof(tmp_obj), "%s/adan_emb_%d_%d.o", get_tmp_dir(), pid,
-		         tmpid++);
+		snprintf(tmp_obj, sizeof(tmp_obj), "%s/adan_emb_%d_%d%s", get_tmp_dir(), pid,
+		         tmpid++, extension);
+		if (lookup == 0 && object_cache_staging_path(cached, staging, sizeof(staging)) != 0)
+		{
+			free(dup);
+			return -1;
+		}
 
 		if (mkdir(tmp_dir, 0700) != 0)
 		{
@@ -1868,20 +2840,28 @@ static int collect_embedded_link_items(const char* modules_csv,
 			return -1;
 		}
 
+		job = compile_queue_push(queue, tmp_c, lookup == 0 ? staging : tmp_obj,
+		                         lookup == 0 ? cached : NULL, native_search_paths_csv);
+		if (!job)
+		{
+			rmdir(tmp_dir);
+			free(dup);
+			return -1;
+		}
+		job->temp_dir = strdup(tmp_dir);
+
 		f = fopen(tmp_c, "w");
 		if (!f)
 		{
 			fprintf(stderr, "linker: failed to write embedded source for '%s'.\n",
 			        module);
-			rmdir(tmp_dir);
 			free(dup);
 			return -1;
 		}
 		fputs(c_src, f);
 		fclose(f);
+		job->temp_files[0] = strdup(tmp_c);
 
-		h_filename = embedded_lib_get_h_filename(module);
-		h_src = embedded_lib_get_h_source(module);
 		if (h_filename && h_src)
 		{
 			char tmp_h[512];
@@ -1891,33 +2871,21 @@ static int collect_embedded_link_items(const char* modules_csv,
 			{
 				fputs(h_src, fh);
 				fclose(fh);
+				job->temp_files[1] = strdup(tmp_h);
 			}
 		}
 
+		if (lookup == 0)
 		{
-			int r = run_clang_compile(tmp_c, tmp_obj, tmp_dir,
-			                        native_libraries_csv,
-			                        native_search_paths_csv);
-			unlink(tmp_c);
-			if (h_filename && h_src)
-			{
-				char tmp_h[512];
-				snprintf(tmp_h, sizeof(tmp_h), "%s/%s", tmp_dir, h_filename);
-				unlink(tmp_h);
-			}
-			rmdir(tmp_dir);
-			if (r != 0)
+			if (append_string_item(link_items, link_count, cached) != 0)
 			{
-				unlink(tmp_obj);
 				free(dup);
 				return -1;
 			}
 		}
-
-		if (append_string_item(link_items, link_count, tmp_obj) != 0 ||
-		    append_string_item(temp_objs, temp_count, tmp_obj) != 0)
+		else if (append_string_item(link_items, link_count, tmp_obj) != 0 ||
+		         append_string_item(temp_objs, temp_count, tmp_obj) != 0)
 		{
-			unlink(tmp_obj);
 			free(dup);
 			return -1;
 		}
@@ -1936,7 +2904,12 @@ int linker_link(const char* input_ll_path, const char* output_path,
 	size_t link_count = 0;
 	char** temp_objs = NULL;
 	size_t temp_count = 0;
+	compile_queue queue = {0};
 	arg_list argv = {0};
+	const char* module_path = input_ll_path;
+	const char* opt_level = linker_opt_level(config);
+	int lto = config && config->lto;
+	time_t build_start = time(NULL);
 	int result = -1;
 
 	if (!input_ll_path || !output_path)
@@ -1944,31 +2917,80 @@ int linker_link(const char* input_ll_path, const char* output_path,
 		return -1;
 	}
 
+	queue.config = config;
 	if (config)
 	{
-		if (collect_bundle_link_items(config->bundle_csv, &link_items, &link_count,
-		                             &temp_objs, &temp_count) != 0)
+		if (collect_bundle_link_items(config->bundle_csv, &queue, &link_items,
+		                             &link_count, &temp_objs, &temp_count) != 0)
 		{
 			goto cleanup;
 		}
 		if (collect_embedded_link_items(config->embedded_modules_csv,
-		                               config->native_libraries_csv,
-		                               config->native_search_paths_csv,
+		                               config->native_search_paths_csv, &queue,
 		                               &link_items, &link_count,
 		                               &temp_objs, &temp_count) != 0)
 		{
 			goto cleanup;
 		}
+		int compiled = compile_queue_run(&queue, config->jobs);
+		if (compile_queue_finish(&queue) != 0 || compiled != 0)
+		{
+			goto cleanup;
+		}
+	}
+
+	if (lto)
+	{
+		// merge the user module with the bitcode runtime so the final clang
+		// run can inline runtime helpers into ADAN code
+		char lto_module[512];
+		const char** inputs = malloc(sizeof(char*) * (link_count + 1));
+		size_t ninputs = 0;
+		int linked;
+
+		if (!inputs)
+		{
+			goto cleanup;
+		}
+		inputs[ninputs++] = input_ll_path;
+		for (size_t i = 0; i < link_count; ++i)
+		{
+			if (ends_with(link_items[i], ".bc"))
+			{
+				inputs[ninputs++] = link_items[i];
+			}
+		}
+
+		snprintf(lto_module, sizeof(lto_module), "%s/adan_lto_%d.bc", get_tmp_dir(),
+		         (int)getpid());
+		linked = linker_llvm_link_bitcode(inputs, ninputs, lto_module);
+		free(inputs);
+		if (append_string_item(&temp_objs, &temp_count, lto_module) != 0)
+		{
+			unlink(lto_module);
+			goto cleanup;
+		}
+		if (linked != 0)
+		{
+			fprintf(stderr, "linker: llvm-link failed to merge the LTO module.\n");
+			goto cleanup;
+		}
+		module_path = lto_module;
 	}
 
 	if (arg_list_append(&argv, "clang") != 0 ||
-	    arg_list_append(&argv, input_ll_path) != 0)
+	    (opt_level && arg_list_append(&argv, opt_level) != 0) ||
+	    arg_list_append(&argv, module_path) != 0)
 	{
 		goto cleanup;
 	}
 
 	for (size_t i = 0; i < link_count; ++i)
 	{
+		if (lto && ends_with(link_items[i], ".bc"))
+		{
+			continue;
+		}
 		if (arg_list_append(&argv, link_items[i]) != 0)
 		{
 			goto cleanup;
@@ -2005,8 +3027,13 @@ int linker_link(const char* input_ll_path, const char* output_path,
 	}
 
 	result = run_cmd(argv.args);
+	if (queue.published)
+	{
+		object_cache_prune(build_start, link_items, link_count);
+	}
 
 cleanup:
+	compile_queue_finish(&queue);
 	cleanup_temp_objects(temp_objs, temp_count);
 	free_string_items(link_items, link_count);
 	arg_list_free(&argv);
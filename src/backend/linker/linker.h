@@ -10,6 +10,9 @@ typedef struct LinkerConfig
     const char* embedded_modules_csv;
     const char* native_libraries_csv;
     const char* native_search_paths_csv;
+    int jobs; /* parallel clang compiles; 0 uses the number of online CPUs */
+    const char* opt_level; /* "-O0".."-O3"/"-Os"; NULL: clang's default, -O2 with lto */
+    int lto; /* link runtime/embedded modules as bitcode into the user module */
 } LinkerConfig;
 
 int linker_link(const char* input_ll_path, const char* output_path,
@@ -23,4 +26,8 @@ int linker_link_and_bundle(const char* input_ll_path, const char* output_path, c
 int linker_link_and_bundle_embedded(const char* input_ll_path, const char* output_path,
                                     const char* libs, const char* modules_csv);
 
+int linker_emit_bitcode_from_ll(const char* ll_path, const char* bc_path);
+
+int linker_llvm_link_bitcode(const char** inputs, size_t ninputs, const char* out_bc_path);
+
 #endif
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,6 +6,7 @@
 
 #include "llvm_emitter.h"
 #include "../../macros.h"
+#include "../runtime/runtime.h"
 
 static char* es_get_val_name(EmitterState* s, IRValue* v)
 {
@@ -49,9 +51,18 @@ static void es_emit_value_rep(EmitterState* s, FILE* outf, IRValue* v)
 	}
 	if (v->kind == IRV_CONST)
 	{
-		if (v->type && (v->type->kind == IR_T_F64 || v->type->kind == IR_T_F32))
+		if (v->type && v->type->kind == IR_T_PTR && v->u.i64 == 0)
 		{
-			fprintf(outf, "%f", v->u.f64);
+			fprintf(outf, "null");
+		}
+		else if (v->type && (v->type->kind == IR_T_F64 || v->type->kind == IR_T_F32))
+		{
+			// LLVM's hex form is exact; "%f" would round folded constants and is
+			// rejected for floats that are not exactly representable.
+			double d = v->type->kind == IR_T_F32 ? (double)(float)v->u.f64 : v->u.f64;
+			uint64_t bits;
+			memcpy(&bits, &d, sizeof(bits));
+			fprintf(outf, "0x%016llX", (unsigned long long)bits);
 		}
 		else if (v->type && v->type->kind == IR_T_I64)
 		{
@@ -258,6 +269,44 @@ void llvm_emitter_destroy(LLVMEEmitter* e)
 	free(e);
 }
 
+static int llvm_global_is_string_literal(const IRGlobal* g)
+{
+	return g->name && g->value && g->value->type && g->value->type->kind == IR_T_PTR &&
+	       g->value->u.i64;
+}
+
+// The runtime only treats pointers it knows about as its own values, so a constructor
+// hands it the address of every literal before main runs.
+static void llvm_emit_literal_registration(IRModule* m, FILE* out)
+{
+	size_t count = 0;
+	for (IRGlobal* g = m->globals; g; g = g->next)
+	{
+		count += llvm_global_is_string_literal(g) ? 1 : 0;
+	}
+	if (count == 0)
+	{
+		return;
+	}
+
+	fprintf(out, "@adn.literals = private constant [%zu x ptr] [", count);
+	size_t emitted = 0;
+	for (IRGlobal* g = m->globals; g; g = g->next)
+	{
+		if (llvm_global_is_string_literal(g))
+		{
+			fprintf(out, "%sptr @%s", emitted++ ? ", " : "", g->name);
+		}
+	}
+	fprintf(out, "]\n");
+	fprintf(out, "@llvm.global_ctors = appending global [1 x { i32, ptr, ptr }] "
+	             "[{ i32, ptr, ptr } { i32 65535, ptr @adn.register_literals, ptr null }]\n");
+	fprintf(out, "declare void @adn_register_literals(ptr, i64)\n");
+	fprintf(out, "define private void @adn.register_literals() {\n");
+	fprintf(out, "  call void @adn_register_literals(ptr @adn.literals, i64 %zu)\n", count);
+	fprintf(out, "  ret void\n}\n");
+}
+
 int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 {
 	if (!e || !m || !out)
@@ -280,9 +329,14 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 			const char* s = (const char*)(intptr_t)gv->u.i64;
 			if (s)
 			{
+				// Literals carry the same header as runtime strings (see runtime.h), with
+				// the hash precomputed; the global itself points at the bytes.
 				size_t len = strlen(s);
-				fprintf(out, "@%s = private constant [%zu x i8] c\"", g->name,
-				        len + 1);
+				fprintf(out,
+				        "@%s.data = private constant { i64, i64, i32, i32, [%zu x i8] } "
+				        "{ i64 %lld, i64 %zu, i32 %u, i32 %u, [%zu x i8] c\"",
+				        g->name, len + 1, (long long)adn_hash_key(s), len, ADN_REFCOUNT_STATIC,
+				        ADN_STRING_MAGIC, len + 1);
 				for (size_t i = 0; i < len; ++i)
 				{
 					unsigned char c = (unsigned char)s[i];
@@ -303,7 +357,11 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 						fprintf(out, "\\%02X", c);
 					}
 				}
-				fprintf(out, "\\00\"\n");
+				fprintf(out, "\\00\" }, align 16\n");
+				fprintf(out,
+				        "@%s = private alias i8, ptr getelementptr inbounds (i8, ptr @%s.data, "
+				        "i64 %d)\n",
+				        g->name, g->name, ADN_STRING_HEADER_SIZE);
 			}
 		}
 		else
@@ -344,6 +402,8 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 		}
 	}
 
+	llvm_emit_literal_registration(m, out);
+
 	fprintf(out, "declare i64 @adn_powi(i64, i64)\n");
 	fprintf(out, "declare double @llvm.pow.f64(double, double)\n\n");
 
@@ -493,16 +553,29 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 							skip = 1;
 						break;
 					case IR_PHI:
-						if (!ins->dest || !ins->dest->type ||
-						    !IS_DEFINED(ins->operands[0]))
+						if (!ins->dest || !ins->dest->type || !ins->call_nargs ||
+						    !ins->phi_blocks)
 							skip = 1;
+						for (size_t pi = 0; !skip && pi < ins->call_nargs; ++pi)
+						{
+							if (!IS_DEFINED(ins->call_args[pi]) ||
+							    !ins->phi_blocks[pi])
+								skip = 1;
+						}
 						break;
 					case IR_FPCVT:
 					case IR_ITOFP:
+					case IR_ICAST:
 						if (!ins->dest || !ins->dest->type ||
 						    !IS_DEFINED(ins->operands[0]))
 							skip = 1;
 						break;
+					case IR_GEP:
+						if (!ins->dest || !ins->dest->type ||
+						    !IS_DEFINED(ins->operands[0]) ||
+						    (ins->operands[2] && !IS_DEFINED(ins->operands[2])))
+							skip = 1;
+						break;
 					default:
 						skip = 1;
 						break;
@@ -662,6 +735,20 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 								free(rt);
 							}
 						}
+						else if (f->return_type &&
+						         (f->return_type->kind == IR_T_I1 ||
+						          f->return_type->kind == IR_T_BOOL) &&
+						         v->type && v->type->kind == IR_T_I64 &&
+						         v->kind != IRV_CONST)
+						{
+							// Comparisons produce i64; narrow them like IR_CBR does.
+							fprintf(out, "  %%ret_cond_%lu = icmp ne i64 ",
+							        st.tmp_counter++);
+							es_emit_value_rep(&st, out, v);
+							fprintf(out, ", 0\n");
+							fprintf(out, "  ret i1 %%ret_cond_%lu\n",
+							        st.tmp_counter - 1);
+						}
 						else
 						{
 							char* t = llvm_type_to_string(
@@ -930,16 +1017,16 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 						char* t = llvm_type_to_string(ins->dest->type
 						                                  ? ins->dest->type
 						                                  : ir_type_i64());
-						fprintf(out, "  %s = phi %s [", d ? d : "<dst>",
+						fprintf(out, "  %s = phi %s ", d ? d : "<dst>",
 						        t ? t : "i64");
-						es_emit_value_rep(&st, out, ins->operands[0]);
-						fprintf(out, "]");
-						if (ins->operands[1])
+						for (size_t pi = 0; pi < ins->call_nargs; ++pi)
 						{
-							fprintf(out, ", [");
-							es_emit_value_rep(&st, out,
-							                  ins->operands[1]);
-							fprintf(out, "]");
+							fprintf(out, "%s[", pi ? ", " : "");
+							es_emit_value_rep(&st, out, ins->call_args[pi]);
+							fprintf(out, ", %%%s]",
+							        ins->phi_blocks[pi]->name
+							            ? ins->phi_blocks[pi]->name
+							            : "entry");
 						}
 						fprintf(out, "\n");
 						free(t);
@@ -979,6 +1066,59 @@ int llvm_emitter_emit_module(LLVMEEmitter* e, IRModule* m, FILE* out)
 						free(dtype);
 						break;
 					}
+					case IR_ICAST:
+					{
+						char* dname = es_get_val_name(&st, ins->dest);
+						IRType* src = ins->operands[0]->type;
+						char* stype = llvm_type_to_string(src);
+						char* dtype = llvm_type_to_string(ins->dest->type);
+						const char* op = "sext";
+						if (ins->dest->type->width < src->width)
+							op = "trunc";
+						else if (src->kind == IR_T_I1 || src->kind == IR_T_BOOL ||
+						         src->kind == IR_T_U8 || src->kind == IR_T_U16 ||
+						         src->kind == IR_T_U32)
+							op = "zext";
+						fprintf(out, "  %s = %s %s ",
+						        dname ? dname : "<dst>", op,
+						        stype ? stype : "i64");
+						es_emit_value_rep(&st, out, ins->operands[0]);
+						fprintf(out, " to %s\n", dtype ? dtype : "i64");
+						free(stype);
+						free(dtype);
+						break;
+					}
+					case IR_GEP:
+					{
+						char* dname = es_get_val_name(&st, ins->dest);
+						char* btype =
+						    llvm_type_to_string(ins->operands[0]->type);
+						if (ins->operands[2])
+						{
+							// Element-indexed form from ir_emit_gep_index.
+							char* etype =
+							    llvm_type_to_string(ins->dest->type->pointee);
+							fprintf(out,
+							        "  %s = getelementptr inbounds %s, %s ",
+							        dname ? dname : "<dst>", etype ? etype : "i8",
+							        btype ? btype : "i8*");
+							es_emit_value_rep(&st, out, ins->operands[0]);
+							fprintf(out, ", i64 ");
+							es_emit_value_rep(&st, out, ins->operands[2]);
+							fprintf(out, "\n");
+							free(etype);
+							free(btype);
+							break;
+						}
+						fprintf(out,
+						        "  %s = getelementptr inbounds i8, %s ",
+						        dname ? dname : "<dst>", btype ? btype : "i8*");
+						es_emit_value_rep(&st, out, ins->operands[0]);
+						fprintf(out, ", i64 %lld\n",
+						        (long long)ins->operands[1]->u.i64);
+						free(btype);
+						break;
+					}
 					default:
 						break;
 				}
@@ -4,6 +4,7 @@
 
 #include "lower.h"
 #include "ir/ir.h"
+#include "runtime/runtime.h"
 
 static IRFunction* current_function = NULL;
 
@@ -11,12 +12,61 @@ static IRType* lower_type(Program* program, ASTNode* node);
 
 static IRBlock* current_block = NULL;
 
-static IRBlock* loop_break_targets[128];
+// The enclosing loops, innermost last. `arc_local_mark` is arc_local_count when the
+// loop body began, so break and continue release the locals declared inside it.
+typedef struct
+{
+	IRBlock* break_target;
+	IRBlock* continue_target;
+	size_t arc_local_mark;
+} LoopTarget;
 
-static IRBlock* loop_continue_targets[128];
+static LoopTarget* loop_targets = NULL;
 
 static size_t loop_target_depth = 0;
 
+static size_t loop_target_capacity = 0;
+
+// Reference counting. Pointer values produced by calls, literals and collection reads are
+// owned (+1) temporaries, released when the statement that made them ends unless a
+// variable takes them over. Pointer-typed locals own their value and release it when
+// their block exits; parameters are borrowed from the caller.
+static IRValue** arc_temps = NULL;
+
+static size_t arc_temp_count = 0;
+
+static size_t arc_temp_capacity = 0;
+
+static IRValue** arc_locals = NULL;
+
+static size_t arc_local_count = 0;
+
+static size_t arc_local_capacity = 0;
+
+// A string variable that a loop appends to (`s += e`, which the parser turns into
+// `s = s + e`) lives in a string builder while the loop runs, so an append copies only
+// the new bytes. Reads inside the loop take a copy of the contents, other assignments
+// refill the builder, and the variable receives the finished string when the loop exits.
+typedef struct
+{
+	const char* name;
+	IRValue* slot;
+	IRValue* builder;
+} LoopStringBuilder;
+
+static LoopStringBuilder loop_string_builders[64];
+
+static size_t loop_string_builder_count = 0;
+
+typedef struct
+{
+	const char* appended[32];
+	size_t appended_count;
+	const char* declared[64];
+	size_t declared_count;
+	bool opaque;
+} LoopStringScan;
+
 static SymEntry* sym_table = NULL;
 
 typedef struct ReachableFunctionName
@@ -157,9 +207,394 @@ static IRValue* coerce_value_to_type(IRValue* value, IRType* target_type)
 		return ir_emit_fpcvt(current_block, value, target_type);
 	}
 
+	if (current_block && ir_type_is_integer_like(value->type) &&
+	    ir_type_is_integer_like(target_type) &&
+	    value->type->width != target_type->width)
+	{
+		return ir_emit_icast(current_block, value, target_type);
+	}
+
+	return value;
+}
+
+static bool ir_value_is_pointer(IRValue* value)
+{
+	return value && value->type && value->type->kind == IR_T_PTR;
+}
+
+// Makes room for `needed` items of `size` bytes in a growable lowering table. Running
+// out of memory here would silently drop references, so it ends the compilation.
+static void* lower_table_reserve(void* items, size_t* capacity, size_t needed, size_t size)
+{
+	if (needed <= *capacity)
+	{
+		return items;
+	}
+	size_t next_capacity = *capacity == 0 ? 64 : *capacity * 2;
+	while (next_capacity < needed)
+	{
+		next_capacity *= 2;
+	}
+	void* resized = realloc(items, next_capacity * size);
+	if (!resized)
+	{
+		fprintf(stderr, "Out of memory while lowering. (Error)\n");
+		exit(1);
+	}
+	*capacity = next_capacity;
+	return resized;
+}
+
+static void loop_target_push(IRBlock* break_target, IRBlock* continue_target)
+{
+	loop_targets = lower_table_reserve(loop_targets, &loop_target_capacity,
+	                                   loop_target_depth + 1, sizeof(LoopTarget));
+	loop_targets[loop_target_depth].break_target = break_target;
+	loop_targets[loop_target_depth].continue_target = continue_target;
+	loop_targets[loop_target_depth].arc_local_mark = arc_local_count;
+	loop_target_depth++;
+}
+
+static void arc_track_temp(IRValue* value)
+{
+	if (!ir_value_is_pointer(value) || value->kind != IRV_TEMP)
+	{
+		return;
+	}
+	for (size_t i = 0; i < arc_temp_count; i++)
+	{
+		if (arc_temps[i] == value)
+		{
+			return;
+		}
+	}
+	arc_temps = lower_table_reserve(arc_temps, &arc_temp_capacity, arc_temp_count + 1,
+	                                sizeof(IRValue*));
+	arc_temps[arc_temp_count++] = value;
+}
+
+static bool arc_take_temp(IRValue* value)
+{
+	for (size_t i = arc_temp_count; i > 0; i--)
+	{
+		if (arc_temps[i - 1] == value)
+		{
+			memmove(&arc_temps[i - 1], &arc_temps[i],
+			        (arc_temp_count - i) * sizeof(arc_temps[0]));
+			arc_temp_count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void arc_emit_release(Program* program, IRValue* value)
+{
+	IRValue* args[1] = {value};
+	ir_emit_call(current_block, ensure_runtime_function(program, "adn_release"), args, 1);
+}
+
+// Gives the caller a reference of its own to `value`: a temporary is handed over as is,
+// anything else (a variable, a parameter) is retained. Literals need neither.
+static IRValue* arc_own(Program* program, IRValue* value)
+{
+	if (!ir_value_is_pointer(value) || arc_take_temp(value) || value->kind == IRV_CONST ||
+	    value->kind == IRV_GLOBAL)
+	{
+		return value;
+	}
+	IRValue* args[1] = {value};
+	ir_emit_call(current_block, ensure_runtime_function(program, "adn_retain"), args, 1);
 	return value;
 }
 
+static void arc_release_temps(Program* program, size_t mark)
+{
+	if (current_block && !block_is_terminated(current_block))
+	{
+		for (size_t i = arc_temp_count; i > mark; i--)
+		{
+			arc_emit_release(program, arc_temps[i - 1]);
+		}
+	}
+	if (arc_temp_count > mark)
+	{
+		arc_temp_count = mark;
+	}
+}
+
+static void arc_release_locals(Program* program, size_t mark)
+{
+	if (!current_block || block_is_terminated(current_block))
+	{
+		return;
+	}
+	for (size_t i = arc_local_count; i > mark; i--)
+	{
+		arc_emit_release(program, ir_emit_load(current_block, arc_locals[i - 1]));
+	}
+}
+
+static void arc_track_local(IRValue* slot)
+{
+	arc_locals = lower_table_reserve(arc_locals, &arc_local_capacity, arc_local_count + 1,
+	                                 sizeof(IRValue*));
+	arc_locals[arc_local_count++] = slot;
+}
+
+// Stores `value` into the pointer-typed variable at `slot`, releasing what it held.
+static void arc_assign(Program* program, IRValue* slot, IRValue* value)
+{
+	arc_own(program, value);
+	IRValue* previous = ir_emit_load(current_block, slot);
+	ir_emit_store(current_block, slot, value);
+	arc_emit_release(program, previous);
+}
+
+static bool is_string_append_to(ASTNode* value, const char* name)
+{
+	return value && value->type == AST_BINARY_OP && strcmp(value->binary_op.op, "+") == 0 &&
+	       value->binary_op.left && value->binary_op.left->type == AST_IDENTIFIER &&
+	       strcmp(value->binary_op.left->identifier.name, name) == 0;
+}
+
+static bool loop_scan_contains(const char** names, size_t count, const char* name)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (strcmp(names[i], name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static void loop_scan_note(LoopStringScan* scan, const char** names, size_t* count,
+                           size_t capacity, const char* name)
+{
+	if (!name || loop_scan_contains(names, *count, name))
+	{
+		return;
+	}
+	if (*count >= capacity)
+	{
+		scan->opaque = true;
+		return;
+	}
+	names[(*count)++] = name;
+}
+
+// Collects the variables `node` appends to and the ones it declares. Anything the scan
+// does not understand marks the loop opaque, which keeps it on plain concatenation.
+static void scan_loop_strings(ASTNode* node, LoopStringScan* scan)
+{
+	if (!node || scan->opaque)
+	{
+		return;
+	}
+
+	switch (node->type)
+	{
+		case AST_VARIABLE_DECLARATION:
+			loop_scan_note(scan, scan->declared, &scan->declared_count,
+			               sizeof(scan->declared) / sizeof(scan->declared[0]),
+			               node->var_decl.name);
+			scan_loop_strings(node->var_decl.initializer, scan);
+			break;
+		case AST_ASSIGNMENT:
+			if (node->assignment.name &&
+			    is_string_append_to(node->assignment.value, node->assignment.name))
+			{
+				loop_scan_note(scan, scan->appended, &scan->appended_count,
+				               sizeof(scan->appended) / sizeof(scan->appended[0]),
+				               node->assignment.name);
+			}
+			scan_loop_strings(node->assignment.value, scan);
+			break;
+		case AST_IF_STATEMENT:
+			scan_loop_strings(node->if_stmt.condition, scan);
+			scan_loop_strings(node->if_stmt.then_branch, scan);
+			scan_loop_strings(node->if_stmt.else_branch, scan);
+			break;
+		case AST_BLOCK:
+			for (size_t i = 0; i < node->block.count; i++)
+			{
+				scan_loop_strings(node->block.statements[i], scan);
+			}
+			break;
+		case AST_CALL:
+			for (size_t i = 0; i < node->call.arg_count; i++)
+			{
+				scan_loop_strings(node->call.args[i], scan);
+			}
+			break;
+		case AST_RETURN_STATEMENT:
+			scan_loop_strings(node->ret.expr, scan);
+			break;
+		case AST_EXPRESSION_STATEMENT:
+			scan_loop_strings(node->expr_stmt.expr, scan);
+			break;
+		case AST_WHILE_STMT:
+			scan_loop_strings(node->while_stmt.condition, scan);
+			scan_loop_strings(node->while_stmt.body, scan);
+			break;
+		case AST_FOR_STMT:
+			scan_loop_strings(node->for_stmt.var_decl, scan);
+			scan_loop_strings(node->for_stmt.condition, scan);
+			scan_loop_strings(node->for_stmt.increment, scan);
+			scan_loop_strings(node->for_stmt.body, scan);
+			break;
+		case AST_BINARY_OP:
+			scan_loop_strings(node->binary_op.left, scan);
+			scan_loop_strings(node->binary_op.right, scan);
+			break;
+		case AST_CAST:
+			scan_loop_strings(node->cast.expr, scan);
+			break;
+		case AST_OBJECT_LITERAL:
+			for (size_t i = 0; i < node->object_literal.count; i++)
+			{
+				scan_loop_strings(node->object_literal.properties[i].value, scan);
+			}
+			break;
+		case AST_ARRAY_LITERAL:
+			for (size_t i = 0; i < node->array_literal.count; i++)
+			{
+				scan_loop_strings(node->array_literal.elements[i], scan);
+			}
+			break;
+		case AST_MEMBER_ACCESS:
+			scan_loop_strings(node->member_access.object, scan);
+			break;
+		case AST_ARRAY_ACCESS:
+			scan_loop_strings(node->array_access.array, scan);
+			scan_loop_strings(node->array_access.index, scan);
+			break;
+		case AST_IDENTIFIER:
+		case AST_STRING_LITERAL:
+		case AST_NUMBER_LITERAL:
+		case AST_BOOLEAN_LITERAL:
+		case AST_TYPE:
+		case AST_BREAK_STATEMENT:
+		case AST_CONTINUE_STATEMENT:
+			break;
+		default:
+			scan->opaque = true;
+			break;
+	}
+}
+
+static LoopStringBuilder* find_loop_string_builder(const char* name)
+{
+	for (size_t i = loop_string_builder_count; name && i > 0; i--)
+	{
+		if (strcmp(loop_string_builders[i - 1].name, name) == 0)
+		{
+			return &loop_string_builders[i - 1];
+		}
+	}
+	return NULL;
+}
+
+// Moves every string local that `loop` appends to into a builder. Returns the mark to
+// pass to end_loop_string_builders once the loop has been lowered.
+static size_t begin_loop_string_builders(Program* program, ASTNode* loop)
+{
+	size_t mark = loop_string_builder_count;
+	LoopStringScan scan = {0};
+	scan_loop_strings(loop, &scan);
+	if (scan.opaque || !current_block || !current_function || !current_function->blocks)
+	{
+		return mark;
+	}
+
+	for (size_t i = 0; i < scan.appended_count; i++)
+	{
+		const char* name = scan.appended[i];
+		SymEntry* entry = sym_get(name);
+		if (!entry || !entry->is_address || !entry->value ||
+		    entry->value->kind == IRV_GLOBAL || !entry->type_name ||
+		    strcmp(entry->type_name, "string") != 0 || find_loop_string_builder(name) ||
+		    loop_scan_contains(scan.declared, scan.declared_count, name) ||
+		    loop_string_builder_count >=
+		        sizeof(loop_string_builders) / sizeof(loop_string_builders[0]))
+		{
+			continue;
+		}
+
+		IRValue* builder = ir_emit_call(
+		    current_block, ensure_runtime_function(program, "adn_string_builder_create"), NULL,
+		    0);
+		IRValue* args[2] = {builder, ir_emit_load(current_block, entry->value)};
+		ir_emit_call(current_block, ensure_runtime_function(program, "adn_string_builder_append"),
+		             args, 2);
+		IRValue* slot = ir_emit_alloca(current_function->blocks, ir_type_ptr(ir_type_i64()));
+		ir_emit_store(current_block, slot, builder);
+		arc_track_local(slot);
+		loop_string_builders[loop_string_builder_count++] =
+		    (LoopStringBuilder){name, entry->value, slot};
+	}
+	return mark;
+}
+
+// Hands each builder's contents back to its variable and drops the builder. The slot is
+// cleared so the enclosing scope's release, or a later run of the loop, finds nothing.
+static void end_loop_string_builders(Program* program, size_t mark)
+{
+	while (loop_string_builder_count > mark)
+	{
+		LoopStringBuilder* sb = &loop_string_builders[--loop_string_builder_count];
+		if (!current_block || block_is_terminated(current_block))
+		{
+			continue;
+		}
+		IRValue* builder = ir_emit_load(current_block, sb->builder);
+		IRValue* args[1] = {builder};
+		IRValue* text = ir_emit_call(
+		    current_block, ensure_runtime_function(program, "adn_string_builder_finish"), args,
+		    1);
+		arc_track_temp(text);
+		arc_assign(program, sb->slot, text);
+		arc_emit_release(program, builder);
+		ir_emit_store(current_block, sb->builder, ir_const_i64(0));
+	}
+}
+
+static IRValue* lower_loop_string_read(Program* program, LoopStringBuilder* sb)
+{
+	IRValue* args[1] = {ir_emit_load(current_block, sb->builder)};
+	IRValue* text = ir_emit_call(
+	    current_block, ensure_runtime_function(program, "adn_string_builder_to_string"), args, 1);
+	arc_track_temp(text);
+	return text;
+}
+
+static void lower_loop_string_assignment(Program* program, LoopStringBuilder* sb,
+                                         ASTNode* value)
+{
+	bool append = is_string_append_to(value, sb->name);
+	ASTNode* source = append ? value->binary_op.right : value;
+	IRValue* text = lower_expression(program, source);
+	if (!text)
+	{
+		fprintf(stderr, "Failed to lower assignment value for '%s'. (Error)\n", sb->name);
+		return;
+	}
+	text = lower_string_conversion(program, source, text,
+	                               infer_expression_type(program, source));
+	IRValue* builder = ir_emit_load(current_block, sb->builder);
+	if (!append)
+	{
+		IRValue* clear_args[1] = {builder};
+		ir_emit_call(current_block, ensure_runtime_function(program, "adn_string_builder_clear"),
+		             clear_args, 1);
+	}
+	IRValue* args[2] = {builder, text};
+	ir_emit_call(current_block, ensure_runtime_function(program, "adn_string_builder_append"),
+	             args, 2);
+}
+
 static bool starts_with(const char* text, const char* prefix)
 {
 	return text && prefix && strncmp(text, prefix, strlen(prefix)) == 0;
@@ -197,10 +632,15 @@ static bool is_regex_runtime_name(const char* name)
 	return starts_with(name, "adn_regex_");
 }
 
+static bool is_json_runtime_name(const char* name)
+{
+	return starts_with(name, "adn_json_");
+}
+
 static bool is_string_runtime_name(const char* name)
 {
-	return strcmp(name, "adn_strconcat") == 0 || strcmp(name, "adn_string_format") == 0 ||
-	       starts_with(name, "adn_string_") ||
+	return strcmp(name, "adn_strconcat") == 0 || strcmp(name, "adn_strconcat_n") == 0 ||
+	       strcmp(name, "adn_string_format") == 0 || starts_with(name, "adn_string_") ||
 	       (starts_with(name, "adn_") &&
 	        (ends_with(name, "_to_string") || ends_with(name, "_to_i32") ||
 	         ends_with(name, "_to_f64")));
@@ -232,13 +672,19 @@ static const char* infer_string_runtime_return_type(const char* name)
 		return NULL;
 	}
 
-	if (strcmp(name, "adn_strconcat") == 0 || strcmp(name, "adn_string_format") == 0 ||
-	    ends_with(name, "_to_string") || ends_with(name, "_char_at") ||
-	    ends_with(name, "_from_code"))
+	if (strcmp(name, "adn_strconcat") == 0 || strcmp(name, "adn_strconcat_n") == 0 ||
+	    strcmp(name, "adn_string_format") == 0 || ends_with(name, "_to_string") ||
+	    ends_with(name, "_char_at") || ends_with(name, "_from_code") ||
+	    strcmp(name, "adn_string_builder_finish") == 0)
 	{
 		return "string";
 	}
 
+	if (strcmp(name, "adn_string_builder_create") == 0)
+	{
+		return "string_builder";
+	}
+
 	if (ends_with(name, "_to_f64"))
 	{
 		return "f64";
@@ -303,8 +749,19 @@ static const char* infer_regex_runtime_return_type(const char* name)
 		return NULL;
 	}
 
+	if (strcmp(name, "adn_regex_new") == 0 || strcmp(name, "adn_regex_iter") == 0)
+	{
+		return "any";
+	}
+
+	if (strcmp(name, "adn_regex_free") == 0 || strcmp(name, "adn_regex_iter_close") == 0)
+	{
+		return "void";
+	}
+
 	if (ends_with(name, "_escape") || ends_with(name, "_compile") ||
-	    ends_with(name, "_replace") || ends_with(name, "_replace_all"))
+	    ends_with(name, "_replace") || ends_with(name, "_replace_all") ||
+	    ends_with(name, "_iter_group"))
 	{
 		return "string";
 	}
@@ -316,7 +773,10 @@ static const char* infer_regex_runtime_return_type(const char* name)
 
 	if (ends_with(name, "_valid") || ends_with(name, "_matches") ||
 	    ends_with(name, "_find") || ends_with(name, "_contains") ||
-	    ends_with(name, "_starts_with") || ends_with(name, "_ends_with"))
+	    ends_with(name, "_starts_with") || ends_with(name, "_ends_with") ||
+	    ends_with(name, "_cache_hits") || ends_with(name, "_cache_misses") ||
+	    ends_with(name, "_iter_next") || ends_with(name, "_iter_start") ||
+	    ends_with(name, "_iter_end"))
 	{
 		return "i32";
 	}
@@ -324,6 +784,43 @@ static const char* infer_regex_runtime_return_type(const char* name)
 	return NULL;
 }
 
+static const char* infer_json_runtime_return_type(const char* name)
+{
+	if (!is_json_runtime_name(name))
+	{
+		return NULL;
+	}
+
+	if (strcmp(name, "adn_json_parse") == 0 || starts_with(name, "adn_json_new_") ||
+	    strcmp(name, "adn_json_at") == 0 || strcmp(name, "adn_json_value_at") == 0 ||
+	    strcmp(name, "adn_json_get") == 0 || strcmp(name, "adn_json_reader_open") == 0 ||
+	    strcmp(name, "adn_json_reader_create") == 0 ||
+	    strcmp(name, "adn_json_reader_record") == 0)
+	{
+		return "any";
+	}
+
+	if (strcmp(name, "adn_json_type_name") == 0 || strcmp(name, "adn_json_as_string") == 0 ||
+	    strcmp(name, "adn_json_key_at") == 0 || strcmp(name, "adn_json_reader_text") == 0)
+	{
+		return "string";
+	}
+
+	if (strcmp(name, "adn_json_as_number") == 0 || strcmp(name, "adn_json_reader_number") == 0)
+	{
+		return "f64";
+	}
+
+	if (strcmp(name, "adn_json_reader_feed") == 0 ||
+	    strcmp(name, "adn_json_reader_finish") == 0 ||
+	    strcmp(name, "adn_json_reader_close") == 0)
+	{
+		return "void";
+	}
+
+	return "i32";
+}
+
 static IRFunction* ensure_string_runtime_function(Program* program, const char* name)
 {
 	if (!is_string_runtime_name(name))
@@ -333,12 +830,43 @@ static IRFunction* ensure_string_runtime_function(Program* program, const char*
 
 	IRType* ptr_type = ir_type_ptr(ir_type_i64());
 
+	if (strcmp(name, "adn_strconcat_n") == 0)
+	{
+		IRType* param_types[1 + ADN_STRCONCAT_MAX_PIECES];
+		param_types[0] = ir_type_i64();
+		for (size_t i = 1; i <= ADN_STRCONCAT_MAX_PIECES; i++)
+		{
+			param_types[i] = ptr_type;
+		}
+		return create_runtime_function_with_params(program, name, ptr_type, param_types,
+		                                         1 + ADN_STRCONCAT_MAX_PIECES);
+	}
+
 	if (strcmp(name, "adn_strconcat") == 0 || strcmp(name, "adn_string_format") == 0)
 	{
 		IRType* param_types[2] = {ptr_type, ptr_type};
 		return create_runtime_function_with_params(program, name, ptr_type, param_types, 2);
 	}
 
+	if (starts_with(name, "adn_string_builder_"))
+	{
+		if (ends_with(name, "_create"))
+		{
+			return create_runtime_function_with_params(program, name, ptr_type, NULL, 0);
+		}
+		if (ends_with(name, "_append"))
+		{
+			IRType* param_types[2] = {ptr_type, ptr_type};
+			return create_runtime_function_with_params(program, name, ir_type_void(),
+			                                         param_types, 2);
+		}
+		IRType* param_types[1] = {ptr_type};
+		IRType* return_type = ends_with(name, "_length")  ? ir_type_i64()
+		                      : ends_with(name, "_clear") ? ir_type_void()
+		                                                  : ptr_type;
+		return create_runtime_function_with_params(program, name, return_type, param_types, 1);
+	}
+
 	if (ends_with(name, "_to_string"))
 	{
 		IRType* param_types[1] = {strstr(name, "f64") ? ir_type_f64() : ir_type_i64()};
@@ -482,19 +1010,56 @@ static IRFunction* ensure_process_runtime_function(Program* program, const char*
 		return create_runtime_function_with_params(program, name, return_type, NULL, 0);
 	}
 
-	return NULL;
-}
+	return NULL;
+}
+
+static IRFunction* ensure_regex_runtime_function(Program* program, const char* name)
+{
+	IRType* ptr_type;
+
+	if (!is_regex_runtime_name(name))
+	{
+		return NULL;
+	}
+
+	ptr_type = ir_type_ptr(ir_type_i64());
+
+	if (strcmp(name, "adn_regex_new") == 0)
+	{
+		IRType* param_types[1] = {ptr_type};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types,
+		                                         1);
+	}
+
+	if (strcmp(name, "adn_regex_free") == 0 || strcmp(name, "adn_regex_iter_close") == 0)
+	{
+		IRType* param_types[1] = {ptr_type};
+		return create_runtime_function_with_params(program, name, ir_type_void(),
+		                                         param_types, 1);
+	}
 
-static IRFunction* ensure_regex_runtime_function(Program* program, const char* name)
-{
-	IRType* ptr_type;
+	if (strcmp(name, "adn_regex_iter") == 0)
+	{
+		IRType* param_types[2] = {ptr_type, ptr_type};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types,
+		                                         2);
+	}
 
-	if (!is_regex_runtime_name(name))
+	if (ends_with(name, "_iter_next"))
 	{
-		return NULL;
+		IRType* param_types[1] = {ptr_type};
+		return create_runtime_function_with_params(program, name, ir_type_i64(),
+		                                         param_types, 1);
 	}
 
-	ptr_type = ir_type_ptr(ir_type_i64());
+	if (ends_with(name, "_iter_start") || ends_with(name, "_iter_end") ||
+	    ends_with(name, "_iter_group"))
+	{
+		IRType* param_types[2] = {ptr_type, ir_type_i64()};
+		IRType* return_type = ends_with(name, "_iter_group") ? ptr_type : ir_type_i64();
+		return create_runtime_function_with_params(program, name, return_type, param_types,
+		                                         2);
+	}
 
 	if (ends_with(name, "_escape") || ends_with(name, "_compile"))
 	{
@@ -527,9 +1092,85 @@ static IRFunction* ensure_regex_runtime_function(Program* program, const char* n
 		                                         3);
 	}
 
+	if (ends_with(name, "_cache_hits") || ends_with(name, "_cache_misses"))
+	{
+		return create_runtime_function_with_params(program, name, ir_type_i64(), NULL, 0);
+	}
+
 	return NULL;
 }
 
+static IRFunction* ensure_json_runtime_function(Program* program, const char* name)
+{
+	IRType* ptr_type;
+
+	if (!is_json_runtime_name(name))
+	{
+		return NULL;
+	}
+
+	ptr_type = ir_type_ptr(ir_type_i64());
+
+	if (strcmp(name, "adn_json_reader_create") == 0 || strcmp(name, "adn_json_new_null") == 0)
+	{
+		return create_runtime_function_with_params(program, name, ptr_type, NULL, 0);
+	}
+
+	if (strcmp(name, "adn_json_new_bool") == 0 || strcmp(name, "adn_json_new_number") == 0)
+	{
+		IRType* param_types[1] = {strcmp(name, "adn_json_new_number") == 0 ? ir_type_f64()
+		                                                                   : ir_type_i64()};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types, 1);
+	}
+
+	if (strcmp(name, "adn_json_new_object") == 0 || strcmp(name, "adn_json_get") == 0 ||
+	    strcmp(name, "adn_json_has") == 0 || strcmp(name, "adn_json_reader_feed") == 0)
+	{
+		IRType* param_types[2] = {ptr_type, ptr_type};
+		IRType* return_type = strcmp(name, "adn_json_has") == 0 ? ir_type_i64() : ptr_type;
+		if (strcmp(name, "adn_json_reader_feed") == 0)
+		{
+			return_type = ir_type_void();
+		}
+		return create_runtime_function_with_params(program, name, return_type, param_types,
+		                                         2);
+	}
+
+	if (strcmp(name, "adn_json_at") == 0 || strcmp(name, "adn_json_key_at") == 0 ||
+	    strcmp(name, "adn_json_value_at") == 0)
+	{
+		IRType* param_types[2] = {ptr_type, ir_type_i64()};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types, 2);
+	}
+
+	{
+		IRType* param_types[1] = {ptr_type};
+		IRType* return_type = ir_type_i64();
+		if (strcmp(name, "adn_json_parse") == 0 || strcmp(name, "adn_json_new_string") == 0 ||
+		    strcmp(name, "adn_json_new_array") == 0 ||
+		    strcmp(name, "adn_json_type_name") == 0 ||
+		    strcmp(name, "adn_json_as_string") == 0 ||
+		    strcmp(name, "adn_json_reader_open") == 0 ||
+		    strcmp(name, "adn_json_reader_text") == 0 ||
+		    strcmp(name, "adn_json_reader_record") == 0)
+		{
+			return_type = ptr_type;
+		}
+		else if (strcmp(name, "adn_json_as_number") == 0 ||
+		         strcmp(name, "adn_json_reader_number") == 0)
+		{
+			return_type = ir_type_f64();
+		}
+		else if (strcmp(name, "adn_json_reader_finish") == 0 ||
+		         strcmp(name, "adn_json_reader_close") == 0)
+		{
+			return_type = ir_type_void();
+		}
+		return create_runtime_function_with_params(program, name, return_type, param_types,
+		                                         1);
+	}
+}
+
 static const char* member_method_name(const char* callee)
 {
 	const char* prefix = "__member_";
@@ -635,6 +1276,7 @@ static IRValue* lower_variadic_pack_array(Program* program, ASTNode** arg_nodes,
 		call_wrapper.call.arg_count = 2;
 		lower_array_method_call(program, &call_wrapper, push_args, 2);
 	}
+	arc_track_temp(array);
 	return array;
 }
 
@@ -713,6 +1355,30 @@ static RuntimeValueKind runtime_value_kind_from_type(const char* type_name)
 	return RUNTIME_VALUE_I64;
 }
 
+// Array storage for elements of a primitive type (ADN_ARRAY_STORAGE_I64 or _F64), or
+// ADN_ARRAY_STORAGE_UNSET for types that stay boxed.
+static int64_t unboxed_array_storage(const char* type_name)
+{
+	static const char* const integer_types[] = {"bool", "i1",  "i8",  "u8",  "i16",
+	                                            "u16",  "i32", "u32", "i64", "u64"};
+	if (!type_name)
+	{
+		return ADN_ARRAY_STORAGE_UNSET;
+	}
+	if (strcmp(type_name, "f32") == 0 || strcmp(type_name, "f64") == 0)
+	{
+		return ADN_ARRAY_STORAGE_F64;
+	}
+	for (size_t i = 0; i < sizeof(integer_types) / sizeof(integer_types[0]); i++)
+	{
+		if (strcmp(type_name, integer_types[i]) == 0)
+		{
+			return ADN_ARRAY_STORAGE_I64;
+		}
+	}
+	return ADN_ARRAY_STORAGE_UNSET;
+}
+
 static RuntimeValueKind runtime_value_kind_from_runtime_name(const char* name)
 {
 	if (!name)
@@ -795,6 +1461,11 @@ static IRValue* coerce_runtime_write_value(IRValue* value, RuntimeValueKind kind
 		return ir_emit_fpcvt(current_block, value, ir_type_f64());
 	}
 
+	if (kind == RUNTIME_VALUE_I64 && ir_type_is_integer_like(value->type))
+	{
+		return coerce_value_to_type(value, ir_type_i64());
+	}
+
 	return value;
 }
 
@@ -954,6 +1625,13 @@ static IRFunction* ensure_array_runtime_function(Program* program, const char* n
 		                                         ir_type_ptr(ir_type_i64()), NULL, 0);
 	}
 
+	if (ends_with(name, "_create_typed"))
+	{
+		IRType* param_types[2] = {ir_type_i64(), ir_type_i64()};
+		return create_runtime_function_with_params(program, name,
+		                                         ir_type_ptr(ir_type_i64()), param_types, 2);
+	}
+
 	if (ends_with(name, "_clear"))
 	{
 		IRType* param_types[1] = {ir_type_ptr(ir_type_i64())};
@@ -1021,6 +1699,12 @@ static IRFunction* ensure_object_runtime_function(Program* program, const char*
 		return create_runtime_function_with_params(program, name, ptr_type, NULL, 0);
 	}
 
+	if (ends_with(name, "_create_shaped"))
+	{
+		IRType* param_types[2] = {ptr_type, ir_type_i64()};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types, 2);
+	}
+
 	if (ends_with(name, "_has"))
 	{
 		IRType* param_types[2] = {ptr_type, ptr_type};
@@ -1031,6 +1715,19 @@ static IRFunction* ensure_object_runtime_function(Program* program, const char*
 	RuntimeValueKind kind = runtime_value_kind_from_runtime_name(name);
 	IRType* value_type = runtime_ir_type(kind);
 
+	if (strstr(name, "_set_hashed_") != NULL)
+	{
+		IRType* param_types[4] = {ptr_type, ptr_type, ir_type_i64(), value_type};
+		return create_runtime_function_with_params(program, name, ir_type_void(), param_types,
+		                                         4);
+	}
+
+	if (strstr(name, "_get_hashed_") != NULL)
+	{
+		IRType* param_types[3] = {ptr_type, ptr_type, ir_type_i64()};
+		return create_runtime_function_with_params(program, name, value_type, param_types, 3);
+	}
+
 	if (strstr(name, "_set_") != NULL)
 	{
 		IRType* param_types[3] = {ptr_type, ptr_type, value_type};
@@ -1072,85 +1769,214 @@ static IRValue* lower_collection_runtime_call(Program* program, const char* coll
 	return coerce_runtime_read_value(value, kind, value_type);
 }
 
-static const char* find_object_property_type(const char* object_type, const char* property_name)
+// Reads the next `key:type` pair of an "object{...}" type string, advancing `cursor`.
+static bool next_object_type_field(const char** cursor, char* key, size_t key_size, char* value,
+	                               size_t value_size)
 {
-	if (!is_object_type_name(object_type) || !property_name)
+	const char* position = *cursor;
+	if (!*position || *position == '}')
 	{
-		return NULL;
+		return false;
 	}
 
-	const char* cursor = object_type + 7;
-	while (*cursor && *cursor != '}')
+	size_t key_length = 0;
+	while (*position && *position != ':' && *position != '}')
 	{
-		char key[128];
-		size_t key_length = 0;
-		while (*cursor && *cursor != ':' && *cursor != '}')
+		if (key_length + 1 < key_size)
 		{
-			if (key_length + 1 < sizeof(key))
-			{
-				key[key_length++] = *cursor;
-			}
-			cursor++;
+			key[key_length++] = *position;
 		}
-		key[key_length] = '\0';
-		if (*cursor != ':')
+		position++;
+	}
+	key[key_length] = '\0';
+	if (*position != ':')
+	{
+		*cursor = position;
+		return false;
+	}
+	position++;
+
+	size_t value_length = 0;
+	size_t brace_depth = 0;
+	size_t angle_depth = 0;
+	while (*position)
+	{
+		char current = *position;
+		if (current == '{')
 		{
-			break;
+			brace_depth++;
 		}
-		cursor++;
-
-		char value[256];
-		size_t value_length = 0;
-		size_t brace_depth = 0;
-		size_t angle_depth = 0;
-		while (*cursor)
+		else if (current == '}')
 		{
-			char current = *cursor;
-			if (current == '{')
-			{
-				brace_depth++;
-			}
-			else if (current == '}')
-			{
-				if (brace_depth == 0 && angle_depth == 0)
-				{
-					break;
-				}
-				brace_depth--;
-			}
-			else if (current == '<')
-			{
-				angle_depth++;
-			}
-			else if (current == '>')
-			{
-				if (angle_depth > 0)
-				{
-					angle_depth--;
-				}
-			}
-			else if (current == ',' && brace_depth == 0 && angle_depth == 0)
+			if (brace_depth == 0 && angle_depth == 0)
 			{
 				break;
 			}
-			if (value_length + 1 < sizeof(value))
+			brace_depth--;
+		}
+		else if (current == '<')
+		{
+			angle_depth++;
+		}
+		else if (current == '>')
+		{
+			if (angle_depth > 0)
 			{
-				value[value_length++] = current;
+				angle_depth--;
 			}
-			cursor++;
 		}
-		value[value_length] = '\0';
+		else if (current == ',' && brace_depth == 0 && angle_depth == 0)
+		{
+			break;
+		}
+		if (value_length + 1 < value_size)
+		{
+			value[value_length++] = current;
+		}
+		position++;
+	}
+	value[value_length] = '\0';
+	if (*position == ',')
+	{
+		position++;
+	}
+	*cursor = position;
+	return true;
+}
+
+static const char* find_object_property_type(const char* object_type, const char* property_name)
+{
+	if (!is_object_type_name(object_type) || !property_name)
+	{
+		return NULL;
+	}
+
+	const char* cursor = object_type + 7;
+	char key[128];
+	char value[256];
+	while (next_object_type_field(&cursor, key, sizeof(key), value, sizeof(value)))
+	{
 		if (strcmp(key, property_name) == 0)
 		{
 			return cache_type_string(value);
 		}
-		if (*cursor == ',')
+	}
+
+	return NULL;
+}
+
+// Record values keep their fields in declaration order inside the runtime object, so
+// a "shape" string (`key:kind,...`) names the slot and storage kind of every field.
+// Objects created with a shape let typed member reads load the slot directly.
+typedef struct ObjectShapeGlobal
+{
+	IRModule* module;
+	char* shape;
+	IRValue* global;
+	struct ObjectShapeGlobal* next;
+} ObjectShapeGlobal;
+
+static ObjectShapeGlobal* object_shape_globals = NULL;
+
+static char runtime_value_kind_code(RuntimeValueKind kind)
+{
+	switch (kind)
+	{
+		case RUNTIME_VALUE_F64:
+			return 'd';
+		case RUNTIME_VALUE_STRING:
+			return 's';
+		case RUNTIME_VALUE_PTR:
+			return 'p';
+		default:
+			return 'i';
+	}
+}
+
+static bool append_object_shape_field(char* shape, size_t shape_size, size_t* length,
+	                                  const char* key, RuntimeValueKind kind)
+{
+	int written = snprintf(shape + *length, shape_size - *length, "%s%s:%c",
+	                       *length > 0 ? "," : "", key, runtime_value_kind_code(kind));
+	if (written < 0 || (size_t)written >= shape_size - *length)
+	{
+		return false;
+	}
+	*length += (size_t)written;
+	return true;
+}
+
+// Shape of a static record type, plus the slot of `property_name` in it.
+static bool object_type_shape(const char* object_type, const char* property_name, char* shape,
+	                          size_t shape_size, size_t* property_index)
+{
+	if (!is_object_type_name(object_type) || !property_name)
+	{
+		return false;
+	}
+
+	const char* cursor = object_type + 7;
+	char key[128];
+	char value[256];
+	size_t length = 0;
+	size_t index = 0;
+	bool found = false;
+	shape[0] = '\0';
+	while (next_object_type_field(&cursor, key, sizeof(key), value, sizeof(value)))
+	{
+		if (!append_object_shape_field(shape, shape_size, &length, key,
+		                               runtime_value_kind_from_type(value)))
+		{
+			return false;
+		}
+		if (!found && strcmp(key, property_name) == 0)
 		{
-			cursor++;
+			*property_index = index;
+			found = true;
 		}
+		index++;
 	}
 
-	return NULL;
+	return found && *cursor == '}';
+}
+
+// Hash of a constant key string, matching the runtime's adn_hash_key.
+static IRValue* object_key_hash(IRValue* key)
+{
+	if (!key || key->kind != IRV_GLOBAL || !key->u.i64)
+	{
+		return NULL;
+	}
+	return ir_const_i64((int64_t)adn_hash_key((const char*)(intptr_t)key->u.i64));
+}
+
+static IRValue* object_shape_global(Program* program, const char* shape)
+{
+	for (ObjectShapeGlobal* entry = object_shape_globals; entry; entry = entry->next)
+	{
+		if (entry->module == program->ir && strcmp(entry->shape, shape) == 0)
+		{
+			return entry->global;
+		}
+	}
+
+	ObjectShapeGlobal* entry = malloc(sizeof(ObjectShapeGlobal));
+	if (!entry)
+	{
+		return NULL;
+	}
+	entry->module = program->ir;
+	entry->shape = strdup(shape);
+	entry->global = ir_const_string(program->ir, shape);
+	if (!entry->shape || !entry->global)
+	{
+		free(entry->shape);
+		free(entry);
+		return NULL;
+	}
+	entry->next = object_shape_globals;
+	object_shape_globals = entry;
+	return entry->global;
 }
 
 static void sym_put(const char* name, const char* type_name, IRValue* v, int is_addr)
@@ -1521,6 +2347,41 @@ static IRFunction* ensure_program_function(Program* program, const char* name)
 	return fn;
 }
 
+static IRFunction* ensure_format_runtime_function(Program* program, const char* name)
+{
+	if (!starts_with(name, "adn_format_"))
+	{
+		return NULL;
+	}
+
+	IRType* ptr_type = ir_type_ptr(ir_type_i64());
+
+	if (strcmp(name, "adn_format_begin") == 0)
+	{
+		return create_runtime_function_with_params(program, name, ptr_type, NULL, 0);
+	}
+
+	if (strcmp(name, "adn_format_text") == 0 || strcmp(name, "adn_format_finish") == 0)
+	{
+		IRType* param_types[1] = {ptr_type};
+		return create_runtime_function_with_params(program, name, ptr_type, param_types, 1);
+	}
+
+	if (strcmp(name, "adn_format_append_text") == 0)
+	{
+		IRType* param_types[2] = {ptr_type, ptr_type};
+		return create_runtime_function_with_params(program, name, ir_type_void(), param_types,
+		                                         2);
+	}
+
+	RuntimeValueKind kind = ends_with(name, "_f64")      ? RUNTIME_VALUE_F64
+	                        : ends_with(name, "_string") ? RUNTIME_VALUE_STRING
+	                        : ends_with(name, "_ptr")    ? RUNTIME_VALUE_PTR
+	                                                     : RUNTIME_VALUE_I64;
+	IRType* param_types[3] = {ptr_type, runtime_ir_type(kind), ir_type_i64()};
+	return create_runtime_function_with_params(program, name, ir_type_void(), param_types, 3);
+}
+
 static IRFunction* ensure_runtime_function(Program* program, const char* name)
 {
 	IRFunction* fn = find_ir_function(program->ir, name);
@@ -1528,36 +2389,82 @@ static IRFunction* ensure_runtime_function(Program* program, const char* name)
 	{
 		return fn;
 	}
-
-	if (strcmp(name, "adn_print") == 0 || strcmp(name, "adn_error") == 0)
+
+	if (strcmp(name, "adn_print") == 0 || strcmp(name, "adn_error") == 0)
+	{
+		fn = ir_function_create_in_module(program->ir, name, ir_type_void());
+		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
+		return fn;
+	}
+	if (strcmp(name, "adn_input") == 0)
+	{
+		fn = ir_function_create_in_module(program->ir, name, ir_type_ptr(ir_type_i64()));
+		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
+		return fn;
+	}
+	if (strcmp(name, "adn_flush") == 0)
+	{
+		return ir_function_create_in_module(program->ir, name, ir_type_void());
+	}
+	if (strcmp(name, "adn_set_output_buffer") == 0)
+	{
+		fn = ir_function_create_in_module(program->ir, name, ir_type_void());
+		ir_param_create(fn, NULL, ir_type_i64());
+		return fn;
+	}
+	if (strcmp(name, "adn_retain") == 0 || strcmp(name, "adn_release") == 0)
+	{
+		bool is_retain = strcmp(name, "adn_retain") == 0;
+		fn = ir_function_create_in_module(
+		    program->ir, name, is_retain ? ir_type_ptr(ir_type_i64()) : ir_type_void());
+		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
+		return fn;
+	}
+	if (strcmp(name, "adn_write_file") == 0 || strcmp(name, "adn_file_open") == 0 ||
+	    strcmp(name, "adn_file_write") == 0)
 	{
-		fn = ir_function_create_in_module(program->ir, name, ir_type_void());
+		IRType* return_type = strcmp(name, "adn_file_open") == 0 ? ir_type_ptr(ir_type_i64())
+		                                                         : ir_type_void();
+		fn = ir_function_create_in_module(program->ir, name, return_type);
+		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		return fn;
 	}
-	if (strcmp(name, "adn_input") == 0)
+	if (strcmp(name, "adn_read_file") == 0 || strcmp(name, "adn_map_file") == 0 ||
+	    strcmp(name, "adn_lines_open") == 0 || strcmp(name, "adn_lines_line") == 0)
 	{
 		fn = ir_function_create_in_module(program->ir, name, ir_type_ptr(ir_type_i64()));
 		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		return fn;
 	}
-	if (strcmp(name, "adn_flush") == 0)
+	if (strcmp(name, "adn_lines_next") == 0 || strcmp(name, "adn_read_many") == 0)
 	{
-		return ir_function_create_in_module(program->ir, name, ir_type_void());
+		IRType* return_type = strcmp(name, "adn_read_many") == 0 ? ir_type_ptr(ir_type_i64())
+		                                                         : ir_type_i64();
+		fn = ir_function_create_in_module(program->ir, name, return_type);
+		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
+		return fn;
 	}
-	if (strcmp(name, "adn_write_file") == 0)
+	if (strcmp(name, "adn_write_many") == 0)
 	{
-		fn = ir_function_create_in_module(program->ir, name, ir_type_void());
+		fn = ir_function_create_in_module(program->ir, name, ir_type_i64());
 		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		return fn;
 	}
-	if (strcmp(name, "adn_read_file") == 0)
+	if (strcmp(name, "adn_unmap_file") == 0 || strcmp(name, "adn_lines_close") == 0 ||
+	    strcmp(name, "adn_file_flush") == 0 || strcmp(name, "adn_file_close") == 0)
 	{
-		fn = ir_function_create_in_module(program->ir, name, ir_type_ptr(ir_type_i64()));
+		fn = ir_function_create_in_module(program->ir, name, ir_type_void());
 		ir_param_create(fn, NULL, ir_type_ptr(ir_type_i64()));
 		return fn;
 	}
+	fn = ensure_format_runtime_function(program, name);
+	if (fn)
+	{
+		return fn;
+	}
+
 	fn = ensure_string_runtime_function(program, name);
 	if (fn)
 	{
@@ -1576,6 +2483,12 @@ static IRFunction* ensure_runtime_function(Program* program, const char* name)
 		return fn;
 	}
 
+	fn = ensure_json_runtime_function(program, name);
+	if (fn)
+	{
+		return fn;
+	}
+
 	fn = ensure_object_runtime_function(program, name);
 	if (fn)
 	{
@@ -1692,6 +2605,10 @@ static const char* infer_expression_type(Program* program, ASTNode* node)
 					runtime_type = infer_regex_runtime_return_type(node->call.callee);
 				}
 				if (!runtime_type)
+				{
+					runtime_type = infer_json_runtime_return_type(node->call.callee);
+				}
+				if (!runtime_type)
 				{
 					runtime_type = infer_array_runtime_return_type(node->call.callee);
 				}
@@ -1701,10 +2618,26 @@ static const char* infer_expression_type(Program* program, ASTNode* node)
 				}
 				if (!runtime_type &&
 				    (strcmp(node->call.callee, "adn_read_file") == 0 ||
+				     strcmp(node->call.callee, "adn_map_file") == 0 ||
+				     strcmp(node->call.callee, "adn_lines_line") == 0 ||
 				     strcmp(node->call.callee, "adn_input") == 0))
 				{
 					runtime_type = "string";
 				}
+				if (!runtime_type && (strcmp(node->call.callee, "adn_lines_next") == 0 ||
+				                      strcmp(node->call.callee, "adn_write_many") == 0))
+				{
+					runtime_type = "i32";
+				}
+				if (!runtime_type && strcmp(node->call.callee, "adn_read_many") == 0)
+				{
+					runtime_type = "array<string>";
+				}
+				if (!runtime_type && (strcmp(node->call.callee, "adn_lines_open") == 0 ||
+				                      strcmp(node->call.callee, "adn_file_open") == 0))
+				{
+					runtime_type = "any";
+				}
 				if (runtime_type)
 				{
 					return runtime_type;
@@ -1768,11 +2701,15 @@ static IRValue* lower_string_conversion(Program* program, ASTNode* node, IRValue
 		}
 		IRFunction* fn = ensure_runtime_function(program, "adn_f64_to_string");
 		IRValue* args[1] = {value};
-		return ir_emit_call(current_block, fn, args, 1);
+		IRValue* converted = ir_emit_call(current_block, fn, args, 1);
+		arc_track_temp(converted);
+		return converted;
 	}
 	IRFunction* fn = ensure_runtime_function(program, "adn_i32_to_string");
 	IRValue* args[1] = {value};
-	return ir_emit_call(current_block, fn, args, 1);
+	IRValue* converted = ir_emit_call(current_block, fn, args, 1);
+	arc_track_temp(converted);
+	return converted;
 }
 
 static IRValue* lower_array_method_call(Program* program, ASTNode* node, IRValue** args,
@@ -1791,6 +2728,18 @@ static IRValue* lower_array_method_call(Program* program, ASTNode* node, IRValue
 	if (strcmp(node->call.callee, "__array_push") == 0 && nargs == 2)
 	{
 		const char* value_type = infer_expression_type(program, node->call.args[1]);
+		const char* element_type = extract_array_element_type(
+		    node->call.args[0] ? infer_expression_type(program, node->call.args[0]) : NULL);
+		RuntimeValueKind element_kind = runtime_value_kind_from_type(element_type);
+		RuntimeValueKind value_kind = runtime_value_kind_from_type(value_type);
+		if (unboxed_array_storage(element_type) != ADN_ARRAY_STORAGE_UNSET &&
+		    (value_kind == element_kind ||
+		     (element_kind == RUNTIME_VALUE_F64 && value_kind == RUNTIME_VALUE_I64)))
+		{
+			// Push in the array's own element kind so its unboxed storage is kept.
+			value_type = element_type;
+			args[1] = coerce_value_to_type(args[1], runtime_ir_type(element_kind));
+		}
 		return lower_collection_runtime_call(program, "array", "push", value_type, args,
 		                                  nargs, 1, false);
 	}
@@ -1851,16 +2800,209 @@ static IRValue* lower_string_method_call(Program* program, ASTNode* node, IRValu
 	return NULL;
 }
 
+static void append_format_text(Program* program, IRValue* buffer, char* segment,
+                               size_t* segment_length)
+{
+	if (*segment_length == 0)
+	{
+		return;
+	}
+	// Quoted so ir_const_string strips exactly these quotes and unescapes the rest.
+	segment[(*segment_length)++] = '"';
+	segment[*segment_length] = '\0';
+	IRValue* args[2] = {buffer, ir_const_string(program->ir, segment)};
+	ir_emit_call(current_block, ensure_runtime_function(program, "adn_format_append_text"),
+	             args, 2);
+	*segment_length = 1;
+}
+
+// io.print, io.error and string format calls whose format is a string literal: the
+// format is split into text and '%' specs here, and each piece is appended to the
+// runtime's scratch format buffer with a call typed for its argument. This skips the
+// boxed argument array and the runtime parse of the format. Returns false when the
+// call does not qualify and must take the generic path.
+static bool lower_literal_format_call(Program* program, ASTNode* node, IRValue** result)
+{
+	const char* sink = NULL;
+	if (strcmp(node->call.callee, "__ns_io_print") == 0)
+	{
+		sink = "adn_print";
+	}
+	else if (strcmp(node->call.callee, "__ns_io_error") == 0)
+	{
+		sink = "adn_error";
+	}
+	else if (strcmp(node->call.callee, "__string_format") != 0)
+	{
+		return false;
+	}
+	if (node->call.arg_count == 0 || !node->call.args[0] ||
+	    node->call.args[0]->type != AST_STRING_LITERAL || !node->call.args[0]->string_literal.value)
+	{
+		return false;
+	}
+
+	const char* format = node->call.args[0]->string_literal.value;
+	size_t format_length = strlen(format);
+	if (format_length >= 2 &&
+	    ((format[0] == '"' && format[format_length - 1] == '"') ||
+	     (format[0] == '\'' && format[format_length - 1] == '\'') ||
+	     (format[0] == '`' && format[format_length - 1] == '`')))
+	{
+		format++;
+		format_length -= 2;
+	}
+	// Escapes that can produce a NUL or a '%' only exist after unescaping; leave those
+	// formats to the runtime.
+	for (size_t i = 0; i + 1 < format_length; i++)
+	{
+		if (format[i] == '\\')
+		{
+			char next = format[i + 1];
+			if (next == 'x' || next == 'u' || next == '0' || next == '%')
+			{
+				return false;
+			}
+			i++;
+		}
+	}
+
+	size_t value_count = node->call.arg_count - 1;
+	IRValue** values = calloc(value_count ? value_count : 1, sizeof(IRValue*));
+	char* segment = malloc(format_length + 3);
+	if (!values || !segment)
+	{
+		free(values);
+		free(segment);
+		return false;
+	}
+	for (size_t i = 0; i < value_count; i++)
+	{
+		values[i] = lower_expression(program, node->call.args[i + 1]);
+	}
+
+	IRValue* buffer =
+	    ir_emit_call(current_block, ensure_runtime_function(program, "adn_format_begin"), NULL, 0);
+	size_t segment_length = 1;
+	segment[0] = '"';
+	size_t value_index = 0;
+	for (size_t i = 0; i < format_length; i++)
+	{
+		if (format[i] == '\\' && i + 1 < format_length)
+		{
+			segment[segment_length++] = format[i++];
+			segment[segment_length++] = format[i];
+			continue;
+		}
+		if (format[i] != '%')
+		{
+			segment[segment_length++] = format[i];
+			continue;
+		}
+		if (i + 1 == format_length || format[i + 1] == '%')
+		{
+			segment[segment_length++] = '%';
+			i++;
+			continue;
+		}
+		char spec = format[++i];
+		if (value_index >= value_count)
+		{
+			continue;
+		}
+		ASTNode* value_node = node->call.args[value_index + 1];
+		IRValue* value = values[value_index++];
+		if (!value)
+		{
+			continue;
+		}
+		append_format_text(program, buffer, segment, &segment_length);
+		RuntimeValueKind kind =
+		    runtime_value_kind_from_type(infer_expression_type(program, value_node));
+		IRValue* args[3] = {buffer, coerce_runtime_write_value(value, kind),
+		                    ir_const_i64((unsigned char)spec)};
+		ir_emit_call(current_block,
+		             ensure_runtime_function(
+		                 program, build_collection_runtime_name("format", "append", kind)),
+		             args, 3);
+	}
+	append_format_text(program, buffer, segment, &segment_length);
+	free(segment);
+	free(values);
+
+	IRValue* text_args[1] = {buffer};
+	if (!sink)
+	{
+		*result = ir_emit_call(current_block,
+		                       ensure_runtime_function(program, "adn_format_finish"), text_args, 1);
+		return true;
+	}
+	IRValue* print_args[1] = {ir_emit_call(
+	    current_block, ensure_runtime_function(program, "adn_format_text"), text_args, 1)};
+	*result = ir_emit_call(current_block, ensure_runtime_function(program, sink), print_args, 1);
+	return true;
+}
+
+// Shape of an object literal from the inferred type of each value, or false when a key
+// repeats (the later write would not get a slot of its own).
+static bool object_literal_shape(Program* program, ASTNode* node, char* shape, size_t shape_size)
+{
+	size_t length = 0;
+	shape[0] = '\0';
+	for (size_t i = 0; i < node->object_literal.count; i++)
+	{
+		const char* key = node->object_literal.properties[i].key;
+		for (size_t j = 0; j < i; j++)
+		{
+			if (strcmp(node->object_literal.properties[j].key, key) == 0)
+			{
+				return false;
+			}
+		}
+		const char* value_type =
+		    infer_expression_type(program, node->object_literal.properties[i].value);
+		if (!append_object_shape_field(shape, shape_size, &length, key,
+		                               runtime_value_kind_from_type(value_type)))
+		{
+			return false;
+		}
+	}
+	return node->object_literal.count > 0;
+}
+
 static IRValue* lower_object_literal(Program* program, ASTNode* node)
 {
-	IRFunction* create_fn = ensure_runtime_function(program, "adn_object_create");
-	IRValue* object = ir_emit_call(current_block, create_fn, NULL, 0);
+	char shape[1024];
+	IRValue* shape_global = object_literal_shape(program, node, shape, sizeof(shape))
+	                            ? object_shape_global(program, shape)
+	                            : NULL;
+	IRValue* object = NULL;
+	if (shape_global)
+	{
+		IRFunction* create_fn = ensure_runtime_function(program, "adn_object_create_shaped");
+		IRValue* create_args[2] = {shape_global,
+		                           ir_const_i64((int64_t)node->object_literal.count)};
+		object = ir_emit_call(current_block, create_fn, create_args, 2);
+	}
+	else
+	{
+		IRFunction* create_fn = ensure_runtime_function(program, "adn_object_create");
+		object = ir_emit_call(current_block, create_fn, NULL, 0);
+	}
 	for (size_t i = 0; i < node->object_literal.count; i++)
 	{
 		ASTObjectProperty property = node->object_literal.properties[i];
 		IRValue* key = ir_const_string(program->ir, property.key);
 		IRValue* value = lower_expression(program, property.value);
 		const char* value_type = infer_expression_type(program, property.value);
+		IRValue* hash = object_key_hash(key);
+		if (hash)
+		{
+			IRValue* args[4] = {object, key, hash, value};
+			lower_collection_runtime_call(program, "object", "set_hashed", value_type, args, 4,
+			                          3, false);
+			continue;
+		}
 		IRValue* args[3] = {object, key, value};
 		lower_collection_runtime_call(program, "object", "set", value_type, args, 3, 2,
 		                          false);
@@ -1868,10 +3010,41 @@ static IRValue* lower_object_literal(Program* program, ASTNode* node)
 	return object;
 }
 
+// Storage an array literal can start in: unboxed when every element has the same
+// primitive kind, otherwise left for the runtime to pick on the first push.
+static int64_t array_literal_storage(Program* program, ASTNode* node)
+{
+	int64_t storage = ADN_ARRAY_STORAGE_UNSET;
+	for (size_t i = 0; i < node->array_literal.count; i++)
+	{
+		int64_t element_storage = unboxed_array_storage(
+		    infer_expression_type(program, node->array_literal.elements[i]));
+		if (element_storage == ADN_ARRAY_STORAGE_UNSET ||
+		    (i > 0 && element_storage != storage))
+		{
+			return ADN_ARRAY_STORAGE_UNSET;
+		}
+		storage = element_storage;
+	}
+	return storage;
+}
+
 static IRValue* lower_array_literal(Program* program, ASTNode* node)
 {
-	IRFunction* create_fn = ensure_runtime_function(program, "adn_array_create");
-	IRValue* array = ir_emit_call(current_block, create_fn, NULL, 0);
+	int64_t storage = array_literal_storage(program, node);
+	IRValue* array = NULL;
+	if (storage != ADN_ARRAY_STORAGE_UNSET)
+	{
+		IRFunction* create_fn = ensure_runtime_function(program, "adn_array_create_typed");
+		IRValue* create_args[2] = {ir_const_i64(storage),
+		                           ir_const_i64((int64_t)node->array_literal.count)};
+		array = ir_emit_call(current_block, create_fn, create_args, 2);
+	}
+	else
+	{
+		IRFunction* create_fn = ensure_runtime_function(program, "adn_array_create");
+		array = ir_emit_call(current_block, create_fn, NULL, 0);
+	}
 	for (size_t i = 0; i < node->array_literal.count; i++)
 	{
 		IRValue* pushed_value = lower_expression(program, node->array_literal.elements[i]);
@@ -1886,14 +3059,143 @@ static IRValue* lower_array_literal(Program* program, ASTNode* node)
 	return array;
 }
 
+// Reads field `index` of an object whose shape pointer equals `shape_global` straight
+// from its entry array; any other object (or null) goes through the keyed lookup.
+static IRValue* lower_shaped_member_read(Program* program, IRValue* object, IRValue* key,
+	                                     IRValue* hash, IRValue* shape_global, size_t index,
+	                                     RuntimeValueKind kind, const char* property_type)
+{
+	IRType* value_type = runtime_ir_type(kind);
+	IRBlock* check_b = ir_block_create_in_function(current_function, "shape_check");
+	IRBlock* fast_b = ir_block_create_in_function(current_function, "shape_hit");
+	IRBlock* slow_b = ir_block_create_in_function(current_function, "shape_miss");
+	IRBlock* merge_b = ir_block_create_in_function(current_function, "shape_merge");
+	IRValue* null_object = ir_const_i64(0);
+	if (!check_b || !fast_b || !slow_b || !merge_b || !null_object)
+	{
+		return NULL;
+	}
+	null_object->type = object->type;
+	ir_emit_cbr(current_block, ir_emit_binop(current_block, "==", object, null_object), slow_b,
+	            check_b);
+
+	IRValue* shape_slot = ir_emit_gep(check_b, object, ADN_OBJECT_SHAPE_OFFSET,
+	                                  ir_type_ptr(ir_type_ptr(ir_type_i64())));
+	IRValue* shape = ir_emit_load(check_b, shape_slot);
+	ir_emit_cbr(check_b, ir_emit_binop(check_b, "==", shape, shape_global), fast_b, slow_b);
+
+	IRValue* entries_slot = ir_emit_gep(fast_b, object, ADN_OBJECT_ENTRIES_OFFSET,
+	                                    ir_type_ptr(ir_type_ptr(ir_type_i64())));
+	IRValue* entries = ir_emit_load(fast_b, entries_slot);
+	int64_t offset = (int64_t)index * ADN_OBJECT_ENTRY_SIZE + ADN_OBJECT_ENTRY_DATA_OFFSET;
+	IRValue* fast_value =
+	    ir_emit_load(fast_b, ir_emit_gep(fast_b, entries, offset, ir_type_ptr(value_type)));
+	if (value_type->kind == IR_T_PTR)
+	{
+		// The keyed lookup returns a new reference; match it on the direct path.
+		IRValue* retain_args[1] = {fast_value};
+		ir_emit_call(fast_b, ensure_runtime_function(program, "adn_retain"), retain_args, 1);
+	}
+	ir_emit_br(fast_b, merge_b);
+
+	IRFunction* get_fn = ensure_runtime_function(
+	    program, build_collection_runtime_name("object", "get_hashed", kind));
+	IRValue* args[3] = {object, key, hash};
+	IRValue* slow_value = ir_emit_call(slow_b, get_fn, args, 3);
+	ir_emit_br(slow_b, merge_b);
+
+	current_block = merge_b;
+	IRValue* values[2] = {fast_value, slow_value};
+	IRBlock* blocks[2] = {fast_b, slow_b};
+	IRValue* value = ir_emit_phi(merge_b, value_type, values, blocks, 2);
+	return coerce_runtime_read_value(value, kind, property_type);
+}
+
 static IRValue* lower_member_access(Program* program, ASTNode* node)
 {
 	const char* property_type = infer_expression_type(program, node);
+	const char* object_type = infer_expression_type(program, node->member_access.object);
+	const char* property_name = node->member_access.property->identifier.name;
+	char shape[1024];
+	size_t index = 0;
+	bool shaped = object_type_shape(object_type, property_name, shape, sizeof(shape), &index);
 	IRValue* object = lower_expression(program, node->member_access.object);
-	IRValue* key = ir_const_string(program->ir, node->member_access.property->identifier.name);
-	IRValue* args[2] = {object, key};
-	return lower_collection_runtime_call(program, "object", "get", property_type, args, 2,
-	                                  (size_t)-1, true);
+	IRValue* key = ir_const_string(program->ir, property_name);
+	IRValue* hash = object_key_hash(key);
+	if (!hash)
+	{
+		IRValue* args[2] = {object, key};
+		return lower_collection_runtime_call(program, "object", "get", property_type, args, 2,
+		                                  (size_t)-1, true);
+	}
+	if (shaped && object && object->type && object->type->kind == IR_T_PTR)
+	{
+		IRValue* shape_global = object_shape_global(program, shape);
+		if (shape_global)
+		{
+			return lower_shaped_member_read(program, object, key, hash, shape_global, index,
+			                                runtime_value_kind_from_type(property_type),
+			                                property_type);
+		}
+	}
+	IRValue* args[3] = {object, key, hash};
+	return lower_collection_runtime_call(program, "object", "get_hashed", property_type, args,
+	                                  3, (size_t)-1, true);
+}
+
+// Reads element `index` of an array whose runtime storage is `storage` straight from
+// its item buffer; boxed arrays, null and out-of-range indexes use adn_array_get_*.
+static IRValue* lower_unboxed_array_read(Program* program, IRValue* array, IRValue* index,
+	                                     int64_t storage, const char* element_type)
+{
+	RuntimeValueKind kind = runtime_value_kind_from_type(element_type);
+	IRType* value_type = runtime_ir_type(kind);
+	IRBlock* check_b = ir_block_create_in_function(current_function, "array_check");
+	IRBlock* bounds_b = ir_block_create_in_function(current_function, "array_bounds");
+	IRBlock* fast_b = ir_block_create_in_function(current_function, "array_hit");
+	IRBlock* slow_b = ir_block_create_in_function(current_function, "array_miss");
+	IRBlock* merge_b = ir_block_create_in_function(current_function, "array_merge");
+	IRValue* null_array = ir_const_i64(0);
+	if (!check_b || !bounds_b || !fast_b || !slow_b || !merge_b || !null_array)
+	{
+		return NULL;
+	}
+	null_array->type = array->type;
+	ir_emit_cbr(current_block, ir_emit_binop(current_block, "==", array, null_array), slow_b,
+	            check_b);
+
+	IRValue* storage_slot =
+	    ir_emit_gep(check_b, array, ADN_ARRAY_STORAGE_OFFSET, ir_type_ptr(ir_type_i64()));
+	IRValue* actual_storage = ir_emit_load(check_b, storage_slot);
+	ir_emit_cbr(check_b, ir_emit_binop(check_b, "==", actual_storage, ir_const_i64(storage)),
+	            bounds_b, slow_b);
+
+	IRValue* count_slot =
+	    ir_emit_gep(bounds_b, array, ADN_ARRAY_COUNT_OFFSET, ir_type_ptr(ir_type_i64()));
+	IRValue* count = ir_emit_load(bounds_b, count_slot);
+	IRValue* in_range =
+	    ir_emit_binop(bounds_b, "and", ir_emit_binop(bounds_b, ">=", index, ir_const_i64(0)),
+	                  ir_emit_binop(bounds_b, "<", index, count));
+	ir_emit_cbr(bounds_b, in_range, fast_b, slow_b);
+
+	IRValue* items_slot = ir_emit_gep(fast_b, array, ADN_ARRAY_ITEMS_OFFSET,
+	                                  ir_type_ptr(ir_type_ptr(value_type)));
+	IRValue* items = ir_emit_load(fast_b, items_slot);
+	IRValue* fast_value =
+	    ir_emit_load(fast_b, ir_emit_gep_index(fast_b, items, index, ir_type_ptr(value_type)));
+	ir_emit_br(fast_b, merge_b);
+
+	IRFunction* get_fn =
+	    ensure_runtime_function(program, build_collection_runtime_name("array", "get", kind));
+	IRValue* args[2] = {array, index};
+	IRValue* slow_value = ir_emit_call(slow_b, get_fn, args, 2);
+	ir_emit_br(slow_b, merge_b);
+
+	current_block = merge_b;
+	IRValue* values[2] = {fast_value, slow_value};
+	IRBlock* blocks[2] = {fast_b, slow_b};
+	IRValue* value = ir_emit_phi(merge_b, value_type, values, blocks, 2);
+	return coerce_runtime_read_value(value, kind, element_type);
 }
 
 static IRValue* lower_array_access(Program* program, ASTNode* node)
@@ -1901,12 +3203,181 @@ static IRValue* lower_array_access(Program* program, ASTNode* node)
 	const char* element_type = infer_expression_type(program, node);
 	IRValue* array = lower_expression(program, node->array_access.array);
 	IRValue* index = lower_expression(program, node->array_access.index);
+	int64_t storage = unboxed_array_storage(element_type);
+	if (index && index->kind == IRV_CONST && ir_type_is_integer_like(index->type))
+	{
+		index = coerce_value_to_type(index, ir_type_i64());
+	}
+	if (storage != ADN_ARRAY_STORAGE_UNSET && array && array->type &&
+	    array->type->kind == IR_T_PTR && index && index->type &&
+	    index->type->kind == IR_T_I64)
+	{
+		return lower_unboxed_array_read(program, array, index, storage, element_type);
+	}
 	IRValue* args[2] = {array, index};
 	return lower_collection_runtime_call(program, "array", "get", element_type, args, 2,
 	                                  (size_t)-1, true);
 }
 
-IRValue* lower_expression(Program* program, ASTNode* node)
+// Logical operators produce i64 0/1, the same representation comparisons use.
+static IRValue* lower_truth_value(IRValue* value)
+{
+	if (!value || !value->type || value->type->kind == IR_T_I64)
+	{
+		return value;
+	}
+	if (value->kind == IRV_CONST && !ir_type_is_float_like(value->type))
+	{
+		return ir_const_i64(value->u.i64 != 0);
+	}
+	IRValue* zero = ir_type_is_float_like(value->type) ? ir_const_f64(0.0) : ir_const_i64(0);
+	if (!zero)
+	{
+		return NULL;
+	}
+	zero->type = value->type;
+	return ir_emit_binop(current_block, "!==", value, zero);
+}
+
+static bool is_string_concat(Program* program, ASTNode* node)
+{
+	if (!node || node->type != AST_BINARY_OP || !node->binary_op.op ||
+	    strcmp(node->binary_op.op, "+") != 0)
+	{
+		return false;
+	}
+	const char* left_type = infer_expression_type(program, node->binary_op.left);
+	const char* right_type = infer_expression_type(program, node->binary_op.right);
+	return (left_type && strcmp(left_type, "string") == 0) ||
+	       (right_type && strcmp(right_type, "string") == 0);
+}
+
+static bool collect_concat_pieces(Program* program, ASTNode* node, ASTNode*** pieces,
+                                  size_t* count, size_t* capacity)
+{
+	if (is_string_concat(program, node))
+	{
+		return collect_concat_pieces(program, node->binary_op.left, pieces, count,
+		                             capacity) &&
+		       collect_concat_pieces(program, node->binary_op.right, pieces, count, capacity);
+	}
+	if (*count == *capacity)
+	{
+		size_t next_capacity = *capacity == 0 ? 8 : *capacity * 2;
+		ASTNode** resized = realloc(*pieces, next_capacity * sizeof(ASTNode*));
+		if (!resized)
+		{
+			return false;
+		}
+		*pieces = resized;
+		*capacity = next_capacity;
+	}
+	(*pieces)[(*count)++] = node;
+	return true;
+}
+
+// A chain of string `+` (interpolated strings desugar to one) becomes adn_strconcat_n
+// calls that size the result once and copy each piece into it, instead of one
+// allocation per `+`. Chains longer than ADN_STRCONCAT_MAX_PIECES continue from the
+// previous call's result; unused argument slots get the empty literal. Returns false
+// when `node` must take the pairwise adn_strconcat path instead. A piece that fails to
+// lower is reported here and leaves *result NULL: the pieces before it were already
+// emitted, so lowering the expression again would repeat their side effects.
+static bool lower_string_concat_chain(Program* program, ASTNode* node, IRValue** result)
+{
+	ASTNode** pieces = NULL;
+	size_t count = 0;
+	size_t capacity = 0;
+	if (!collect_concat_pieces(program, node, &pieces, &count, &capacity) || count < 3)
+	{
+		free(pieces);
+		return false;
+	}
+
+	IRFunction* concat_fn = ensure_runtime_function(program, "adn_strconcat_n");
+	IRValue* joined = NULL;
+	size_t next = 0;
+	while (next < count)
+	{
+		IRValue* args[1 + ADN_STRCONCAT_MAX_PIECES];
+		size_t used = 0;
+		if (joined)
+		{
+			args[1 + used++] = joined;
+		}
+		while (used < ADN_STRCONCAT_MAX_PIECES && next < count)
+		{
+			ASTNode* piece = pieces[next++];
+			IRValue* value = lower_expression(program, piece);
+			value = lower_string_conversion(program, piece, value,
+			                                infer_expression_type(program, piece));
+			if (!value || !current_block)
+			{
+				fprintf(stderr, "Failed to lower string concatenation operand. (Error)\n");
+				free(pieces);
+				*result = NULL;
+				return true;
+			}
+			args[1 + used++] = value;
+		}
+		args[0] = ir_const_i64((int64_t)used);
+		for (size_t i = used; i < ADN_STRCONCAT_MAX_PIECES; i++)
+		{
+			args[1 + i] = ir_const_string(program->ir, "");
+		}
+		if (joined)
+		{
+			arc_track_temp(joined);
+		}
+		joined = ir_emit_call(current_block, concat_fn, args, 1 + ADN_STRCONCAT_MAX_PIECES);
+	}
+	free(pieces);
+	*result = joined;
+	return true;
+}
+
+// `a and b` / `a or b` only evaluate `b` when `a` does not already decide the
+// result; the two paths meet in a phi.
+static IRValue* lower_short_circuit(Program* program, ASTNode* node)
+{
+	bool is_and = strcmp(node->binary_op.op, "and") == 0;
+	IRValue* lhs = lower_expression(program, node->binary_op.left);
+	if (!lhs || !current_block)
+	{
+		fprintf(stderr, "Failed to lower logical operator operand. (Error)\n");
+		return NULL;
+	}
+	IRBlock* lhs_end = current_block;
+	IRBlock* rhs_b =
+	    ir_block_create_in_function(current_function, is_and ? "and_rhs" : "or_rhs");
+	IRBlock* merge_b =
+	    ir_block_create_in_function(current_function, is_and ? "and_merge" : "or_merge");
+	if (!rhs_b || !merge_b)
+	{
+		return NULL;
+	}
+	ir_emit_cbr(current_block, lhs, is_and ? rhs_b : merge_b, is_and ? merge_b : rhs_b);
+
+	current_block = rhs_b;
+	size_t rhs_mark = arc_temp_count;
+	IRValue* rhs = lower_truth_value(lower_expression(program, node->binary_op.right));
+	if (!rhs || !current_block)
+	{
+		fprintf(stderr, "Failed to lower logical operator operand. (Error)\n");
+		return NULL;
+	}
+	// Temporaries made on this path do not reach the merge block.
+	arc_release_temps(program, rhs_mark);
+	IRBlock* rhs_end = current_block;
+	ir_emit_br(current_block, merge_b);
+
+	current_block = merge_b;
+	IRValue* values[2] = {ir_const_i64(is_and ? 0 : 1), rhs};
+	IRBlock* blocks[2] = {lhs_end, rhs_end};
+	return ir_emit_phi(merge_b, ir_type_i64(), values, blocks, 2);
+}
+
+static IRValue* lower_expression_node(Program* program, ASTNode* node)
 {
 	switch (node->type)
 	{
@@ -1919,6 +3390,11 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 				fprintf(stderr, "Encountered identifier with no name. (Error)\n");
 				return NULL;
 			}
+			LoopStringBuilder* sb = find_loop_string_builder(name);
+			if (sb && current_block)
+			{
+				return lower_loop_string_read(program, sb);
+			}
 			SymEntry* e = sym_get(name);
 			if (e)
 			{
@@ -1963,6 +3439,12 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 				return NULL;
 			}
 
+			IRValue* formatted = NULL;
+			if (lower_literal_format_call(program, node, &formatted))
+			{
+				return formatted;
+			}
+
 			size_t nargs = node->call.arg_count;
 			ASTNode* callee_decl =
 			    find_function_declaration(program->ast_root, callee_name);
@@ -2147,6 +3629,18 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 				free(stub_name);
 			}
 
+			// integer arguments take the width of their parameter, so an i32 reaches an
+			// i64 parameter sign-extended rather than with undefined upper bits
+			IRValue* param = callee ? callee->params : NULL;
+			for (size_t i = 0; i < call_arg_count && param; ++i, param = param->next)
+			{
+				if (call_args[i] && ir_type_is_integer_like(call_args[i]->type) &&
+				    ir_type_is_integer_like(param->type))
+				{
+					call_args[i] = coerce_value_to_type(call_args[i], param->type);
+				}
+			}
+
 			IRValue* res =
 			    ir_emit_call(current_block, callee, call_args, call_arg_count);
 			if (call_args != args)
@@ -2239,6 +3733,19 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 				}
 			}
 
+			if (node->binary_op.op && (strcmp(node->binary_op.op, "and") == 0 ||
+			                           strcmp(node->binary_op.op, "or") == 0))
+			{
+				return lower_short_circuit(program, node);
+			}
+
+			IRValue* chain = NULL;
+			if (is_string_concat(program, node) &&
+			    lower_string_concat_chain(program, node, &chain))
+			{
+				return chain;
+			}
+
 			IRValue* lhs = lower_expression(program, node->binary_op.left);
 			IRValue* rhs = lower_expression(program, node->binary_op.right);
 			const char* left_type =
@@ -2267,10 +3774,13 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 				rhs = lower_string_conversion(program, node->binary_op.right, rhs,
 				                              right_type);
 				IRValue* cargs[2] = {lhs, rhs};
-				if (lhs && rhs)
-					return ir_emit_call(current_block, concat_fn, cargs, 2);
-				else
-					return ir_const_i64(0);
+				if (!lhs || !rhs)
+				{
+					fprintf(stderr, "Failed to lower string concatenation operand. "
+					                "(Error)\n");
+					return NULL;
+				}
+				return ir_emit_call(current_block, concat_fn, cargs, 2);
 			}
 			return ir_emit_binop(current_block, node->binary_op.op, lhs, rhs);
 		}
@@ -2340,7 +3850,10 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 					if (inner->type->kind == IR_T_F32)
 						inner = ir_emit_fpcvt(current_block, inner,
 						                      ir_type_f64());
-					return ir_emit_call(current_block, conv_fn, cargs, 1);
+					IRValue* converted =
+					    ir_emit_call(current_block, conv_fn, cargs, 1);
+					arc_track_temp(converted);
+					return converted;
 				}
 				else
 				{
@@ -2364,7 +3877,10 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 						ir_param_create(conv_fn, NULL, ir_type_i64());
 					}
 					IRValue* cargs[1] = {inner};
-					return ir_emit_call(current_block, conv_fn, cargs, 1);
+					IRValue* converted =
+					    ir_emit_call(current_block, conv_fn, cargs, 1);
+					arc_track_temp(converted);
+					return converted;
 				}
 			}
 			else if (dst_is_int && src_is_ptr)
@@ -2449,7 +3965,48 @@ IRValue* lower_expression(Program* program, ASTNode* node)
 	}
 }
 
+// Native functions declared `extern` hand back pointers they still own, unless they are
+// runtime entry points (`adn_*`), which follow the runtime's convention of returning a
+// new reference.
+static bool call_returns_borrowed(Program* program, ASTNode* call)
+{
+	ASTNode* decl = find_function_declaration(program->ast_root, call->call.callee);
+	if (!decl || !decl->func_decl.is_extern)
+	{
+		return false;
+	}
+	const char* symbol =
+	    decl->func_decl.link_name ? decl->func_decl.link_name : decl->func_decl.name;
+	return !symbol || strncmp(symbol, "adn_", 4) != 0;
+}
+
+// Pointers produced by anything but a variable read are new references.
+IRValue* lower_expression(Program* program, ASTNode* node)
+{
+	IRValue* value = lower_expression_node(program, node);
+	if (node->type == AST_CALL && node->call.callee && call_returns_borrowed(program, node))
+	{
+		return value;
+	}
+	if (node->type == AST_CALL || node->type == AST_BINARY_OP ||
+	    node->type == AST_OBJECT_LITERAL || node->type == AST_ARRAY_LITERAL ||
+	    node->type == AST_MEMBER_ACCESS || node->type == AST_ARRAY_ACCESS)
+	{
+		arc_track_temp(value);
+	}
+	return value;
+}
+
+static void lower_statement_node(Program* program, ASTNode* node);
+
 void lower_statement(Program* program, ASTNode* node)
+{
+	size_t temp_mark = arc_temp_count;
+	lower_statement_node(program, node);
+	arc_release_temps(program, temp_mark);
+}
+
+static void lower_statement_node(Program* program, ASTNode* node)
 {
 	if (!program || !node)
 	{
@@ -2475,7 +4032,10 @@ void lower_statement(Program* program, ASTNode* node)
 					ret_val =
 					    coerce_value_to_type(ret_val, current_function->return_type);
 				}
+				arc_own(program, ret_val);
 			}
+			arc_release_temps(program, 0);
+			arc_release_locals(program, 0);
 			if (current_block)
 			{
 				ir_emit_ret(current_block, ret_val);
@@ -2492,6 +4052,7 @@ void lower_statement(Program* program, ASTNode* node)
 		{
 			fprintf(stderr, "lower_statement: block with %zu statements\n",
 			        node->block.count);
+			size_t local_mark = arc_local_count;
 			for (size_t i = 0; i < node->block.count; i++)
 			{
 				if (block_is_terminated(current_block))
@@ -2500,6 +4061,8 @@ void lower_statement(Program* program, ASTNode* node)
 				}
 				lower_statement(program, node->block.statements[i]);
 			}
+			arc_release_locals(program, local_mark);
+			arc_local_count = local_mark;
 			break;
 		}
 		case AST_TYPE_DECLARATION:
@@ -2513,7 +4076,9 @@ void lower_statement(Program* program, ASTNode* node)
 				        "No current block to emit if statement into. (Error)\n");
 				return;
 			}
+			size_t cond_mark = arc_temp_count;
 			IRValue* cond = lower_expression(program, node->if_stmt.condition);
+			arc_release_temps(program, cond_mark);
 			IRBlock* then_b = ir_block_create_in_function(current_function, "then_b");
 			IRBlock* else_b =
 			    node->if_stmt.else_branch
@@ -2565,16 +4130,17 @@ void lower_statement(Program* program, ASTNode* node)
 			IRBlock* merge_b =
 			    ir_block_create_in_function(current_function, "while_merge");
 
+			size_t builder_mark = begin_loop_string_builders(program, node);
 			ir_emit_br(current_block, cond_b);
 
 			current_block = cond_b;
+			size_t cond_mark = arc_temp_count;
 			IRValue* cond = lower_expression(program, node->while_stmt.condition);
+			arc_release_temps(program, cond_mark);
 			ir_emit_cbr(current_block, cond, body_b, merge_b);
 
 			current_block = body_b;
-			loop_break_targets[loop_target_depth] = merge_b;
-			loop_continue_targets[loop_target_depth] = cond_b;
-			loop_target_depth++;
+			loop_target_push(merge_b, cond_b);
 			lower_statement(program, node->while_stmt.body);
 			if (loop_target_depth > 0)
 			{
@@ -2589,6 +4155,7 @@ void lower_statement(Program* program, ASTNode* node)
 			}
 
 			current_block = merge_b;
+			end_loop_string_builders(program, builder_mark);
 			break;
 		}
 		case AST_FOR_STMT:
@@ -2611,16 +4178,17 @@ void lower_statement(Program* program, ASTNode* node)
 			IRBlock* merge_b =
 			    ir_block_create_in_function(current_function, "for_merge");
 
+			size_t builder_mark = begin_loop_string_builders(program, node);
 			ir_emit_br(current_block, cond_b);
 
 			current_block = cond_b;
+			size_t cond_mark = arc_temp_count;
 			IRValue* cond = lower_expression(program, node->for_stmt.condition);
+			arc_release_temps(program, cond_mark);
 			ir_emit_cbr(current_block, cond, body_b, merge_b);
 
 			current_block = body_b;
-			loop_break_targets[loop_target_depth] = merge_b;
-			loop_continue_targets[loop_target_depth] = inc_b;
-			loop_target_depth++;
+			loop_target_push(merge_b, inc_b);
 			if (node->for_stmt.body)
 			{
 				lower_statement(program, node->for_stmt.body);
@@ -2648,12 +4216,15 @@ void lower_statement(Program* program, ASTNode* node)
 				}
 				else
 				{
+					size_t increment_mark = arc_temp_count;
 					lower_expression(program, node->for_stmt.increment);
+					arc_release_temps(program, increment_mark);
 				}
 			}
 			ir_emit_br(current_block, cond_b);
 
 			current_block = merge_b;
+			end_loop_string_builders(program, builder_mark);
 			break;
 		}
 		case AST_BREAK_STATEMENT:
@@ -2663,7 +4234,8 @@ void lower_statement(Program* program, ASTNode* node)
 				fprintf(stderr, "Break statement outside of loop. (Error)\n");
 				return;
 			}
-			ir_emit_br(current_block, loop_break_targets[loop_target_depth - 1]);
+			arc_release_locals(program, loop_targets[loop_target_depth - 1].arc_local_mark);
+			ir_emit_br(current_block, loop_targets[loop_target_depth - 1].break_target);
 			break;
 		}
 		case AST_CONTINUE_STATEMENT:
@@ -2673,7 +4245,8 @@ void lower_statement(Program* program, ASTNode* node)
 				fprintf(stderr, "Continue statement outside of loop. (Error)\n");
 				return;
 			}
-			ir_emit_br(current_block, loop_continue_targets[loop_target_depth - 1]);
+			arc_release_locals(program, loop_targets[loop_target_depth - 1].arc_local_mark);
+			ir_emit_br(current_block, loop_targets[loop_target_depth - 1].continue_target);
 			break;
 		}
 		case AST_VARIABLE_DECLARATION:
@@ -2721,6 +4294,7 @@ void lower_statement(Program* program, ASTNode* node)
 				    lower_expression(program, node->var_decl.initializer);
 				if (init_val)
 				{
+					arc_own(program, init_val);
 					ir_emit_store(current_block, alloca, init_val);
 				}
 				else
@@ -2738,6 +4312,10 @@ void lower_statement(Program* program, ASTNode* node)
 				IRValue* def = ir_const_i64(0);
 				ir_emit_store(current_block, alloca, def);
 			}
+			if (var_type->kind == IR_T_PTR)
+			{
+				arc_track_local(alloca);
+			}
 			IRValue* loaded = ir_emit_load(current_block, alloca);
 			(void)loaded;
 			break;
@@ -2766,6 +4344,12 @@ void lower_statement(Program* program, ASTNode* node)
 				        "(Error)\n");
 				return;
 			}
+			LoopStringBuilder* sb = find_loop_string_builder(aname);
+			if (sb)
+			{
+				lower_loop_string_assignment(program, sb, node->assignment.value);
+				break;
+			}
 			SymEntry* se = sym_get(aname);
 			if (!se || !se->is_address)
 			{
@@ -2777,7 +4361,12 @@ void lower_statement(Program* program, ASTNode* node)
 				return;
 			}
 			IRValue* val = lower_expression(program, node->assignment.value);
-			if (val)
+			if (val && ir_value_is_pointer(val))
+			{
+				arc_assign(program, se->value, val);
+				sym_put(aname, se->type_name, se->value, 1);
+			}
+			else if (val)
 			{
 				ir_emit_store(current_block, se->value, val);
 				sym_put(aname, se->type_name, se->is_address ? se->value : val,
@@ -2848,8 +4437,11 @@ static void emit_global_inits(IRBlock* block, ASTNode* root, Program* program,
 				{
 					current_function = init_func;
 					current_block = block;
+					size_t temp_mark = arc_temp_count;
 					init_val =
 					    lower_expression(program, decl->var_decl.initializer);
+					arc_own(program, init_val);
+					arc_release_temps(program, temp_mark);
 					current_function = NULL;
 					current_block = NULL;
 				}
@@ -3117,6 +4709,9 @@ void lower_program(Program* program)
 				continue;
 			}
 			current_function = ir_func;
+			arc_temp_count = 0;
+			arc_local_count = 0;
+			loop_string_builder_count = 0;
 			IRBlock* entry_block = ir_block_create_in_function(ir_func, "entry");
 			if (!entry_block)
 			{
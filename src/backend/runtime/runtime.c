@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,426 @@ int64_t adn_powi(int64_t base, int64_t exp)
 	return result;
 }
 
+// Every heap value the runtime hands out (strings, arrays, objects) is preceded by an
+// AdnRefCount, so compiled code can share it and free it when the last reference goes.
+// A refcount of ADN_REFCOUNT_STATIC marks values that are never freed (literals, the
+// shared one-byte strings); a count that would overflow turns a value static, too.
+typedef struct
+{
+	uint32_t refcount;
+	uint32_t magic;
+} AdnRefCount;
+
+#define ADN_ARRAY_MAGIC 0x41444152u
+#define ADN_OBJECT_MAGIC 0x4144424fu
+#define ADN_BUILDER_MAGIC 0x41444242u
+#define ADN_NATIVE_MAGIC 0x4144564eu
+
+// Strings are laid out as an AdnStringHeader followed by the NUL-terminated bytes and
+// handed around as a pointer to the bytes, so C code still sees a plain char*. Strings
+// from elsewhere have no header; adn_ref_of tells the two apart through the registry of
+// runtime values and everything falls back to strlen for them.
+typedef struct
+{
+	uint64_t hash;
+	int64_t length;
+	AdnRefCount ref;
+} AdnStringHeader;
+
+_Static_assert(sizeof(AdnStringHeader) == ADN_STRING_HEADER_SIZE,
+               "AdnStringHeader layout does not match ADN_STRING_HEADER_SIZE");
+
+// Arrays, objects, string builders and native values carry a 16-byte prefix, which keeps
+// the value itself 16-aligned.
+typedef struct
+{
+	// The destructor of a native value; unused by the other kinds.
+	uint64_t destroy;
+	AdnRefCount ref;
+} AdnHeapHeader;
+
+typedef struct
+{
+	_Alignas(16) AdnStringHeader header;
+	char text[8];
+} AdnStaticString;
+
+#define ADN_STATIC_STRING(length, hash, ...)                                                  \
+	{{(hash), (length), {ADN_REFCOUNT_STATIC, ADN_STRING_MAGIC}}, {__VA_ARGS__}}
+#define ADN_BYTE_STRING(c)                                                                    \
+	ADN_STATIC_STRING(1, (14695981039346656037ULL ^ (uint64_t)(c)) * 1099511628211ULL,      \
+	                  (char)(c), 0)
+#define ADN_BYTE_STRINGS_4(c)                                                                 \
+	ADN_BYTE_STRING(c), ADN_BYTE_STRING((c) + 1), ADN_BYTE_STRING((c) + 2),                  \
+	    ADN_BYTE_STRING((c) + 3)
+#define ADN_BYTE_STRINGS_16(c)                                                                \
+	ADN_BYTE_STRINGS_4(c), ADN_BYTE_STRINGS_4((c) + 4), ADN_BYTE_STRINGS_4((c) + 8),         \
+	    ADN_BYTE_STRINGS_4((c) + 12)
+#define ADN_BYTE_STRINGS_64(c)                                                                \
+	ADN_BYTE_STRINGS_16(c), ADN_BYTE_STRINGS_16((c) + 16), ADN_BYTE_STRINGS_16((c) + 32),    \
+	    ADN_BYTE_STRINGS_16((c) + 48)
+
+// Shared one-byte strings for char_at/from_code, and the empty string.
+static AdnStaticString adn_byte_strings[256] = {ADN_BYTE_STRINGS_64(0), ADN_BYTE_STRINGS_64(64),
+                                                ADN_BYTE_STRINGS_64(128),
+                                                ADN_BYTE_STRINGS_64(192)};
+
+static AdnStaticString adn_empty_string = ADN_STATIC_STRING(0, 14695981039346656037ULL, 0);
+
+// Ownership is tracked exactly instead of being read from memory in front of a pointer
+// that may not be ours: one bit per 8-byte address marks where a live runtime value (a
+// heap value or a registered literal) starts. The bits are kept per 16MB region of the
+// address space, found through a small open-addressing table; regions are never freed.
+#define ADN_OWNED_REGION_SHIFT 24
+#define ADN_OWNED_REGION_WORDS ((size_t)1 << (ADN_OWNED_REGION_SHIFT - 3 - 6))
+
+typedef struct
+{
+	uintptr_t region;
+	uint64_t* bits;
+} AdnOwnedRegion;
+
+static AdnOwnedRegion* adn_owned_regions = NULL;
+static size_t adn_owned_region_count = 0;
+static size_t adn_owned_region_capacity = 0;
+// Direct-mapped cache in front of the table; literals and heap values usually live in
+// different regions, so one entry alone would keep missing.
+#define ADN_OWNED_CACHE_SIZE 8
+static AdnOwnedRegion adn_owned_cache[ADN_OWNED_CACHE_SIZE];
+
+static size_t adn_owned_region_slot(uintptr_t region, size_t capacity)
+{
+	uint64_t hash = (uint64_t)region * 0x9e3779b97f4a7c15ULL;
+	return (size_t)(hash >> 32) & (capacity - 1);
+}
+
+static int adn_owned_grow(void)
+{
+	size_t next_capacity = adn_owned_region_capacity == 0 ? 16 : adn_owned_region_capacity * 2;
+	AdnOwnedRegion* resized = calloc(next_capacity, sizeof(AdnOwnedRegion));
+	if (!resized)
+	{
+		return -1;
+	}
+	for (size_t i = 0; i < adn_owned_region_capacity; i++)
+	{
+		if (adn_owned_regions[i].bits)
+		{
+			size_t slot = adn_owned_region_slot(adn_owned_regions[i].region, next_capacity);
+			while (resized[slot].bits)
+			{
+				slot = (slot + 1) & (next_capacity - 1);
+			}
+			resized[slot] = adn_owned_regions[i];
+		}
+	}
+	free(adn_owned_regions);
+	adn_owned_regions = resized;
+	adn_owned_region_capacity = next_capacity;
+	return 0;
+}
+
+// The bitmap of the region holding `address`; with `create`, a missing one is added.
+static uint64_t* adn_owned_bits(uintptr_t address, int create)
+{
+	uintptr_t region = address >> ADN_OWNED_REGION_SHIFT;
+	AdnOwnedRegion* cached = &adn_owned_cache[region & (ADN_OWNED_CACHE_SIZE - 1)];
+	if (cached->bits && cached->region == region)
+	{
+		return cached->bits;
+	}
+	size_t slot = 0;
+	if (adn_owned_region_capacity > 0)
+	{
+		slot = adn_owned_region_slot(region, adn_owned_region_capacity);
+		while (adn_owned_regions[slot].bits)
+		{
+			if (adn_owned_regions[slot].region == region)
+			{
+				*cached = adn_owned_regions[slot];
+				return cached->bits;
+			}
+			slot = (slot + 1) & (adn_owned_region_capacity - 1);
+		}
+	}
+	if (!create)
+	{
+		return NULL;
+	}
+	if ((adn_owned_region_count + 1) * 2 > adn_owned_region_capacity)
+	{
+		if (adn_owned_grow() != 0)
+		{
+			return NULL;
+		}
+		slot = adn_owned_region_slot(region, adn_owned_region_capacity);
+		while (adn_owned_regions[slot].bits)
+		{
+			slot = (slot + 1) & (adn_owned_region_capacity - 1);
+		}
+	}
+	uint64_t* bits = calloc(ADN_OWNED_REGION_WORDS, sizeof(uint64_t));
+	if (!bits)
+	{
+		return NULL;
+	}
+	adn_owned_regions[slot].region = region;
+	adn_owned_regions[slot].bits = bits;
+	adn_owned_region_count++;
+	*cached = adn_owned_regions[slot];
+	return bits;
+}
+
+static size_t adn_owned_index(uintptr_t address)
+{
+	return (size_t)(address >> 3) & (ADN_OWNED_REGION_WORDS * 64 - 1);
+}
+
+static int adn_owned_contains(uintptr_t address)
+{
+	if ((address & 7) != 0)
+	{
+		return 0;
+	}
+	uint64_t* bits = adn_owned_bits(address, 0);
+	size_t index = adn_owned_index(address);
+	return bits && ((bits[index >> 6] >> (index & 63)) & 1);
+}
+
+static int adn_owned_add(uintptr_t address)
+{
+	uint64_t* bits = (address & 7) == 0 ? adn_owned_bits(address, 1) : NULL;
+	if (!bits)
+	{
+		return -1;
+	}
+	size_t index = adn_owned_index(address);
+	bits[index >> 6] |= UINT64_C(1) << (index & 63);
+	return 0;
+}
+
+static void adn_owned_remove(uintptr_t address)
+{
+	uint64_t* bits = adn_owned_bits(address, 0);
+	if (bits)
+	{
+		size_t index = adn_owned_index(address);
+		bits[index >> 6] &= ~(UINT64_C(1) << (index & 63));
+	}
+}
+
+void adn_register_literals(const char* const* literals, int64_t count)
+{
+	for (int64_t i = 0; i < count; i++)
+	{
+		adn_owned_add((uintptr_t)literals[i]);
+	}
+}
+
+static int adn_is_static_string(uintptr_t address)
+{
+	uintptr_t bytes = (uintptr_t)adn_byte_strings;
+	return (address >= bytes && address < bytes + sizeof(adn_byte_strings)) ||
+	       address == (uintptr_t)adn_empty_string.text;
+}
+
+// The reference count in front of `value`, or NULL when it is not a runtime value.
+static AdnRefCount* adn_ref_of(const void* value)
+{
+	uintptr_t address = (uintptr_t)value;
+	if (!value || (!adn_is_static_string(address) && !adn_owned_contains(address)))
+	{
+		return NULL;
+	}
+	return (AdnRefCount*)(void*)(address - sizeof(AdnRefCount));
+}
+
+static AdnStringHeader* adn_string_header(const char* s)
+{
+	AdnRefCount* ref = adn_ref_of(s);
+	if (!ref || ref->magic != ADN_STRING_MAGIC)
+	{
+		return NULL;
+	}
+	return (AdnStringHeader*)(void*)(s - sizeof(AdnStringHeader));
+}
+
+static void* adn_heap_alloc(size_t size, uint32_t magic)
+{
+	AdnHeapHeader* header = calloc(1, sizeof(AdnHeapHeader) + size);
+	if (!header)
+	{
+		return NULL;
+	}
+	if (adn_owned_add((uintptr_t)(header + 1)) != 0)
+	{
+		free(header);
+		return NULL;
+	}
+	header->ref.refcount = 1;
+	header->ref.magic = magic;
+	return header + 1;
+}
+
+static void adn_array_destroy(void* array);
+
+static void adn_object_destroy(void* object);
+
+static void adn_builder_destroy(void* builder);
+
+void* adn_retain(void* value)
+{
+	AdnRefCount* ref = adn_ref_of(value);
+	if (ref && ref->refcount != ADN_REFCOUNT_STATIC)
+	{
+		ref->refcount++;
+	}
+	return value;
+}
+
+void adn_release(void* value)
+{
+	AdnRefCount* ref = adn_ref_of(value);
+	if (!ref || ref->refcount == ADN_REFCOUNT_STATIC || --ref->refcount > 0)
+	{
+		return;
+	}
+	adn_owned_remove((uintptr_t)value);
+	if (ref->magic == ADN_STRING_MAGIC)
+	{
+		free((char*)value - sizeof(AdnStringHeader));
+		return;
+	}
+	if (ref->magic == ADN_ARRAY_MAGIC)
+	{
+		adn_array_destroy(value);
+	}
+	else if (ref->magic == ADN_BUILDER_MAGIC)
+	{
+		adn_builder_destroy(value);
+	}
+	else if (ref->magic == ADN_NATIVE_MAGIC)
+	{
+		AdnHeapHeader* header = (AdnHeapHeader*)value - 1;
+		void (*destroy)(void*) = (void (*)(void*))(uintptr_t)header->destroy;
+		if (destroy)
+		{
+			destroy(value);
+		}
+	}
+	else
+	{
+		adn_object_destroy(value);
+	}
+	free((char*)value - sizeof(AdnHeapHeader));
+}
+
+void* adn_native_create(int64_t size, void (*destroy)(void*))
+{
+	void* value = adn_heap_alloc(size > 0 ? (size_t)size : 0, ADN_NATIVE_MAGIC);
+	if (value)
+	{
+		((AdnHeapHeader*)value - 1)->destroy = (uint64_t)(uintptr_t)destroy;
+	}
+	return value;
+}
+
+static size_t adn_string_len(const char* s)
+{
+	if (!s)
+	{
+		return 0;
+	}
+	AdnStringHeader* header = adn_string_header(s);
+	return header ? (size_t)header->length : strlen(s);
+}
+
+static uint64_t adn_string_hash(const char* s)
+{
+	AdnStringHeader* header = adn_string_header(s);
+	if (!header)
+	{
+		return adn_hash_key(s);
+	}
+	if (header->hash == 0 && header->ref.refcount != ADN_REFCOUNT_STATIC)
+	{
+		header->hash = adn_hash_key(s);
+	}
+	return header->hash ? header->hash : adn_hash_key(s);
+}
+
+// A new string of `length` bytes; the caller fills them in.
+static char* adn_string_alloc(size_t length)
+{
+	if (length == 0)
+	{
+		return adn_empty_string.text;
+	}
+	AdnStringHeader* header = malloc(sizeof(AdnStringHeader) + length + 1);
+	if (!header)
+	{
+		return NULL;
+	}
+	char* text = (char*)(header + 1);
+	if (adn_owned_add((uintptr_t)text) != 0)
+	{
+		free(header);
+		return NULL;
+	}
+	header->hash = 0;
+	header->length = (int64_t)length;
+	header->ref.refcount = 1;
+	header->ref.magic = ADN_STRING_MAGIC;
+	text[length] = '\0';
+	return text;
+}
+
+static char* adn_string_from_bytes(const char* bytes, size_t length)
+{
+	if (length == 1)
+	{
+		return adn_byte_strings[(unsigned char)bytes[0]].text;
+	}
+	char* text = adn_string_alloc(length);
+	if (text && length > 0)
+	{
+		memcpy(text, bytes, length);
+	}
+	return text;
+}
+
+char* adn_string_copy_bytes(const char* bytes, int64_t length)
+{
+	return bytes && length > 0 ? adn_string_from_bytes(bytes, (size_t)length)
+	                           : adn_empty_string.text;
+}
+
+// Strings are immutable, so a runtime string is shared by taking a reference; only
+// strings from outside the runtime are copied.
+static char* adn_string_copy(const char* s)
+{
+	if (!s)
+	{
+		return adn_empty_string.text;
+	}
+	if (adn_string_header(s))
+	{
+		return adn_retain((void*)s);
+	}
+	return adn_string_from_bytes(s, strlen(s));
+}
+
+char* adn_string_adopt(char* text)
+{
+	if (!text || adn_ref_of(text))
+	{
+		return text ? text : adn_empty_string.text;
+	}
+	char* result = adn_string_from_bytes(text, strlen(text));
+	free(text);
+	return result;
+}
+
 char* adn_strconcat(const char* s1, const char* s2)
 {
 	if (!s1 || !s2)
@@ -39,18 +460,58 @@ char* adn_strconcat(const char* s1, const char* s2)
 		return NULL;
 	}
 
-	size_t len1 = strlen(s1);
-	size_t len2 = strlen(s2);
-	char* result = (char*)malloc(len1 + len2 + 1);
+	size_t len1 = adn_string_len(s1);
+	size_t len2 = adn_string_len(s2);
+	char* result = adn_string_alloc(len1 + len2);
 
 	if (!result)
 	{
 		return NULL;
 	}
 
-	strcpy(result, s1);
-	strcat(result, s2);
+	if (len1 + len2 > 0)
+	{
+		memcpy(result, s1, len1);
+		memcpy(result + len1, s2, len2);
+	}
+
+	return result;
+}
+
+char* adn_strconcat_n(int64_t count, const char* s0, const char* s1, const char* s2,
+                      const char* s3, const char* s4, const char* s5, const char* s6,
+                      const char* s7)
+{
+	const char* pieces[ADN_STRCONCAT_MAX_PIECES] = {s0, s1, s2, s3, s4, s5, s6, s7};
+	size_t lengths[ADN_STRCONCAT_MAX_PIECES];
+	size_t piece_count = count < 0 ? 0 : (size_t)count;
+	if (piece_count > ADN_STRCONCAT_MAX_PIECES)
+	{
+		piece_count = ADN_STRCONCAT_MAX_PIECES;
+	}
+
+	size_t total = 0;
+	for (size_t i = 0; i < piece_count; i++)
+	{
+		if (!pieces[i])
+		{
+			return NULL;
+		}
+		lengths[i] = adn_string_len(pieces[i]);
+		total += lengths[i];
+	}
 
+	char* result = adn_string_alloc(total);
+	if (!result || total == 0)
+	{
+		return result;
+	}
+	size_t offset = 0;
+	for (size_t i = 0; i < piece_count; i++)
+	{
+		memcpy(result + offset, pieces[i], lengths[i]);
+		offset += lengths[i];
+	}
 	return result;
 }
 
@@ -62,13 +523,7 @@ char* adn_i32_to_string(int64_t val)
 	{
 		return NULL;
 	}
-	char* result = (char*)malloc((size_t)len + 1);
-	if (!result)
-	{
-		return NULL;
-	}
-	memcpy(result, buf, (size_t)len + 1);
-	return result;
+	return adn_string_from_bytes(buf, (size_t)len);
 }
 
 int64_t adn_string_to_i32(const char* s)
@@ -88,13 +543,7 @@ char* adn_f64_to_string(double val)
 	{
 		return NULL;
 	}
-	char* result = (char*)malloc((size_t)len + 1);
-	if (!result)
-	{
-		return NULL;
-	}
-	memcpy(result, buf, (size_t)len + 1);
-	return result;
+	return adn_string_from_bytes(buf, (size_t)len);
 }
 
 double adn_string_to_f64(const char* s)
@@ -108,45 +557,21 @@ double adn_string_to_f64(const char* s)
 
 int64_t adn_string_length(const char* s)
 {
-	if (!s)
-	{
-		return 0;
-	}
-	return (int64_t)strlen(s);
+	return (int64_t)adn_string_len(s);
 }
 
 char* adn_string_char_at(const char* s, int64_t index)
 {
-	if (!s || index < 0)
+	if (!s || index < 0 || (size_t)index >= adn_string_len(s))
 	{
-		return strdup("");
+		return adn_empty_string.text;
 	}
-
-	size_t length = strlen(s);
-	if ((size_t)index >= length)
-	{
-		return strdup("");
-	}
-
-	char* result = (char*)malloc(2);
-	if (!result)
-	{
-		return NULL;
-	}
-	result[0] = s[index];
-	result[1] = '\0';
-	return result;
+	return adn_byte_strings[(unsigned char)s[index]].text;
 }
 
 int64_t adn_string_code_at(const char* s, int64_t index)
 {
-	if (!s || index < 0)
-	{
-		return -1;
-	}
-
-	size_t length = strlen(s);
-	if ((size_t)index >= length)
+	if (!s || index < 0 || (size_t)index >= adn_string_len(s))
 	{
 		return -1;
 	}
@@ -158,17 +583,9 @@ char* adn_string_from_code(int64_t code)
 {
 	if (code < 0 || code > 255)
 	{
-		return strdup("");
-	}
-
-	char* result = (char*)malloc(2);
-	if (!result)
-	{
-		return NULL;
+		return adn_empty_string.text;
 	}
-	result[0] = (char)code;
-	result[1] = '\0';
-	return result;
+	return adn_byte_strings[code].text;
 }
 
 typedef struct
@@ -178,6 +595,8 @@ typedef struct
 	size_t capacity;
 } AdnStringBuilder;
 
+// The builder keeps room for a string header in front of `data`, so finishing it
+// hands the buffer over without copying.
 static void adn_builder_init(AdnStringBuilder* builder)
 {
 	if (!builder)
@@ -186,7 +605,8 @@ static void adn_builder_init(AdnStringBuilder* builder)
 	}
 	builder->capacity = 64;
 	builder->length = 0;
-	builder->data = calloc(builder->capacity, 1);
+	char* raw = calloc(sizeof(AdnStringHeader) + builder->capacity, 1);
+	builder->data = raw ? raw + sizeof(AdnStringHeader) : NULL;
 }
 
 static void adn_builder_reserve(AdnStringBuilder* builder, size_t additional)
@@ -204,12 +624,13 @@ static void adn_builder_reserve(AdnStringBuilder* builder, size_t additional)
 	{
 		next_capacity *= 2;
 	}
-	char* resized = realloc(builder->data, next_capacity);
+	char* raw = builder->data ? builder->data - sizeof(AdnStringHeader) : NULL;
+	char* resized = realloc(raw, sizeof(AdnStringHeader) + next_capacity);
 	if (!resized)
 	{
 		return;
 	}
-	builder->data = resized;
+	builder->data = resized + sizeof(AdnStringHeader);
 	builder->capacity = next_capacity;
 }
 
@@ -231,7 +652,7 @@ static void adn_builder_append(AdnStringBuilder* builder, const char* text)
 	{
 		return;
 	}
-	adn_builder_append_n(builder, text, strlen(text));
+	adn_builder_append_n(builder, text, adn_string_len(text));
 }
 
 static void adn_builder_append_char(AdnStringBuilder* builder, char ch)
@@ -249,15 +670,73 @@ static char* adn_builder_finish(AdnStringBuilder* builder)
 	}
 	if (!builder->data)
 	{
-		return strdup("");
+		return adn_empty_string.text;
 	}
 	char* result = builder->data;
+	if (adn_owned_add((uintptr_t)result) != 0)
+	{
+		return NULL;
+	}
+	AdnStringHeader* header = (AdnStringHeader*)(void*)(result - sizeof(AdnStringHeader));
+	header->hash = 0;
+	header->length = (int64_t)builder->length;
+	header->ref.refcount = 1;
+	header->ref.magic = ADN_STRING_MAGIC;
 	builder->data = NULL;
 	builder->length = 0;
 	builder->capacity = 0;
 	return result;
 }
 
+static void adn_builder_destroy(void* builder)
+{
+	AdnStringBuilder* sb = builder;
+	if (sb->data)
+	{
+		free(sb->data - sizeof(AdnStringHeader));
+	}
+}
+
+void* adn_string_builder_create(void)
+{
+	return adn_heap_alloc(sizeof(AdnStringBuilder), ADN_BUILDER_MAGIC);
+}
+
+void adn_string_builder_append(void* builder, const char* text)
+{
+	adn_builder_append(builder, text);
+}
+
+int64_t adn_string_builder_length(void* builder)
+{
+	return builder ? (int64_t)((AdnStringBuilder*)builder)->length : 0;
+}
+
+void adn_string_builder_clear(void* builder)
+{
+	AdnStringBuilder* sb = builder;
+	if (sb && sb->data)
+	{
+		sb->length = 0;
+		sb->data[0] = '\0';
+	}
+}
+
+char* adn_string_builder_to_string(void* builder)
+{
+	AdnStringBuilder* sb = builder;
+	if (!sb || !sb->data)
+	{
+		return adn_empty_string.text;
+	}
+	return adn_string_from_bytes(sb->data, sb->length);
+}
+
+char* adn_string_builder_finish(void* builder)
+{
+	return adn_builder_finish(builder);
+}
+
 typedef enum
 {
 	ADN_VALUE_I64,
@@ -282,22 +761,54 @@ typedef struct
 {
 	char* key;
 	AdnValue value;
+	uint64_t hash;
 } AdnObjectEntry;
 
+// `shape` is the compiler's layout descriptor for objects built from a record
+// literal. While it is set, entries[i] holds the i-th field of that shape with
+// the storage kind the shape names, so compiled code may read it directly.
+// Entries always stay in insertion order; once an object grows past
+// ADN_OBJECT_INDEX_THRESHOLD keys, `index` maps hash slots to entry positions + 1.
 typedef struct
 {
 	AdnObjectEntry* entries;
 	size_t count;
 	size_t capacity;
+	const char* shape;
+	uint32_t* index;
+	size_t index_capacity;
 } AdnObject;
 
+#define ADN_OBJECT_INDEX_THRESHOLD 8
+
+_Static_assert(offsetof(AdnObject, entries) == ADN_OBJECT_ENTRIES_OFFSET,
+               "AdnObject layout does not match ADN_OBJECT_ENTRIES_OFFSET");
+_Static_assert(offsetof(AdnObject, shape) == ADN_OBJECT_SHAPE_OFFSET,
+               "AdnObject layout does not match ADN_OBJECT_SHAPE_OFFSET");
+_Static_assert(sizeof(AdnObjectEntry) == ADN_OBJECT_ENTRY_SIZE,
+               "AdnObjectEntry layout does not match ADN_OBJECT_ENTRY_SIZE");
+_Static_assert(offsetof(AdnObjectEntry, value) + offsetof(AdnValue, data) ==
+                   ADN_OBJECT_ENTRY_DATA_OFFSET,
+               "AdnObjectEntry layout does not match ADN_OBJECT_ENTRY_DATA_OFFSET");
+
+// `items` holds bare int64_t / double elements while every value stored so far had
+// that kind, and boxed AdnValues otherwise. A new array picks its storage from the
+// first value stored into it; a mismatched value later boxes the whole array.
 typedef struct
 {
-	AdnValue* items;
+	void* items;
 	size_t count;
 	size_t capacity;
+	int64_t storage;
 } AdnArray;
 
+_Static_assert(offsetof(AdnArray, items) == ADN_ARRAY_ITEMS_OFFSET,
+               "AdnArray layout does not match ADN_ARRAY_ITEMS_OFFSET");
+_Static_assert(offsetof(AdnArray, count) == ADN_ARRAY_COUNT_OFFSET,
+               "AdnArray layout does not match ADN_ARRAY_COUNT_OFFSET");
+_Static_assert(offsetof(AdnArray, storage) == ADN_ARRAY_STORAGE_OFFSET,
+               "AdnArray layout does not match ADN_ARRAY_STORAGE_OFFSET");
+
 static void adn_value_release(AdnValue* value)
 {
 	if (!value)
@@ -306,9 +817,14 @@ static void adn_value_release(AdnValue* value)
 	}
 	if (value->kind == ADN_VALUE_STRING)
 	{
-		free(value->data.string);
+		adn_release(value->data.string);
 		value->data.string = NULL;
 	}
+	else if (value->kind == ADN_VALUE_PTR)
+	{
+		adn_release(value->data.ptr);
+		value->data.ptr = NULL;
+	}
 }
 
 static AdnValue adn_value_from_i64(int64_t value)
@@ -331,7 +847,7 @@ static AdnValue adn_value_from_string(const char* value)
 {
 	AdnValue wrapped = {0};
 	wrapped.kind = ADN_VALUE_STRING;
-	wrapped.data.string = value ? strdup(value) : strdup("");
+	wrapped.data.string = adn_string_copy(value);
 	return wrapped;
 }
 
@@ -339,7 +855,7 @@ static AdnValue adn_value_from_ptr(void* value)
 {
 	AdnValue wrapped = {0};
 	wrapped.kind = ADN_VALUE_PTR;
-	wrapped.data.ptr = value;
+	wrapped.data.ptr = adn_retain(value);
 	return wrapped;
 }
 
@@ -364,6 +880,115 @@ static AdnValue adn_value_clone(const AdnValue* value)
 	return adn_value_from_i64(value->data.i64);
 }
 
+static int64_t adn_value_as_i64(const AdnValue* value)
+{
+	if (!value)
+	{
+		return 0;
+	}
+	if (value->kind == ADN_VALUE_F64)
+	{
+		return (int64_t)value->data.f64;
+	}
+	if (value->kind == ADN_VALUE_STRING)
+	{
+		return value->data.string ? strtoll(value->data.string, NULL, 10) : 0;
+	}
+	if (value->kind == ADN_VALUE_PTR)
+	{
+		return (int64_t)(intptr_t)value->data.ptr;
+	}
+	return value->data.i64;
+}
+
+static double adn_value_as_f64(const AdnValue* value)
+{
+	if (!value)
+	{
+		return 0.0;
+	}
+	if (value->kind == ADN_VALUE_I64)
+	{
+		return (double)value->data.i64;
+	}
+	if (value->kind == ADN_VALUE_STRING)
+	{
+		return value->data.string ? strtod(value->data.string, NULL) : 0.0;
+	}
+	return value->data.f64;
+}
+
+// A reference to the stored string, or a new string converted from any other kind, with
+// `ptr_text` standing in for pointers. The caller owns the result either way.
+static char* adn_value_as_string(const AdnValue* value, const char* ptr_text)
+{
+	if (!value)
+	{
+		return adn_string_copy("");
+	}
+	if (value->kind == ADN_VALUE_STRING)
+	{
+		return adn_string_copy(value->data.string);
+	}
+	if (value->kind == ADN_VALUE_I64)
+	{
+		return adn_i32_to_string(value->data.i64);
+	}
+	if (value->kind == ADN_VALUE_F64)
+	{
+		return adn_f64_to_string(value->data.f64);
+	}
+	return adn_string_copy(ptr_text);
+}
+
+static void* adn_value_as_ptr(const AdnValue* value)
+{
+	if (!value || value->kind != ADN_VALUE_PTR)
+	{
+		return NULL;
+	}
+	return adn_retain(value->data.ptr);
+}
+
+static size_t adn_array_element_size(const AdnArray* array)
+{
+	if (array->storage == ADN_ARRAY_STORAGE_I64 || array->storage == ADN_ARRAY_STORAGE_F64)
+	{
+		return sizeof(int64_t);
+	}
+	return sizeof(AdnValue);
+}
+
+// The element at `index` as a value; boxed strings are borrowed, not copied.
+static AdnValue adn_array_load(const AdnArray* array, size_t index)
+{
+	if (array->storage == ADN_ARRAY_STORAGE_I64)
+	{
+		return adn_value_from_i64(((int64_t*)array->items)[index]);
+	}
+	if (array->storage == ADN_ARRAY_STORAGE_F64)
+	{
+		return adn_value_from_f64(((double*)array->items)[index]);
+	}
+	return ((AdnValue*)array->items)[index];
+}
+
+static void adn_array_store(AdnArray* array, size_t index, AdnValue value)
+{
+	if (array->storage == ADN_ARRAY_STORAGE_I64)
+	{
+		((int64_t*)array->items)[index] = value.data.i64;
+	}
+	else if (array->storage == ADN_ARRAY_STORAGE_F64)
+	{
+		((double*)array->items)[index] = value.data.f64;
+	}
+	else
+	{
+		((AdnValue*)array->items)[index] = value;
+	}
+}
+
 static void adn_object_reserve(AdnObject* object, size_t needed)
 {
 	if (!object || object->capacity >= needed)
@@ -389,12 +1014,14 @@ static AdnArray* adn_array_cast(void* array)
 	return (AdnArray*)array;
 }
 
-static char* adn_value_to_string_spec(const AdnValue* value, char spec)
+// Appends `value` as the format spec `spec` (d, i, u, f, c, p or s) would show it.
+static void adn_builder_append_value(AdnStringBuilder* builder, const AdnValue* value, char spec)
 {
 	char buffer[128];
+	int length = 0;
 	if (!value)
 	{
-		return strdup("");
+		return;
 	}
 	switch (spec)
 	{
@@ -419,8 +1046,8 @@ static char* adn_value_to_string_spec(const AdnValue* value, char spec)
 			{
 				integer_value = (long long)value->data.i64;
 			}
-			snprintf(buffer, sizeof(buffer), "%lld", integer_value);
-			return strdup(buffer);
+			length = snprintf(buffer, sizeof(buffer), "%lld", integer_value);
+			break;
 		}
 		case 'u':
 		{
@@ -442,8 +1069,8 @@ static char* adn_value_to_string_spec(const AdnValue* value, char spec)
 			{
 				integer_value = (unsigned long long)value->data.i64;
 			}
-			snprintf(buffer, sizeof(buffer), "%llu", integer_value);
-			return strdup(buffer);
+			length = snprintf(buffer, sizeof(buffer), "%llu", integer_value);
+			break;
 		}
 		case 'f':
 		{
@@ -461,30 +1088,33 @@ static char* adn_value_to_string_spec(const AdnValue* value, char spec)
 			{
 				float_value = value->data.f64;
 			}
-			snprintf(buffer, sizeof(buffer), "%g", float_value);
-			return strdup(buffer);
+			length = snprintf(buffer, sizeof(buffer), "%g", float_value);
+			break;
 		}
 		case 'c':
 		{
-			char out[2] = {0, 0};
-			if (value->kind == ADN_VALUE_STRING && value->data.string &&
-			    value->data.string[0] != '\0')
+			char out = 0;
+			if (value->kind == ADN_VALUE_STRING && value->data.string)
 			{
-				out[0] = value->data.string[0];
+				out = value->data.string[0];
 			}
 			else if (value->kind == ADN_VALUE_F64)
 			{
-				out[0] = (char)((int)value->data.f64);
+				out = (char)((int)value->data.f64);
 			}
 			else if (value->kind == ADN_VALUE_PTR)
 			{
-				out[0] = (char)(intptr_t)value->data.ptr;
+				out = (char)(intptr_t)value->data.ptr;
 			}
 			else
 			{
-				out[0] = (char)value->data.i64;
+				out = (char)value->data.i64;
 			}
-			return strdup(out);
+			if (out != 0)
+			{
+				adn_builder_append_char(builder, out);
+			}
+			return;
 		}
 		case 'p':
 		{
@@ -497,25 +1127,35 @@ static char* adn_value_to_string_spec(const AdnValue* value, char spec)
 			{
 				pointer_value = (void*)(intptr_t)value->data.i64;
 			}
-			snprintf(buffer, sizeof(buffer), "%p", pointer_value);
-			return strdup(buffer);
+			length = snprintf(buffer, sizeof(buffer), "%p", pointer_value);
+			break;
 		}
 		case 's':
 		default:
 			if (value->kind == ADN_VALUE_STRING)
 			{
-				return strdup(value->data.string ? value->data.string : "");
+				adn_builder_append(builder, value->data.string);
+				return;
 			}
 			if (value->kind == ADN_VALUE_F64)
 			{
-				return adn_f64_to_string(value->data.f64);
+				length = snprintf(buffer, sizeof(buffer), "%g", value->data.f64);
 			}
-			if (value->kind == ADN_VALUE_PTR)
+			else if (value->kind == ADN_VALUE_PTR)
+			{
+				length = snprintf(buffer, sizeof(buffer), "%p", value->data.ptr);
+			}
+			else
 			{
-				snprintf(buffer, sizeof(buffer), "%p", value->data.ptr);
-				return strdup(buffer);
+				length = snprintf(buffer, sizeof(buffer), "%lld", (long long)value->data.i64);
 			}
-			return adn_i32_to_string(value->data.i64);
+			break;
+	}
+	if (length > 0)
+	{
+		adn_builder_append_n(builder, buffer,
+		                     (size_t)length < sizeof(buffer) ? (size_t)length
+		                                                     : sizeof(buffer) - 1);
 	}
 }
 
@@ -548,50 +1188,254 @@ char* adn_string_format(const char* format, void* args)
 			i++;
 			continue;
 		}
-		AdnValue* value =
-		    (values && arg_index < values->count) ? &values->items[arg_index++] : NULL;
-		char* replacement = adn_value_to_string_spec(value, spec);
-		if (replacement)
+		AdnValue loaded = {0};
+		AdnValue* value = NULL;
+		if (values && arg_index < values->count)
 		{
-			adn_builder_append(&builder, replacement);
-			free(replacement);
+			loaded = adn_array_load(values, arg_index++);
+			value = &loaded;
 		}
+		adn_builder_append_value(&builder, value, spec);
 		i++;
 	}
-	return adn_builder_finish(&builder);
+	return adn_builder_finish(&builder);
+}
+
+// Formats with a literal format string are split up by the compiler, which then appends
+// each piece and value here in order and prints the text directly. Arguments are all
+// evaluated before adn_format_begin, so one scratch buffer per thread is enough.
+static _Thread_local AdnStringBuilder adn_format_scratch;
+
+void* adn_format_begin(void)
+{
+	if (!adn_format_scratch.data)
+	{
+		adn_builder_init(&adn_format_scratch);
+	}
+	adn_format_scratch.length = 0;
+	if (adn_format_scratch.data)
+	{
+		adn_format_scratch.data[0] = '\0';
+	}
+	return &adn_format_scratch;
+}
+
+void adn_format_append_text(void* buffer, const char* text)
+{
+	adn_builder_append(buffer, text);
+}
+
+void adn_format_append_i64(void* buffer, int64_t value, int64_t spec)
+{
+	AdnValue boxed = {.kind = ADN_VALUE_I64, .data.i64 = value};
+	adn_builder_append_value(buffer, &boxed, (char)spec);
+}
+
+void adn_format_append_f64(void* buffer, double value, int64_t spec)
+{
+	AdnValue boxed = {.kind = ADN_VALUE_F64, .data.f64 = value};
+	adn_builder_append_value(buffer, &boxed, (char)spec);
+}
+
+void adn_format_append_string(void* buffer, const char* value, int64_t spec)
+{
+	AdnValue boxed = {.kind = ADN_VALUE_STRING, .data.string = (char*)value};
+	adn_builder_append_value(buffer, &boxed, (char)spec);
+}
+
+void adn_format_append_ptr(void* buffer, void* value, int64_t spec)
+{
+	AdnValue boxed = {.kind = ADN_VALUE_PTR, .data.ptr = value};
+	adn_builder_append_value(buffer, &boxed, (char)spec);
+}
+
+const char* adn_format_text(void* buffer)
+{
+	AdnStringBuilder* builder = buffer;
+	return builder && builder->data ? builder->data : "";
+}
+
+char* adn_format_finish(void* buffer)
+{
+	AdnStringBuilder* builder = buffer;
+	if (!builder || !builder->data)
+	{
+		return adn_empty_string.text;
+	}
+	return adn_string_from_bytes(builder->data, builder->length);
+}
+
+static AdnObject* adn_object_cast(void* object)
+{
+	return (AdnObject*)object;
+}
+
+typedef struct
+{
+	char* key;
+	uint64_t hash;
+} AdnInternedKey;
+
+// Literal keys are interned once for the whole program, so objects built from the same
+// key share one pointer and most lookups with compiler-emitted keys match by pointer.
+// Literals are never freed and their number is fixed by the program text, so the table
+// stays bounded; keys computed at run time are owned by the entries that hold them.
+static AdnInternedKey* adn_interned_keys = NULL;
+static size_t adn_interned_count = 0;
+static size_t adn_interned_capacity = 0;
+
+static int adn_interned_grow(void)
+{
+	size_t next_capacity = adn_interned_capacity == 0 ? 64 : adn_interned_capacity * 2;
+	AdnInternedKey* resized = calloc(next_capacity, sizeof(AdnInternedKey));
+	if (!resized)
+	{
+		return -1;
+	}
+	for (size_t i = 0; i < adn_interned_capacity; i++)
+	{
+		if (!adn_interned_keys[i].key)
+		{
+			continue;
+		}
+		size_t slot = adn_interned_keys[i].hash & (next_capacity - 1);
+		while (resized[slot].key)
+		{
+			slot = (slot + 1) & (next_capacity - 1);
+		}
+		resized[slot] = adn_interned_keys[i];
+	}
+	free(adn_interned_keys);
+	adn_interned_keys = resized;
+	adn_interned_capacity = next_capacity;
+	return 0;
+}
+
+static char* adn_intern_key(char* key, uint64_t hash)
+{
+	if ((adn_interned_count + 1) * 4 > adn_interned_capacity * 3 && adn_interned_grow() != 0)
+	{
+		return NULL;
+	}
+	size_t slot = hash & (adn_interned_capacity - 1);
+	while (adn_interned_keys[slot].key)
+	{
+		if (adn_interned_keys[slot].hash == hash && strcmp(adn_interned_keys[slot].key, key) == 0)
+		{
+			return adn_interned_keys[slot].key;
+		}
+		slot = (slot + 1) & (adn_interned_capacity - 1);
+	}
+	adn_interned_keys[slot].key = key;
+	adn_interned_keys[slot].hash = hash;
+	adn_interned_count++;
+	return key;
+}
+
+// The key an object entry stores for `key`: the interned pointer for literals, otherwise
+// a reference (or, for strings from outside the runtime, a copy) that the entry releases.
+static char* adn_object_key(const char* key, uint64_t hash)
+{
+	AdnStringHeader* header = adn_string_header(key);
+	if (header && header->ref.refcount == ADN_REFCOUNT_STATIC)
+	{
+		return adn_intern_key((char*)key, hash);
+	}
+	return adn_string_copy(key);
 }
 
-static AdnObject* adn_object_cast(void* object)
+static int adn_object_entry_matches(const AdnObjectEntry* entry, const char* key, uint64_t hash)
 {
-	return (AdnObject*)object;
+	return entry->hash == hash && (entry->key == key || strcmp(entry->key, key) == 0);
 }
 
-static AdnObjectEntry* adn_object_find_entry(AdnObject* object, const char* key)
+static void adn_object_index_insert(AdnObject* object, size_t position)
+{
+	size_t mask = object->index_capacity - 1;
+	size_t slot = object->entries[position].hash & mask;
+	while (object->index[slot])
+	{
+		slot = (slot + 1) & mask;
+	}
+	object->index[slot] = (uint32_t)(position + 1);
+}
+
+static void adn_object_rebuild_index(AdnObject* object)
+{
+	size_t next_capacity = object->index_capacity == 0 ? 32 : object->index_capacity;
+	while (next_capacity * 3 < object->count * 4 + 4)
+	{
+		next_capacity *= 2;
+	}
+	uint32_t* index = calloc(next_capacity, sizeof(uint32_t));
+	if (!index)
+	{
+		// Lookups keep working through the linear scan; only the speed-up is lost.
+		return;
+	}
+	free(object->index);
+	object->index = index;
+	object->index_capacity = next_capacity;
+	for (size_t i = 0; i < object->count; i++)
+	{
+		adn_object_index_insert(object, i);
+	}
+}
+
+static AdnObjectEntry* adn_object_find_entry_hashed(AdnObject* object, const char* key,
+                                                   uint64_t hash)
 {
 	if (!object || !key)
 	{
 		return NULL;
 	}
-	for (size_t i = 0; i < object->count; i++)
+	if (!object->index)
+	{
+		for (size_t i = 0; i < object->count; i++)
+		{
+			if (adn_object_entry_matches(&object->entries[i], key, hash))
+			{
+				return &object->entries[i];
+			}
+		}
+		return NULL;
+	}
+	size_t mask = object->index_capacity - 1;
+	for (size_t slot = hash & mask; object->index[slot]; slot = (slot + 1) & mask)
 	{
-		if (object->entries[i].key && strcmp(object->entries[i].key, key) == 0)
+		AdnObjectEntry* entry = &object->entries[object->index[slot] - 1];
+		if (adn_object_entry_matches(entry, key, hash))
 		{
-			return &object->entries[i];
+			return entry;
 		}
 	}
 	return NULL;
 }
 
-static void adn_object_store_value(AdnObject* object, const char* key, AdnValue value)
+static AdnObjectEntry* adn_object_find_entry(AdnObject* object, const char* key)
+{
+	if (!object || !key)
+	{
+		return NULL;
+	}
+	return adn_object_find_entry_hashed(object, key, adn_string_hash(key));
+}
+
+static void adn_object_store_value_hashed(AdnObject* object, const char* key, uint64_t hash,
+                                          AdnValue value)
 {
 	if (!object || !key)
 	{
 		adn_value_release(&value);
 		return;
 	}
-	AdnObjectEntry* entry = adn_object_find_entry(object, key);
+	AdnObjectEntry* entry = adn_object_find_entry_hashed(object, key, hash);
 	if (entry)
 	{
+		if (entry->value.kind != value.kind)
+		{
+			object->shape = NULL;
+		}
 		adn_value_release(&entry->value);
 		entry->value = value;
 		return;
@@ -602,9 +1446,30 @@ static void adn_object_store_value(AdnObject* object, const char* key, AdnValue
 		adn_value_release(&value);
 		return;
 	}
-	object->entries[object->count].key = strdup(key);
-	object->entries[object->count].value = value;
+	char* stored_key = adn_object_key(key, hash);
+	if (!stored_key)
+	{
+		adn_value_release(&value);
+		return;
+	}
+	size_t position = object->count;
+	object->entries[position].key = stored_key;
+	object->entries[position].value = value;
+	object->entries[position].hash = hash;
 	object->count++;
+	if (object->index && object->count * 4 <= object->index_capacity * 3)
+	{
+		adn_object_index_insert(object, position);
+	}
+	else if (object->count > ADN_OBJECT_INDEX_THRESHOLD)
+	{
+		adn_object_rebuild_index(object);
+	}
+}
+
+static void adn_object_store_value(AdnObject* object, const char* key, AdnValue value)
+{
+	adn_object_store_value_hashed(object, key, key ? adn_hash_key(key) : 0, value);
 }
 
 static void adn_array_reserve(AdnArray* array, size_t needed)
@@ -618,7 +1483,7 @@ static void adn_array_reserve(AdnArray* array, size_t needed)
 	{
 		next_capacity *= 2;
 	}
-	AdnValue* resized = realloc(array->items, sizeof(AdnValue) * next_capacity);
+	void* resized = realloc(array->items, adn_array_element_size(array) * next_capacity);
 	if (!resized)
 	{
 		return;
@@ -627,9 +1492,45 @@ static void adn_array_reserve(AdnArray* array, size_t needed)
 	array->capacity = next_capacity;
 }
 
+static int adn_array_box(AdnArray* array)
+{
+	AdnValue* boxed = malloc(sizeof(AdnValue) * (array->capacity ? array->capacity : 1));
+	if (!boxed)
+	{
+		return -1;
+	}
+	for (size_t i = 0; i < array->count; i++)
+	{
+		boxed[i] = adn_array_load(array, i);
+	}
+	free(array->items);
+	array->items = boxed;
+	array->storage = ADN_ARRAY_STORAGE_BOXED;
+	return 0;
+}
+
+// Makes room in the storage scheme for a value of `kind`.
+static int adn_array_accept(AdnArray* array, AdnValueKind kind)
+{
+	if (array->storage == ADN_ARRAY_STORAGE_UNSET)
+	{
+		array->storage = kind == ADN_VALUE_I64   ? ADN_ARRAY_STORAGE_I64
+		                 : kind == ADN_VALUE_F64 ? ADN_ARRAY_STORAGE_F64
+		                                         : ADN_ARRAY_STORAGE_BOXED;
+		return 0;
+	}
+	if (array->storage == ADN_ARRAY_STORAGE_BOXED ||
+	    (array->storage == ADN_ARRAY_STORAGE_I64 && kind == ADN_VALUE_I64) ||
+	    (array->storage == ADN_ARRAY_STORAGE_F64 && kind == ADN_VALUE_F64))
+	{
+		return 0;
+	}
+	return adn_array_box(array);
+}
+
 static void adn_array_push_value(AdnArray* array, AdnValue value)
 {
-	if (!array)
+	if (!array || adn_array_accept(array, value.kind) != 0)
 	{
 		adn_value_release(&value);
 		return;
@@ -640,16 +1541,17 @@ static void adn_array_push_value(AdnArray* array, AdnValue value)
 		adn_value_release(&value);
 		return;
 	}
-	array->items[array->count++] = value;
+	adn_array_store(array, array->count++, value);
 }
 
-static AdnValue* adn_array_get_value(AdnArray* array, int64_t index)
+static int adn_array_read(AdnArray* array, int64_t index, AdnValue* out)
 {
 	if (!array || index < 0 || (size_t)index >= array->count)
 	{
-		return NULL;
+		return 0;
 	}
-	return &array->items[index];
+	*out = adn_array_load(array, (size_t)index);
+	return 1;
 }
 
 static int64_t adn_array_insert_index(AdnArray* array, int64_t index)
@@ -680,7 +1582,7 @@ static int64_t adn_array_remove_index(AdnArray* array, int64_t index)
 
 static void adn_array_insert_value(AdnArray* array, int64_t index, AdnValue value)
 {
-	if (!array)
+	if (!array || adn_array_accept(array, value.kind) != 0)
 	{
 		adn_value_release(&value);
 		return;
@@ -693,9 +1595,11 @@ static void adn_array_insert_value(AdnArray* array, int64_t index, AdnValue valu
 		return;
 	}
 	size_t offset = (size_t)index;
-	memmove(&array->items[offset + 1], &array->items[offset],
-	        sizeof(AdnValue) * (array->count - offset));
-	array->items[offset] = value;
+	size_t element_size = adn_array_element_size(array);
+	char* items = array->items;
+	memmove(items + (offset + 1) * element_size, items + offset * element_size,
+	        element_size * (array->count - offset));
+	adn_array_store(array, offset, value);
 	array->count++;
 }
 
@@ -708,19 +1612,60 @@ static AdnValue adn_array_take_value(AdnArray* array, int64_t index)
 		return empty;
 	}
 	size_t offset = (size_t)index;
-	AdnValue removed = array->items[offset];
+	AdnValue removed = adn_array_load(array, offset);
 	if (offset + 1 < array->count)
 	{
-		memmove(&array->items[offset], &array->items[offset + 1],
-		        sizeof(AdnValue) * (array->count - offset - 1));
+		size_t element_size = adn_array_element_size(array);
+		char* items = array->items;
+		memmove(items + offset * element_size, items + (offset + 1) * element_size,
+		        element_size * (array->count - offset - 1));
 	}
 	array->count--;
 	return removed;
 }
 
+static void adn_array_destroy(void* array)
+{
+	AdnArray* inner = adn_array_cast(array);
+	adn_array_clear(inner);
+	free(inner->items);
+}
+
+static void adn_object_destroy(void* object)
+{
+	AdnObject* inner = adn_object_cast(object);
+	for (size_t i = 0; i < inner->count; i++)
+	{
+		adn_release(inner->entries[i].key);
+		adn_value_release(&inner->entries[i].value);
+	}
+	free(inner->entries);
+	free(inner->index);
+}
+
 void* adn_object_create(void)
 {
-	return calloc(1, sizeof(AdnObject));
+	return adn_heap_alloc(sizeof(AdnObject), ADN_OBJECT_MAGIC);
+}
+
+void* adn_object_create_shaped(const char* shape, int64_t field_count)
+{
+	AdnObject* object = adn_heap_alloc(sizeof(AdnObject), ADN_OBJECT_MAGIC);
+	if (!object)
+	{
+		return NULL;
+	}
+	if (field_count > 0)
+	{
+		adn_object_reserve(object, (size_t)field_count);
+	}
+	object->shape = shape;
+	return object;
+}
+
+static const AdnValue* adn_object_entry_value(const AdnObjectEntry* entry)
+{
+	return entry ? &entry->value : NULL;
 }
 
 void adn_object_set_i64(void* object, const char* key, int64_t value)
@@ -750,106 +1695,114 @@ int64_t adn_object_has(void* object, const char* key)
 
 int64_t adn_object_get_i64(void* object, const char* key)
 {
-	AdnObjectEntry* entry = adn_object_find_entry(adn_object_cast(object), key);
-	if (!entry)
-	{
-		return 0;
-	}
-	if (entry->value.kind == ADN_VALUE_F64)
-	{
-		return (int64_t)entry->value.data.f64;
-	}
-	if (entry->value.kind == ADN_VALUE_STRING)
-	{
-		return entry->value.data.string ? strtoll(entry->value.data.string, NULL, 10) : 0;
-	}
-	if (entry->value.kind == ADN_VALUE_PTR)
-	{
-		return (int64_t)(intptr_t)entry->value.data.ptr;
-	}
-	return entry->value.data.i64;
+	return adn_value_as_i64(
+	    adn_object_entry_value(adn_object_find_entry(adn_object_cast(object), key)));
 }
 
 double adn_object_get_f64(void* object, const char* key)
 {
-	AdnObjectEntry* entry = adn_object_find_entry(adn_object_cast(object), key);
-	if (!entry)
-	{
-		return 0.0;
-	}
-	if (entry->value.kind == ADN_VALUE_I64)
-	{
-		return (double)entry->value.data.i64;
-	}
-	if (entry->value.kind == ADN_VALUE_STRING)
-	{
-		return entry->value.data.string ? strtod(entry->value.data.string, NULL) : 0.0;
-	}
-	return entry->value.data.f64;
+	return adn_value_as_f64(
+	    adn_object_entry_value(adn_object_find_entry(adn_object_cast(object), key)));
 }
 
 char* adn_object_get_string(void* object, const char* key)
 {
-	AdnObjectEntry* entry = adn_object_find_entry(adn_object_cast(object), key);
-	if (!entry)
-	{
-		return strdup("");
-	}
-	if (entry->value.kind == ADN_VALUE_STRING)
-	{
-		return entry->value.data.string ? entry->value.data.string : strdup("");
-	}
-	if (entry->value.kind == ADN_VALUE_I64)
-	{
-		return adn_i32_to_string(entry->value.data.i64);
-	}
-	if (entry->value.kind == ADN_VALUE_F64)
-	{
-		return adn_f64_to_string(entry->value.data.f64);
-	}
-	return strdup("[object]");
+	return adn_value_as_string(
+	    adn_object_entry_value(adn_object_find_entry(adn_object_cast(object), key)),
+	    "[object]");
 }
 
 void* adn_object_get_ptr(void* object, const char* key)
 {
-	AdnObjectEntry* entry = adn_object_find_entry(adn_object_cast(object), key);
-	if (!entry)
-	{
-		return NULL;
-	}
-	if (entry->value.kind == ADN_VALUE_PTR)
-	{
-		return entry->value.data.ptr;
-	}
-	return NULL;
+	return adn_value_as_ptr(
+	    adn_object_entry_value(adn_object_find_entry(adn_object_cast(object), key)));
 }
 
-void* adn_array_create(void)
+void adn_object_set_hashed_i64(void* object, const char* key, int64_t hash, int64_t value)
 {
-	return calloc(1, sizeof(AdnArray));
+	adn_object_store_value_hashed(adn_object_cast(object), key, (uint64_t)hash,
+	                              adn_value_from_i64(value));
 }
 
-void adn_array_push_i64(void* array, int64_t value)
+void adn_object_set_hashed_f64(void* object, const char* key, int64_t hash, double value)
 {
-	adn_array_push_value(adn_array_cast(array), adn_value_from_i64(value));
+	adn_object_store_value_hashed(adn_object_cast(object), key, (uint64_t)hash,
+	                              adn_value_from_f64(value));
 }
 
-int64_t adn_array_pop_i64(void* array)
+void adn_object_set_hashed_string(void* object, const char* key, int64_t hash, const char* value)
 {
-	AdnValue value = adn_array_take_value(adn_array_cast(array), adn_array_length(array) - 1);
-	if (value.kind == ADN_VALUE_F64)
+	adn_object_store_value_hashed(adn_object_cast(object), key, (uint64_t)hash,
+	                              adn_value_from_string(value));
+}
+
+void adn_object_set_hashed_ptr(void* object, const char* key, int64_t hash, void* value)
+{
+	adn_object_store_value_hashed(adn_object_cast(object), key, (uint64_t)hash,
+	                              adn_value_from_ptr(value));
+}
+
+int64_t adn_object_get_hashed_i64(void* object, const char* key, int64_t hash)
+{
+	return adn_value_as_i64(adn_object_entry_value(
+	    adn_object_find_entry_hashed(adn_object_cast(object), key, (uint64_t)hash)));
+}
+
+double adn_object_get_hashed_f64(void* object, const char* key, int64_t hash)
+{
+	return adn_value_as_f64(adn_object_entry_value(
+	    adn_object_find_entry_hashed(adn_object_cast(object), key, (uint64_t)hash)));
+}
+
+char* adn_object_get_hashed_string(void* object, const char* key, int64_t hash)
+{
+	return adn_value_as_string(
+	    adn_object_entry_value(
+	        adn_object_find_entry_hashed(adn_object_cast(object), key, (uint64_t)hash)),
+	    "[object]");
+}
+
+void* adn_object_get_hashed_ptr(void* object, const char* key, int64_t hash)
+{
+	return adn_value_as_ptr(adn_object_entry_value(
+	    adn_object_find_entry_hashed(adn_object_cast(object), key, (uint64_t)hash)));
+}
+
+void* adn_array_create(void)
+{
+	return adn_heap_alloc(sizeof(AdnArray), ADN_ARRAY_MAGIC);
+}
+
+void* adn_array_create_typed(int64_t storage, int64_t capacity)
+{
+	AdnArray* array = adn_heap_alloc(sizeof(AdnArray), ADN_ARRAY_MAGIC);
+	if (!array)
 	{
-		return (int64_t)value.data.f64;
+		return NULL;
 	}
-	if (value.kind == ADN_VALUE_STRING)
+	if (storage == ADN_ARRAY_STORAGE_BOXED || storage == ADN_ARRAY_STORAGE_I64 ||
+	    storage == ADN_ARRAY_STORAGE_F64)
 	{
-		return value.data.string ? strtoll(value.data.string, NULL, 10) : 0;
+		array->storage = storage;
 	}
-	if (value.kind == ADN_VALUE_PTR)
+	if (capacity > 0 && array->storage != ADN_ARRAY_STORAGE_UNSET)
 	{
-		return (int64_t)(intptr_t)value.data.ptr;
+		adn_array_reserve(array, (size_t)capacity);
 	}
-	return value.data.i64;
+	return array;
+}
+
+void adn_array_push_i64(void* array, int64_t value)
+{
+	adn_array_push_value(adn_array_cast(array), adn_value_from_i64(value));
+}
+
+int64_t adn_array_pop_i64(void* array)
+{
+	AdnValue value = adn_array_take_value(adn_array_cast(array), adn_array_length(array) - 1);
+	int64_t result = adn_value_as_i64(&value);
+	adn_value_release(&value);
+	return result;
 }
 
 void adn_array_push_f64(void* array, double value)
@@ -860,15 +1813,9 @@ void adn_array_push_f64(void* array, double value)
 double adn_array_pop_f64(void* array)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), adn_array_length(array) - 1);
-	if (value.kind == ADN_VALUE_I64)
-	{
-		return (double)value.data.i64;
-	}
-	if (value.kind == ADN_VALUE_STRING)
-	{
-		return value.data.string ? strtod(value.data.string, NULL) : 0.0;
-	}
-	return value.data.f64;
+	double result = adn_value_as_f64(&value);
+	adn_value_release(&value);
+	return result;
 }
 
 void adn_array_push_string(void* array, const char* value)
@@ -879,19 +1826,9 @@ void adn_array_push_string(void* array, const char* value)
 char* adn_array_pop_string(void* array)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), adn_array_length(array) - 1);
-	if (value.kind == ADN_VALUE_STRING)
-	{
-		return value.data.string ? value.data.string : strdup("");
-	}
-	if (value.kind == ADN_VALUE_I64)
-	{
-		return adn_i32_to_string(value.data.i64);
-	}
-	if (value.kind == ADN_VALUE_F64)
-	{
-		return adn_f64_to_string(value.data.f64);
-	}
-	return strdup("[array]");
+	char* result = adn_value_as_string(&value, "[array]");
+	adn_value_release(&value);
+	return result;
 }
 
 void adn_array_push_ptr(void* array, void* value)
@@ -902,7 +1839,9 @@ void adn_array_push_ptr(void* array, void* value)
 void* adn_array_pop_ptr(void* array)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), adn_array_length(array) - 1);
-	return value.kind == ADN_VALUE_PTR ? value.data.ptr : NULL;
+	void* result = adn_value_as_ptr(&value);
+	adn_value_release(&value);
+	return result;
 }
 
 void adn_array_insert_i64(void* array, int64_t index, int64_t value)
@@ -932,9 +1871,12 @@ void adn_array_clear(void* array)
 	{
 		return;
 	}
-	for (size_t i = 0; i < inner->count; i++)
+	if (inner->storage == ADN_ARRAY_STORAGE_BOXED)
 	{
-		adn_value_release(&inner->items[i]);
+		for (size_t i = 0; i < inner->count; i++)
+		{
+			adn_value_release(&((AdnValue*)inner->items)[i]);
+		}
 	}
 	inner->count = 0;
 }
@@ -948,7 +1890,7 @@ int64_t adn_array_length(void* array)
 void* adn_array_slice(void* array, int64_t start, int64_t end)
 {
 	AdnArray* inner = adn_array_cast(array);
-	AdnArray* slice = calloc(1, sizeof(AdnArray));
+	AdnArray* slice = adn_array_create();
 	if (!slice)
 	{
 		return NULL;
@@ -977,137 +1919,85 @@ void* adn_array_slice(void* array, int64_t start, int64_t end)
 	{
 		end = start;
 	}
+	slice->storage = inner->storage;
+	if (slice->storage != ADN_ARRAY_STORAGE_BOXED)
+	{
+		adn_array_reserve(slice, (size_t)(end - start));
+		if (end > start && slice->capacity >= (size_t)(end - start))
+		{
+			size_t element_size = adn_array_element_size(inner);
+			memcpy(slice->items, (char*)inner->items + (size_t)start * element_size,
+			       (size_t)(end - start) * element_size);
+			slice->count = (size_t)(end - start);
+		}
+		return slice;
+	}
 	for (int64_t i = start; i < end; i++)
 	{
-		adn_array_push_value(slice, adn_value_clone(&inner->items[i]));
+		AdnValue value = adn_array_load(inner, (size_t)i);
+		adn_array_push_value(slice, adn_value_clone(&value));
 	}
 	return slice;
 }
 
 int64_t adn_array_get_i64(void* array, int64_t index)
 {
-	AdnValue* value = adn_array_get_value(adn_array_cast(array), index);
-	if (!value)
-	{
-		return 0;
-	}
-	if (value->kind == ADN_VALUE_F64)
-	{
-		return (int64_t)value->data.f64;
-	}
-	if (value->kind == ADN_VALUE_STRING)
-	{
-		return value->data.string ? strtoll(value->data.string, NULL, 10) : 0;
-	}
-	if (value->kind == ADN_VALUE_PTR)
-	{
-		return (int64_t)(intptr_t)value->data.ptr;
-	}
-	return value->data.i64;
+	AdnValue value;
+	return adn_array_read(adn_array_cast(array), index, &value) ? adn_value_as_i64(&value) : 0;
 }
 
 int64_t adn_array_remove_i64(void* array, int64_t index)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), index);
-	if (value.kind == ADN_VALUE_F64)
-	{
-		return (int64_t)value.data.f64;
-	}
-	if (value.kind == ADN_VALUE_STRING)
-	{
-		return value.data.string ? strtoll(value.data.string, NULL, 10) : 0;
-	}
-	if (value.kind == ADN_VALUE_PTR)
-	{
-		return (int64_t)(intptr_t)value.data.ptr;
-	}
-	return value.data.i64;
+	int64_t result = adn_value_as_i64(&value);
+	adn_value_release(&value);
+	return result;
 }
 
 double adn_array_get_f64(void* array, int64_t index)
 {
-	AdnValue* value = adn_array_get_value(adn_array_cast(array), index);
-	if (!value)
-	{
-		return 0.0;
-	}
-	if (value->kind == ADN_VALUE_I64)
-	{
-		return (double)value->data.i64;
-	}
-	if (value->kind == ADN_VALUE_STRING)
-	{
-		return value->data.string ? strtod(value->data.string, NULL) : 0.0;
-	}
-	return value->data.f64;
+	AdnValue value;
+	return adn_array_read(adn_array_cast(array), index, &value) ? adn_value_as_f64(&value)
+	                                                            : 0.0;
 }
 
 double adn_array_remove_f64(void* array, int64_t index)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), index);
-	if (value.kind == ADN_VALUE_I64)
-	{
-		return (double)value.data.i64;
-	}
-	if (value.kind == ADN_VALUE_STRING)
-	{
-		return value.data.string ? strtod(value.data.string, NULL) : 0.0;
-	}
-	return value.data.f64;
+	double result = adn_value_as_f64(&value);
+	adn_value_release(&value);
+	return result;
 }
 
 char* adn_array_get_string(void* array, int64_t index)
 {
-	AdnValue* value = adn_array_get_value(adn_array_cast(array), index);
-	if (!value)
-	{
-		return strdup("");
-	}
-	if (value->kind == ADN_VALUE_STRING)
-	{
-		return value->data.string ? value->data.string : strdup("");
-	}
-	if (value->kind == ADN_VALUE_I64)
-	{
-		return adn_i32_to_string(value->data.i64);
-	}
-	if (value->kind == ADN_VALUE_F64)
+	AdnValue value;
+	if (!adn_array_read(adn_array_cast(array), index, &value))
 	{
-		return adn_f64_to_string(value->data.f64);
+		return adn_string_copy("");
 	}
-	return strdup("[array]");
+	return adn_value_as_string(&value, "[array]");
 }
 
 char* adn_array_remove_string(void* array, int64_t index)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), index);
-	if (value.kind == ADN_VALUE_STRING)
-	{
-		return value.data.string ? value.data.string : strdup("");
-	}
-	if (value.kind == ADN_VALUE_I64)
-	{
-		return adn_i32_to_string(value.data.i64);
-	}
-	if (value.kind == ADN_VALUE_F64)
-	{
-		return adn_f64_to_string(value.data.f64);
-	}
-	return strdup("[array]");
+	char* result = adn_value_as_string(&value, "[array]");
+	adn_value_release(&value);
+	return result;
 }
 
 void* adn_array_get_ptr(void* array, int64_t index)
 {
-	AdnValue* value = adn_array_get_value(adn_array_cast(array), index);
-	if (!value || value->kind != ADN_VALUE_PTR)
-	{
-		return NULL;
-	}
-	return value->data.ptr;
+	AdnValue value;
+	return adn_array_read(adn_array_cast(array), index, &value) ? adn_value_as_ptr(&value)
+	                                                            : NULL;
 }
 
 void* adn_array_remove_ptr(void* array, int64_t index)
 {
 	AdnValue value = adn_array_take_value(adn_array_cast(array), index);
-	return value.kind == ADN_VALUE_PTR ? value.data.ptr : NULL;
-}
\ No newline at end of file
+	void* result = adn_value_as_ptr(&value);
+	adn_value_release(&value);
+	return result;
+}
@@ -7,6 +7,14 @@ int64_t adn_powi(int64_t base, int64_t exp);
 
 char* adn_strconcat(const char* s1, const char* s2);
 
+// Concatenates the first `count` pieces with a single allocation; compiled code passes
+// the remaining slots as empty strings.
+#define ADN_STRCONCAT_MAX_PIECES 8
+
+char* adn_strconcat_n(int64_t count, const char* s0, const char* s1, const char* s2,
+                      const char* s3, const char* s4, const char* s5, const char* s6,
+                      const char* s7);
+
 char* adn_i32_to_string(int64_t val);
 
 int64_t adn_string_to_i32(const char* s);
@@ -25,8 +33,81 @@ char* adn_string_from_code(int64_t code);
 
 char* adn_string_format(const char* format, void* args);
 
+// Pieces of a literal format string, split up at compile time. adn_format_begin returns
+// a per-thread scratch buffer; `spec` is the format character that followed the '%'.
+// adn_format_text points into the buffer and is only valid until the next begin.
+void* adn_format_begin(void);
+
+void adn_format_append_text(void* buffer, const char* text);
+
+void adn_format_append_i64(void* buffer, int64_t value, int64_t spec);
+
+void adn_format_append_f64(void* buffer, double value, int64_t spec);
+
+void adn_format_append_string(void* buffer, const char* value, int64_t spec);
+
+void adn_format_append_ptr(void* buffer, void* value, int64_t spec);
+
+const char* adn_format_text(void* buffer);
+
+char* adn_format_finish(void* buffer);
+
+// Reference counting for runtime strings, arrays and objects. Compiled code retains a
+// value it stores and releases it when the owning variable or temporary dies; both
+// ignore NULL, literals and pointers the runtime did not allocate.
+void* adn_retain(void* value);
+
+void adn_release(void* value);
+
+// Makes compiled string literals known to the runtime, so their headers are used for
+// length and hash. Emitted programs call it from a constructor before main.
+void adn_register_literals(const char* const* literals, int64_t count);
+
+// Turns a malloc'd C string into a runtime string, taking ownership of `text`.
+char* adn_string_adopt(char* text);
+
+// A runtime string holding a copy of the first `length` bytes of `bytes`.
+char* adn_string_copy_bytes(const char* bytes, int64_t length);
+
+// A zeroed, reference-counted value of `size` bytes for a library's own C types. Compiled
+// code retains and releases it like any other runtime value; `destroy`, when set, runs
+// before the memory is freed so the value can release what it holds.
+void* adn_native_create(int64_t size, void (*destroy)(void*));
+
+// Growable byte buffer behind the stdlib's string_builder type, also used by compiled
+// loops that keep appending to one string variable.
+void* adn_string_builder_create(void);
+
+void adn_string_builder_append(void* builder, const char* text);
+
+int64_t adn_string_builder_length(void* builder);
+
+void adn_string_builder_clear(void* builder);
+
+// A copy of the contents; the builder stays usable.
+char* adn_string_builder_to_string(void* builder);
+
+// Hands the buffer over as a string without copying and leaves the builder empty.
+char* adn_string_builder_finish(void* builder);
+
+// Runtime strings and compiled literals carry this header just before their bytes:
+// { uint64 hash (0 until computed), int64 length, uint32 refcount, uint32 magic }.
+#define ADN_STRING_HEADER_SIZE 24
+#define ADN_STRING_MAGIC 0x4144534eu
+// Refcount of literals and the shared one-byte strings; they are never freed.
+#define ADN_REFCOUNT_STATIC 0u
+
+// Layout of AdnObject that compiled code relies on for shaped field reads.
+#define ADN_OBJECT_ENTRIES_OFFSET 0
+#define ADN_OBJECT_SHAPE_OFFSET 24
+#define ADN_OBJECT_ENTRY_SIZE 32
+#define ADN_OBJECT_ENTRY_DATA_OFFSET 16
+
 void* adn_object_create(void);
 
+// `shape` must outlive the object; the fields are expected to be set in shape order.
+void* adn_object_create_shaped(const char* shape, int64_t field_count);
+
 void adn_object_set_i64(void* object, const char* key, int64_t value);
 
 void adn_object_set_f64(void* object, const char* key, double value);
@@ -45,8 +126,50 @@ char* adn_object_get_string(void* object, const char* key);
 
 void* adn_object_get_ptr(void* object, const char* key);
 
+// FNV-1a over the key bytes. The compiler emits this for constant keys and passes
+// it to the *_hashed entry points, which then skip hashing at runtime.
+static inline uint64_t adn_hash_key(const char* key)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char* cursor = (const unsigned char*)key; *cursor; cursor++)
+	{
+		hash ^= *cursor;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void adn_object_set_hashed_i64(void* object, const char* key, int64_t hash, int64_t value);
+
+void adn_object_set_hashed_f64(void* object, const char* key, int64_t hash, double value);
+
+void adn_object_set_hashed_string(void* object, const char* key, int64_t hash, const char* value);
+
+void adn_object_set_hashed_ptr(void* object, const char* key, int64_t hash, void* value);
+
+int64_t adn_object_get_hashed_i64(void* object, const char* key, int64_t hash);
+
+double adn_object_get_hashed_f64(void* object, const char* key, int64_t hash);
+
+char* adn_object_get_hashed_string(void* object, const char* key, int64_t hash);
+
+void* adn_object_get_hashed_ptr(void* object, const char* key, int64_t hash);
+
+// Layout of AdnArray that compiled code relies on for unboxed element reads.
+#define ADN_ARRAY_ITEMS_OFFSET 0
+#define ADN_ARRAY_COUNT_OFFSET 8
+#define ADN_ARRAY_STORAGE_OFFSET 24
+
+#define ADN_ARRAY_STORAGE_UNSET 0
+#define ADN_ARRAY_STORAGE_BOXED 1
+#define ADN_ARRAY_STORAGE_I64 2
+#define ADN_ARRAY_STORAGE_F64 3
+
 void* adn_array_create(void);
 
+// Starts the array in `storage` (an ADN_ARRAY_STORAGE_* value) with room for `capacity` items.
+void* adn_array_create_typed(int64_t storage, int64_t capacity);
+
 void adn_array_push_i64(void* array, int64_t value);
 
 int64_t adn_array_pop_i64(void* array);
@@ -204,7 +204,8 @@ static bool is_type_token(TokenType type)
 	return type == TOKEN_STRING_TYPE || type == TOKEN_I32_TYPE || type == TOKEN_I64_TYPE ||
 	       type == TOKEN_U32_TYPE || type == TOKEN_U64_TYPE || type == TOKEN_VOID_TYPE ||
 	       type == TOKEN_F32_TYPE || type == TOKEN_F64_TYPE || type == TOKEN_BOOL_TYPE ||
-	       type == TOKEN_I8_TYPE || type == TOKEN_U8_TYPE || type == TOKEN_ANY_TYPE;
+	       type == TOKEN_I8_TYPE || type == TOKEN_U8_TYPE || type == TOKEN_ANY_TYPE ||
+	       type == TOKEN_STRING_BUILDER_TYPE;
 }
 
 static bool append_text(char** buffer, size_t* length, size_t* capacity, const char* text)
@@ -43,6 +43,7 @@ const Keyword keywords[] = {
     {"void", TOKEN_VOID_TYPE},
     {"bool", TOKEN_BOOL_TYPE},
     {"any", TOKEN_ANY_TYPE},
+    {"string_builder", TOKEN_STRING_BUILDER_TYPE},
 
     {"true", TOKEN_TRUE},
     {"false", TOKEN_FALSE},
@@ -101,6 +101,8 @@ char* token_type_to_string(TokenType type)
 			return "BOOL_TYPE";
 		case TOKEN_ANY_TYPE:
 			return "ANY_TYPE";
+		case TOKEN_STRING_BUILDER_TYPE:
+			return "STRING_BUILDER_TYPE";
 		case TOKEN_TRUE:
 			return "TRUE";
 		case TOKEN_FALSE:
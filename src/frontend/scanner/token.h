@@ -43,6 +43,7 @@ typedef enum TokenType
 	TOKEN_VOID_TYPE,
 	TOKEN_BOOL_TYPE,
 	TOKEN_ANY_TYPE,
+	TOKEN_STRING_BUILDER_TYPE,
 
 	TOKEN_STRING,
 	TOKEN_NUMBER,
@@ -1334,7 +1334,9 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 				{
 					if (strcmp(node->call.callee, "adn_process_args") == 0 ||
 					    strcmp(node->call.callee, "adn_process_env_keys") == 0 ||
-					    strcmp(node->call.callee, "adn_regex_split") == 0)
+					    strcmp(node->call.callee, "adn_regex_split") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_handle_split") == 0 ||
+					    strcmp(node->call.callee, "adn_read_many") == 0)
 					{
 						return "array<string>";
 					}
@@ -1346,10 +1348,17 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 					if (strcmp(node->call.callee, "adn_input") == 0 ||
 					    strcmp(node->call.callee, "adn_string_format") == 0 ||
 					    strcmp(node->call.callee, "adn_read_file") == 0 ||
+					    strcmp(node->call.callee, "adn_map_file") == 0 ||
+					    strcmp(node->call.callee, "adn_lines_line") == 0 ||
 					    strcmp(node->call.callee, "adn_regex_escape") == 0 ||
-					    strcmp(node->call.callee, "adn_regex_compile") == 0 ||
 					    strcmp(node->call.callee, "adn_regex_replace") == 0 ||
 					    strcmp(node->call.callee, "adn_regex_replace_all") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_handle_replace_all") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_iter_group") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_text") == 0 ||
+					    strcmp(node->call.callee, "adn_json_type_name") == 0 ||
+					    strcmp(node->call.callee, "adn_json_as_string") == 0 ||
+					    strcmp(node->call.callee, "adn_json_key_at") == 0 ||
 					    strcmp(node->call.callee, "adn_string_char_at") == 0 ||
 					    strcmp(node->call.callee, "adn_process_name") == 0 ||
 					    strcmp(node->call.callee, "adn_process_arg") == 0 ||
@@ -1366,7 +1375,9 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 					{
 						return "string";
 					}
-					if (strstr(node->call.callee, "_to_f64") ||
+					if (strcmp(node->call.callee, "adn_json_reader_number") == 0 ||
+					    strcmp(node->call.callee, "adn_json_as_number") == 0 ||
+					    strstr(node->call.callee, "_to_f64") ||
 					    strstr(node->call.callee, "_get_f64"))
 					{
 						return "f64";
@@ -1378,6 +1389,13 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 					    strcmp(node->call.callee, "adn_regex_contains") == 0 ||
 					    strcmp(node->call.callee, "adn_regex_starts_with") == 0 ||
 					    strcmp(node->call.callee, "adn_regex_ends_with") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_cache_hits") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_cache_misses") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_handle_matches") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_handle_find") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_iter_next") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_iter_start") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_iter_end") == 0 ||
 					    strcmp(node->call.callee, "adn_process_id") == 0 ||
 					    strcmp(node->call.callee, "adn_process_parent_id") == 0 ||
 					    strcmp(node->call.callee, "adn_process_arg_count") == 0 ||
@@ -1392,6 +1410,18 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 					    strcmp(node->call.callee, "adn_process_is_windows") == 0 ||
 					    strcmp(node->call.callee, "adn_process_is_linux") == 0 ||
 					    strcmp(node->call.callee, "adn_process_is_macos") == 0 ||
+					    strcmp(node->call.callee, "adn_lines_next") == 0 ||
+					    strcmp(node->call.callee, "adn_write_many") == 0 ||
+					    strcmp(node->call.callee, "adn_json_valid") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_next") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_bool") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_depth") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_next_record") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_failed") == 0 ||
+					    strcmp(node->call.callee, "adn_json_kind") == 0 ||
+					    strcmp(node->call.callee, "adn_json_as_bool") == 0 ||
+					    strcmp(node->call.callee, "adn_json_length") == 0 ||
+					    strcmp(node->call.callee, "adn_json_has") == 0 ||
 					    strstr(node->call.callee, "_to_i32") ||
 					    strstr(node->call.callee, "_get_i64") ||
 					    strstr(node->call.callee, "_length"))
@@ -1399,6 +1429,22 @@ static const char* resolve_expression_type(SemanticAnalyzer* analyzer, ASTNode*
 						return "i32";
 					}
 					if (strstr(node->call.callee, "create") ||
+					    strcmp(node->call.callee, "adn_lines_open") == 0 ||
+					    strcmp(node->call.callee, "adn_file_open") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_new") == 0 ||
+					    strcmp(node->call.callee, "adn_regex_iter") == 0 ||
+					    strcmp(node->call.callee, "adn_json_parse") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_open") == 0 ||
+					    strcmp(node->call.callee, "adn_json_reader_record") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_null") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_bool") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_number") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_string") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_array") == 0 ||
+					    strcmp(node->call.callee, "adn_json_new_object") == 0 ||
+					    strcmp(node->call.callee, "adn_json_at") == 0 ||
+					    strcmp(node->call.callee, "adn_json_value_at") == 0 ||
+					    strcmp(node->call.callee, "adn_json_get") == 0 ||
 					    strstr(node->call.callee, "_get_ptr"))
 					{
 						return "any";
@@ -1620,7 +1666,8 @@ static bool is_known_type_name(const char* name)
 		return true;
 	}
 	static const char* types[] = {"string", "bool", "i8",  "u8",   "i32",    "i64",   "u32",
-	                              "u64",    "f32",  "f64", "void", "object", "array", "any"};
+	                              "u64",    "f32",  "f64", "void", "object", "array", "any",
+	                              "string_builder"};
 	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
 	{
 		if (strcmp(types[i], name) == 0)
@@ -12,6 +12,7 @@
 #include "frontend/ast/tree.h"
 #include "frontend/semantics/semantic.h"
 #include "backend/backend.h"
+#include "backend/ir/opt.h"
 #include "backend/linker/linker.h"
 #include "embedded_libs.h"
 
@@ -187,6 +188,56 @@ static bool build_combined_bundle_paths(const char* bundle_paths, char* output,
 	return written >= 0 && (size_t)written < output_size;
 }
 
+static bool parse_job_count(const char* text, int* out_jobs)
+{
+	char* end = NULL;
+	long value;
+
+	if (!text || text[0] == '\0' || !out_jobs)
+	{
+		return false;
+	}
+
+	value = strtol(text, &end, 10);
+	if (*end != '\0' || value < 1 || value > INT_MAX)
+	{
+		return false;
+	}
+
+	*out_jobs = (int)value;
+	return true;
+}
+
+// Disables one IR pass by name, or every pass for "all".
+static bool disable_ir_pass(const char* name)
+{
+	if (!name)
+	{
+		return false;
+	}
+	if (strcmp(name, "all") == 0)
+	{
+		for (int pass = 0; pass < IR_OPT_PASS_COUNT; ++pass)
+		{
+			ir_opt_set_pass_enabled((IrOptPass)pass, 0);
+		}
+		return true;
+	}
+	int pass = ir_opt_pass_from_name(name);
+	if (pass < 0)
+	{
+		return false;
+	}
+	ir_opt_set_pass_enabled((IrOptPass)pass, 0);
+	return true;
+}
+
+static bool is_optimization_flag(const char* arg)
+{
+	return strcmp(arg, "-O0") == 0 || strcmp(arg, "-O1") == 0 || strcmp(arg, "-O2") == 0 ||
+	       strcmp(arg, "-O3") == 0 || strcmp(arg, "-Os") == 0;
+}
+
 bool has_valid_extension(const char* filename)
 {
 	size_t len = strlen(filename);
@@ -224,6 +275,14 @@ void print_help(const char* program_name)
 	printf("  -l, --link-lib <name>      Link a native library name or path. Repeatable.\n");
 	printf("  -L, --link-search <path>   Add a native library search path. Repeatable.\n");
 	printf("      --link-arg <arg>       Pass a raw argument through to the final clang link.\n");
+	printf("  -j, --jobs <n>             Run up to <n> runtime C compiles in parallel.\n");
+	printf("                             Defaults to the number of online CPUs.\n");
+	printf("  -O0, -O1, -O2, -O3, -Os    Optimization level for the program and the bundled\n");
+	printf("                             runtime/standard library C modules.\n");
+	printf("      --lto                  Link the runtime as bitcode into the program module\n");
+	printf("                             so runtime helpers can be inlined.\n");
+	printf("      --no-ir-pass <pass>    Skip an IR optimization pass: const-fold, simplify,\n");
+	printf("                             unreachable, mem2reg, dce, or all. Repeatable.\n");
 	printf("  -r, --rawir                Stop after emitting LLVM IR (.ll file)\n");
 	printf("  -h, --help                 Show this help message and exit\n");
 }
@@ -236,6 +295,9 @@ int main(int argc, char* argv[])
 	char* cli_link_libraries = NULL;
 	char* cli_link_search_paths = NULL;
 	bool stop_at_ir = false;
+	int jobs = 0;
+	const char* opt_level = NULL;
+	bool lto = false;
 
 	if (argc < 2)
 	{
@@ -350,6 +412,47 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 		}
+		else if (strncmp(argv[i], "-j", 2) == 0 || strcmp(argv[i], "--jobs") == 0)
+		{
+			// accepts both "-j 8" and "-j8"
+			const char* value = argv[i][1] == 'j' && argv[i][2] != '\0' ? argv[i] + 2
+			                                                          : NULL;
+			if (!value && i + 1 < argc)
+			{
+				value = argv[++i];
+			}
+			if (!parse_job_count(value, &jobs))
+			{
+				fprintf(stderr, "Error: -j/--jobs requires a positive job count\n");
+				print_usage(argv[0]);
+				free(cli_link_args);
+				free(cli_link_libraries);
+				free(cli_link_search_paths);
+				return 1;
+			}
+		}
+		else if (is_optimization_flag(argv[i]))
+		{
+			opt_level = argv[i];
+		}
+		else if (strcmp(argv[i], "--lto") == 0)
+		{
+			lto = true;
+		}
+		else if (strcmp(argv[i], "--no-ir-pass") == 0)
+		{
+			if (i + 1 >= argc || !disable_ir_pass(argv[i + 1]))
+			{
+				fprintf(stderr, "Error: --no-ir-pass requires one of const-fold, "
+				                "simplify, unreachable, mem2reg, dce or all\n");
+				print_usage(argv[0]);
+				free(cli_link_args);
+				free(cli_link_libraries);
+				free(cli_link_search_paths);
+				return 1;
+			}
+			i++;
+		}
 		else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--rawir") == 0)
 		{
 			stop_at_ir = true;
@@ -540,6 +643,9 @@ int main(int argc, char* argv[])
 						link_config.native_libraries_csv = merged_link_libraries;
 						link_config.native_search_paths_csv =
 						    merged_link_search_paths;
+						link_config.jobs = jobs;
+						link_config.opt_level = opt_level;
+						link_config.lto = lto;
 
 						lres = linker_link(ll_path, outp, &link_config);
 